@@ -0,0 +1,212 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <string>
+#include "SDL_atomic.h"
+#include "audio.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <fcntl.h>
+#else
+#include <unistd.h>
+#endif
+
+static const audio_sink_t *audio_sinks[] = {
+    &audio_sink_sdl,
+    &audio_sink_wav,
+    &audio_sink_raw,
+    &audio_sink_null,
+};
+
+const audio_sink_t *audio_sink = &audio_sink_sdl;
+void (*audio_pull_handler)(int count);
+
+static std::string audio_sink_path;
+static FILE *audio_stdout;
+
+static SDL_atomic_t audio_stats_callbacks;
+static SDL_atomic_t audio_stats_underruns;
+static SDL_atomic_t audio_stats_underrun_samples;
+static SDL_atomic_t audio_stats_overruns;
+static SDL_atomic_t audio_stats_fill_min;
+static SDL_atomic_t audio_stats_fill_max;
+
+void AUDIO_StatsCallback(int fill, int requested)
+{
+    SDL_AtomicAdd(&audio_stats_callbacks, 1);
+    if (fill < requested)
+    {
+        SDL_AtomicAdd(&audio_stats_underruns, 1);
+        SDL_AtomicAdd(&audio_stats_underrun_samples, requested - (fill > 0 ? fill : 0));
+    }
+    // only this thread raises the window, AUDIO_GetStats resets it
+    if (fill < SDL_AtomicGet(&audio_stats_fill_min))
+        SDL_AtomicSet(&audio_stats_fill_min, fill);
+    if (fill > SDL_AtomicGet(&audio_stats_fill_max))
+        SDL_AtomicSet(&audio_stats_fill_max, fill);
+}
+
+void AUDIO_StatsOverrun(void)
+{
+    SDL_AtomicAdd(&audio_stats_overruns, 1);
+}
+
+void AUDIO_GetStats(audio_stats_t *stats)
+{
+    stats->callbacks = (uint32_t)SDL_AtomicGet(&audio_stats_callbacks);
+    stats->underruns = (uint32_t)SDL_AtomicGet(&audio_stats_underruns);
+    stats->underrun_samples = (uint32_t)SDL_AtomicGet(&audio_stats_underrun_samples);
+    stats->overruns = (uint32_t)SDL_AtomicGet(&audio_stats_overruns);
+    stats->fill_min = SDL_AtomicSet(&audio_stats_fill_min, INT_MAX);
+    stats->fill_max = SDL_AtomicSet(&audio_stats_fill_max, -1);
+    if (stats->fill_max < 0) // no callback in this window
+    {
+        stats->fill_min = 0;
+        stats->fill_max = 0;
+    }
+}
+
+int AUDIO_SelectSink(const char *spec)
+{
+    const char *colon = strchr(spec, ':');
+    size_t len = colon ? (size_t)(colon - spec) : strlen(spec);
+
+    for (size_t i = 0; i < sizeof(audio_sinks) / sizeof(audio_sinks[0]); i++)
+    {
+        if (strlen(audio_sinks[i]->name) != len || strncmp(audio_sinks[i]->name, spec, len))
+            continue;
+
+        audio_sink_path = colon ? colon + 1 : "";
+        if (audio_sinks[i]->need_path && audio_sink_path.empty())
+        {
+            fprintf(stderr, "ERROR: Audio output '%s' needs a file name (%s:<path>).\n", audio_sinks[i]->name, audio_sinks[i]->name);
+            return 0;
+        }
+        audio_sink = audio_sinks[i];
+
+        // keep log output away from the sample stream
+        if (audio_sink_path == "-" && !AUDIO_ClaimStdout())
+            return 0;
+
+        return 1;
+    }
+
+    fprintf(stderr, "ERROR: Unknown audio output '%.*s'.\n", (int)len, spec);
+    return 0;
+}
+
+FILE *AUDIO_ClaimStdout(void)
+{
+    if (audio_stdout)
+        return audio_stdout;
+
+    fflush(stdout);
+#ifdef _WIN32
+    int fd = _dup(_fileno(stdout));
+    if (fd < 0)
+        return NULL;
+    _dup2(_fileno(stderr), _fileno(stdout));
+    _setmode(fd, _O_BINARY);
+    audio_stdout = _fdopen(fd, "wb");
+#else
+    int fd = dup(STDOUT_FILENO);
+    if (fd < 0)
+        return NULL;
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    audio_stdout = fdopen(fd, "wb");
+#endif
+    return audio_stdout;
+}
+
+int AUDIO_Open(audio_config_t *config)
+{
+    SDL_AtomicSet(&audio_stats_callbacks, 0);
+    SDL_AtomicSet(&audio_stats_underruns, 0);
+    SDL_AtomicSet(&audio_stats_underrun_samples, 0);
+    SDL_AtomicSet(&audio_stats_overruns, 0);
+    SDL_AtomicSet(&audio_stats_fill_min, INT_MAX);
+    SDL_AtomicSet(&audio_stats_fill_max, -1);
+
+    config->path = audio_sink_path.c_str();
+    config->period = 0;
+    printf("Audio output: %s%s%s\n", audio_sink->name,
+           audio_sink_path.empty() ? "" : " ",
+           audio_sink_path == "-" ? "<stdout>" : audio_sink_path.c_str());
+    return audio_sink->open(config);
+}
+
+void AUDIO_Close(void)
+{
+    audio_sink->close();
+    audio_pull_handler = NULL;
+}
+
+// null
+
+static int AUDIO_Null_Open(audio_config_t * /*config*/)
+{
+    return 1;
+}
+
+static void AUDIO_Null_Write(const short * /*samples*/, int /*count*/)
+{
+}
+
+static int AUDIO_Null_GetFill(void)
+{
+    return 0;
+}
+
+static int AUDIO_Null_GetFree(void)
+{
+    return INT_MAX;
+}
+
+static void AUDIO_Null_Close(void)
+{
+}
+
+const audio_sink_t audio_sink_null = {
+    "null",
+    false,
+    false,
+    AUDIO_Null_Open,
+    AUDIO_Null_Write,
+    AUDIO_Null_GetFill,
+    AUDIO_Null_GetFree,
+    AUDIO_Null_Close,
+};
@@ -0,0 +1,86 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <stdint.h>
+#include <stdio.h>
+
+struct audio_config_t {
+    int device_index; // -1 - default device
+    int rate; // requested rate, actual rate after open
+    int page_size; // samples per device period
+    int buffer_size; // ring size in samples
+    int period; // frames per device period after open, 0 if not applicable
+    const char *path;
+};
+
+struct audio_sink_t {
+    const char *name;
+    bool realtime; // consumed at audio device clock, producer has to be throttled
+    bool need_path;
+    int (*open)(audio_config_t *config);
+    void (*write)(const short *samples, int count); // interleaved stereo, count in samples
+    int (*get_fill)(void); // buffered samples, negative after an underrun
+    int (*get_free)(void);
+    void (*close)(void);
+};
+
+extern const audio_sink_t audio_sink_sdl;
+extern const audio_sink_t audio_sink_wav;
+extern const audio_sink_t audio_sink_raw;
+extern const audio_sink_t audio_sink_null;
+
+extern const audio_sink_t *audio_sink;
+
+// called from the device thread before it reads buffered samples (realtime sinks only)
+extern void (*audio_pull_handler)(int count);
+
+// realtime sink health, counts are totals since the device was opened
+struct audio_stats_t {
+    uint32_t callbacks;
+    uint32_t underruns; // device asked for more than was buffered
+    uint32_t underrun_samples; // silence played instead
+    uint32_t overruns; // producer overwrote samples not played yet
+    int fill_min; // samples buffered at a callback, since the previous AUDIO_GetStats
+    int fill_max;
+};
+
+// called by realtime sinks
+void AUDIO_StatsCallback(int fill, int requested); // fill: samples buffered when the device asked for requested
+void AUDIO_StatsOverrun(void);
+void AUDIO_GetStats(audio_stats_t *stats); // also starts a new fill_min/fill_max window
+
+int AUDIO_SelectSink(const char *spec); // <name>[:<path>]
+int AUDIO_Open(audio_config_t *config);
+void AUDIO_Close(void);
+FILE *AUDIO_ClaimStdout(void);
@@ -0,0 +1,206 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include "audio.h"
+#include "utils/files.h"
+
+#ifndef _WIN32
+#include <signal.h>
+#endif
+
+// file sinks are written as fast as the emulator runs
+
+static FILE *audio_file;
+static bool audio_file_wav;
+static bool audio_file_error;
+static uint64_t audio_file_samples;
+static int audio_file_rate;
+static uint8_t audio_file_buffer[4096 * 4];
+
+static void AUDIO_File_Put16(uint8_t *p, uint16_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+}
+
+static void AUDIO_File_Put32(uint8_t *p, uint32_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = (value >> 8) & 0xff;
+    p[2] = (value >> 16) & 0xff;
+    p[3] = (value >> 24) & 0xff;
+}
+
+static void AUDIO_File_WAVHeader(uint8_t *header, int rate, uint32_t data_size)
+{
+    memcpy(&header[0], "RIFF", 4);
+    AUDIO_File_Put32(&header[4], data_size == UINT32_MAX ? UINT32_MAX : data_size + 36);
+    memcpy(&header[8], "WAVE", 4);
+    memcpy(&header[12], "fmt ", 4);
+    AUDIO_File_Put32(&header[16], 16);
+    AUDIO_File_Put16(&header[20], 1); // PCM
+    AUDIO_File_Put16(&header[22], 2); // channels
+    AUDIO_File_Put32(&header[24], rate);
+    AUDIO_File_Put32(&header[28], rate * 4);
+    AUDIO_File_Put16(&header[32], 4);
+    AUDIO_File_Put16(&header[34], 16);
+    memcpy(&header[36], "data", 4);
+    AUDIO_File_Put32(&header[40], data_size);
+}
+
+static int AUDIO_File_Open(audio_config_t *config, bool wav)
+{
+    audio_file_wav = wav;
+    audio_file_error = false;
+    audio_file_samples = 0;
+    audio_file_rate = config->rate;
+
+    if (!strcmp(config->path, "-"))
+        audio_file = AUDIO_ClaimStdout();
+    else
+        audio_file = Files::utf8_fopen(config->path, "wb");
+
+    if (!audio_file)
+    {
+        printf("Cannot open audio output file: %s\n", config->path);
+        return 0;
+    }
+
+#ifndef _WIN32
+    // reader of a pipe going away shouldn't kill the process
+    signal(SIGPIPE, SIG_IGN);
+#endif
+
+    if (wav)
+    {
+        // sizes are unknown while streaming, patched on close if the file is seekable
+        uint8_t header[44];
+        AUDIO_File_WAVHeader(header, config->rate, UINT32_MAX);
+        fwrite(header, 1, sizeof(header), audio_file);
+    }
+
+    return 1;
+}
+
+static int AUDIO_WAV_Open(audio_config_t *config)
+{
+    return AUDIO_File_Open(config, true);
+}
+
+static int AUDIO_Raw_Open(audio_config_t *config)
+{
+    return AUDIO_File_Open(config, false);
+}
+
+static void AUDIO_File_Write(const short *samples, int count)
+{
+    if (audio_file_error)
+        return;
+
+    // always little endian
+    while (count > 0)
+    {
+        int chunk = count;
+        if (chunk > (int)sizeof(audio_file_buffer) / 2)
+            chunk = (int)sizeof(audio_file_buffer) / 2;
+        for (int i = 0; i < chunk; i++)
+            AUDIO_File_Put16(&audio_file_buffer[i * 2], (uint16_t)samples[i]);
+        if (fwrite(audio_file_buffer, 2, chunk, audio_file) != (size_t)chunk)
+        {
+            fprintf(stderr, "ERROR: Failed to write audio output, stopping.\n");
+            audio_file_error = true;
+            return;
+        }
+        audio_file_samples += chunk;
+        samples += chunk;
+        count -= chunk;
+    }
+}
+
+static int AUDIO_File_GetFill(void)
+{
+    return 0;
+}
+
+static int AUDIO_File_GetFree(void)
+{
+    return INT_MAX;
+}
+
+static void AUDIO_File_Close(void)
+{
+    if (!audio_file)
+        return;
+
+    if (audio_file_wav)
+    {
+        uint64_t data_size = audio_file_samples * 2;
+        if (data_size > UINT32_MAX - 36)
+            data_size = UINT32_MAX - 36;
+        uint8_t header[44];
+        AUDIO_File_WAVHeader(header, audio_file_rate, (uint32_t)data_size);
+        if (fseek(audio_file, 0, SEEK_SET) == 0)
+            fwrite(header, 1, sizeof(header), audio_file);
+    }
+
+    fclose(audio_file);
+    audio_file = NULL;
+
+    printf("Audio output: %.1f seconds written\n",
+           (double)audio_file_samples / 2.0 / (double)audio_file_rate);
+}
+
+const audio_sink_t audio_sink_wav = {
+    "wav",
+    false,
+    true,
+    AUDIO_WAV_Open,
+    AUDIO_File_Write,
+    AUDIO_File_GetFill,
+    AUDIO_File_GetFree,
+    AUDIO_File_Close,
+};
+
+const audio_sink_t audio_sink_raw = {
+    "raw",
+    false,
+    true,
+    AUDIO_Raw_Open,
+    AUDIO_File_Write,
+    AUDIO_File_GetFill,
+    AUDIO_File_GetFree,
+    AUDIO_File_Close,
+};
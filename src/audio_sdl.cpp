@@ -0,0 +1,248 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+#include "audio.h"
+#include "trace.h"
+
+static SDL_AudioDeviceID sdl_audio;
+
+static int audio_buffer_size;
+static short *sample_buffer;
+
+static int sample_read_ptr;
+static int sample_write_ptr;
+
+// monotonic sample counters, fill level is their difference
+static unsigned int sample_write_total;
+static SDL_atomic_t sample_read_total;
+
+static void audio_callback(void* /*userdata*/, Uint8* stream, int len)
+{
+    static bool trace_named;
+    uint64_t trace_t0 = 0;
+    if (trace_enabled)
+    {
+        if (!trace_named)
+            TRACE_ThreadName("audio callback");
+        trace_named = true;
+        trace_t0 = SDL_GetPerformanceCounter();
+    }
+
+    len /= 2;
+    if (audio_pull_handler)
+        audio_pull_handler(len);
+
+    AUDIO_StatsCallback((int)(sample_write_total - (unsigned int)SDL_AtomicGet(&sample_read_total)), len);
+
+    int first = len;
+    if (sample_read_ptr + first > audio_buffer_size)
+        first = audio_buffer_size - sample_read_ptr;
+    memcpy(stream, &sample_buffer[sample_read_ptr], first * 2);
+    memset(&sample_buffer[sample_read_ptr], 0, first * 2);
+    if (first < len)
+    {
+        memcpy(stream + first * 2, &sample_buffer[0], (len - first) * 2);
+        memset(&sample_buffer[0], 0, (len - first) * 2);
+    }
+    sample_read_ptr += len;
+    sample_read_ptr %= audio_buffer_size;
+    int fill_before = (int)(sample_write_total - (unsigned int)SDL_AtomicAdd(&sample_read_total, len));
+
+    if (trace_enabled)
+    {
+        TRACE_Span("audio callback", trace_t0, SDL_GetPerformanceCounter());
+        TRACE_Counter("audio ring fill", fill_before / 2); // frames, after the pull handler ran
+    }
+}
+
+static const char* audio_format_to_str(int format)
+{
+    switch(format)
+    {
+    case AUDIO_S8:
+        return "S8";
+    case AUDIO_U8:
+        return "U8";
+    case AUDIO_S16MSB:
+        return "S16MSB";
+    case AUDIO_S16LSB:
+        return "S16LSB";
+    case AUDIO_U16MSB:
+        return "U16MSB";
+    case AUDIO_U16LSB:
+        return "U16LSB";
+    case AUDIO_S32MSB:
+        return "S32MSB";
+    case AUDIO_S32LSB:
+        return "S32LSB";
+    case AUDIO_F32MSB:
+        return "F32MSB";
+    case AUDIO_F32LSB:
+        return "F32LSB";
+    }
+    return "UNK";
+}
+
+static int AUDIO_SDL_Open(audio_config_t *config)
+{
+    SDL_AudioSpec spec = {};
+    SDL_AudioSpec spec_actual = {};
+
+    int deviceIndex = config->device_index;
+
+    audio_buffer_size = config->buffer_size;
+
+    spec.format = AUDIO_S16SYS;
+    spec.freq = config->rate;
+    spec.channels = 2;
+    spec.callback = audio_callback;
+    spec.samples = config->page_size / 4;
+
+    sample_buffer = (short*)calloc(audio_buffer_size, sizeof(short));
+    if (!sample_buffer)
+    {
+        printf("Cannot allocate audio buffer.\n");
+        return 0;
+    }
+    sample_read_ptr = 0;
+    sample_write_ptr = 0;
+    sample_write_total = 0;
+    SDL_AtomicSet(&sample_read_total, 0);
+
+    int num = SDL_GetNumAudioDevices(0);
+    if (num == 0)
+    {
+        printf("No audio output device found.\n");
+        return 0;
+    }
+
+    if (deviceIndex < -1 || deviceIndex >= num)
+    {
+        printf("Out of range audio device index is requested. Default audio output device is selected.\n");
+        deviceIndex = -1;
+    }
+
+    const char* audioDevicename = deviceIndex == -1 ? "Default device" : SDL_GetAudioDeviceName(deviceIndex, 0);
+
+    sdl_audio = SDL_OpenAudioDevice(deviceIndex == -1 ? NULL : audioDevicename, 0, &spec, &spec_actual, 0);
+    if (!sdl_audio)
+    {
+        return 0;
+    }
+
+    printf("Audio device: %s\n", audioDevicename);
+
+    printf("Audio Requested: F=%s, C=%d, R=%d, B=%d\n",
+           audio_format_to_str(spec.format),
+           spec.channels,
+           spec.freq,
+           spec.samples);
+
+    printf("Audio Actual: F=%s, C=%d, R=%d, B=%d\n",
+           audio_format_to_str(spec_actual.format),
+           spec_actual.channels,
+           spec_actual.freq,
+           spec_actual.samples);
+    fflush(stdout);
+
+    config->rate = spec_actual.freq;
+    config->period = spec_actual.samples;
+
+    SDL_PauseAudioDevice(sdl_audio, 0);
+
+    return 1;
+}
+
+static int AUDIO_SDL_GetFill(void)
+{
+    return (int)(sample_write_total - (unsigned int)SDL_AtomicGet(&sample_read_total));
+}
+
+static int AUDIO_SDL_GetFree(void)
+{
+    int fill = AUDIO_SDL_GetFill();
+    if (fill < 0)
+        fill = 0;
+    return audio_buffer_size - fill;
+}
+
+static void AUDIO_SDL_Write(const short *samples, int count)
+{
+    int fill = AUDIO_SDL_GetFill();
+    if (fill < 0)
+    {
+        // device ran past the producer, restart from its position. The
+        // callback advances both read counters, hold it off so they are
+        // read as a pair (the lock is recursive, -pull writes from inside
+        // the callback).
+        SDL_LockAudioDevice(sdl_audio);
+        sample_write_total = (unsigned int)SDL_AtomicGet(&sample_read_total);
+        sample_write_ptr = sample_read_ptr;
+        SDL_UnlockAudioDevice(sdl_audio);
+    }
+    else if (fill + count > audio_buffer_size)
+        AUDIO_StatsOverrun();
+
+    int first = count;
+    if (sample_write_ptr + first > audio_buffer_size)
+        first = audio_buffer_size - sample_write_ptr;
+    memcpy(&sample_buffer[sample_write_ptr], samples, first * sizeof(short));
+    if (first < count)
+        memcpy(&sample_buffer[0], samples + first, (count - first) * sizeof(short));
+    sample_write_ptr = (sample_write_ptr + count) % audio_buffer_size;
+    sample_write_total += count;
+}
+
+static void AUDIO_SDL_Close(void)
+{
+    if (sdl_audio)
+        SDL_CloseAudioDevice(sdl_audio);
+    sdl_audio = 0;
+    if (sample_buffer) free(sample_buffer);
+    sample_buffer = NULL;
+}
+
+const audio_sink_t audio_sink_sdl = {
+    "sdl",
+    true,
+    false,
+    AUDIO_SDL_Open,
+    AUDIO_SDL_Write,
+    AUDIO_SDL_GetFill,
+    AUDIO_SDL_GetFree,
+    AUDIO_SDL_Close,
+};
@@ -0,0 +1,333 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Microbenchmarks for the emulator hot paths (nuked-sc55-bench target).
+//
+// pcm.cpp is compiled into this file so its inline helpers (calc_tv,
+// eram_unpack, eram_pack) can be called directly; the target doesn't build
+// it separately. All state is synthetic, no ROMs are needed.
+
+#include "../pcm.cpp"
+
+#include <stdlib.h>
+#include <string>
+#include "SDL.h"
+#include "../audio.h"
+#include "../mcu_opcodes.h"
+#include "../mcu_timer.h"
+#include "../submcu.h"
+
+void unscramble(uint8_t *src, uint8_t *dst, int len);
+template<class model>
+void MCU_ReadInstruction(void);
+void MCU_Init(void);
+
+static const int bench_repeat = 5;
+static const char *bench_filter;
+
+static volatile uint32_t bench_sink; // keeps results alive
+
+// what MCU_SelectModel picks for the SC-55mk2 set up in main
+typedef mcu_model_t<MCU_MODEL_MK2> bench_model_t;
+
+// Runs fn(iterations) bench_repeat times and reports the best time per
+// iteration. Iteration counts are fixed per benchmark so runs compare.
+static void BENCH_Run(const char *name, uint64_t iterations, void (*setup)(void), void (*fn)(uint64_t n))
+{
+    if (bench_filter && !strstr(name, bench_filter))
+        return;
+
+    double best = 0.0;
+    for (int r = 0; r < bench_repeat; r++)
+    {
+        if (setup)
+            setup();
+        uint64_t t0 = SDL_GetPerformanceCounter();
+        fn(iterations);
+        uint64_t t1 = SDL_GetPerformanceCounter();
+        double ns = (double)(t1 - t0) * 1e9 / (double)SDL_GetPerformanceFrequency() / (double)iterations;
+        if (r == 0 || ns < best)
+            best = ns;
+    }
+
+    printf("%-40s %12llu %12.2f ns/op\n", name, (unsigned long long)iterations, best);
+    fflush(stdout);
+}
+
+//
+// waverom unscrambling
+//
+
+static uint8_t bench_scrambled[0x10000];
+static uint8_t bench_unscrambled[0x10000];
+
+static void BENCH_Unscramble(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++)
+        unscramble(bench_scrambled, bench_unscrambled, sizeof(bench_scrambled));
+    bench_sink += bench_unscrambled[n & 0xffff];
+}
+
+//
+// PCM chip
+//
+
+static int bench_pcm_slots;
+static int bench_pcm_active; // voices keyed on, out of bench_pcm_slots
+
+static void BENCH_PCMSetup(void)
+{
+    PCM_Reset();
+    pcm.config_reg_3c = 0x30;
+    pcm.config_reg_3d = (bench_pcm_slots - 1) & 31;
+
+    uint32_t mask = 0;
+    for (int slot = 0; slot < bench_pcm_active; slot++)
+    {
+        // spread the active voices over the slots
+        int s = (slot * bench_pcm_slots) / bench_pcm_active;
+        mask |= 1u << s;
+        pcm.ram1[s][0] = 0x8000 + s * 0x100; // end
+        pcm.ram1[s][2] = 0x100 + s * 0x100; // loop
+        pcm.ram1[s][4] = 0x100 + s * 0x100; // address
+        pcm.ram2[s][7] = 0x20; // already keyed on
+        pcm.ram2[s][8] = 0x1000;
+        pcm.ram2[s][9] = 0x4000;
+        pcm.ram2[s][10] = 0x4000;
+    }
+    pcm.voice_mask = mask;
+    pcm.voice_mask_pending = mask;
+    pcm.cycles = 0;
+}
+
+static void BENCH_PCMUpdate(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++)
+        PCM_Update<bench_model_t>(pcm.cycles + 1); // exactly one sample frame
+    bench_sink += pcm.accum_l;
+}
+
+static void BENCH_CalcTV(uint64_t n)
+{
+    uint16_t level = 0x1000;
+    int volmul = 0;
+    int sum = 0;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        calc_tv((int)(i & 3), (int)(i & 0xff), &level, 1, &volmul);
+        sum += volmul;
+        if (level == 0 || level == 0xffff)
+            level = 0x1000;
+    }
+    bench_sink += sum;
+}
+
+static void BENCH_EramUnpack(uint64_t n)
+{
+    int sum = 0;
+    for (uint64_t i = 0; i < n; i++)
+        sum += eram_unpack((int)(i & 0x3fff), (int)(i & 1));
+    bench_sink += sum;
+}
+
+static void BENCH_EramPack(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++)
+        eram_pack((int)(i & 0x3fff), (int)(i * 2654435761u) >> 8);
+    bench_sink += pcm.eram[n & 0x3fff];
+}
+
+//
+// main MCU
+//
+
+static void BENCH_MCUSetup(void)
+{
+    MCU_Init();
+    dev_register[DEV_RAME] = 0x80;
+    mcu.sr = 0x0700;
+}
+
+static uint32_t bench_read_address;
+
+static void BENCH_MCURead(uint64_t n)
+{
+    uint32_t sum = 0;
+    for (uint64_t i = 0; i < n; i++)
+        sum += MCU_ReadImpl<bench_model_t>(bench_read_address + (uint32_t)(i & 0x3e));
+    bench_sink += sum;
+}
+
+static const uint32_t bench_code = 0x8000; // instructions are placed in sram
+static const uint8_t *bench_insn;
+static int bench_insn_len;
+
+static void BENCH_OpcodeSetup(void)
+{
+    BENCH_MCUSetup();
+    for (int i = 0; i < bench_insn_len; i++)
+        MCU_Write(bench_code + i, bench_insn[i]);
+}
+
+static void BENCH_Opcode(uint64_t n)
+{
+    for (uint64_t i = 0; i < n; i++)
+    {
+        mcu.cp = 0;
+        mcu.pc = bench_code;
+        mcu.r[1] = 0x8100;
+        MCU_ReadInstruction<bench_model_t>();
+    }
+    bench_sink += mcu.r[0];
+}
+
+static void BENCH_TimerClock(uint64_t n)
+{
+    uint64_t cycles = mcu.cycles;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        cycles += 12;
+        TIMER_Clock<bench_model_t>(cycles);
+    }
+    mcu.cycles = cycles;
+}
+
+//
+// sub MCU
+//
+
+static void BENCH_SMSetup(void)
+{
+    // NOP, INX, LDX #5, JMP $1000 in a loop, all vectors point at it
+    static const uint8_t loop[] = { 0xea, 0xe8, 0xa2, 0x05, 0x4c, 0x00, 0x10 };
+    memset(sm_rom, 0xea, sizeof(sm_rom));
+    memcpy(sm_rom, loop, sizeof(loop));
+    for (int i = 0xfec; i < 0x1000; i += 2)
+    {
+        sm_rom[i] = 0x00;
+        sm_rom[i + 1] = 0x10;
+    }
+    SM_Reset();
+    sm.sr |= SM_STATUS_I;
+}
+
+static void BENCH_SMUpdate(uint64_t n)
+{
+    uint64_t cycles = sm.cycles / 5;
+    for (uint64_t i = 0; i < n; i++)
+    {
+        cycles += 12; // one main MCU step
+        SM_Update(cycles);
+    }
+    bench_sink += sm.a;
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc > 1)
+        bench_filter = argv[1];
+
+    SDL_Init(SDL_INIT_TIMER);
+    AUDIO_SelectSink("null");
+    MCU_SetRomset(ROM_SET_MK2);
+
+    printf("%-40s %12s %12s\n", "benchmark", "iterations", "time");
+
+    for (size_t i = 0; i < sizeof(bench_scrambled); i++)
+        bench_scrambled[i] = (uint8_t)(i * 2654435761u >> 13);
+    BENCH_Run("unscramble 64K", 200, NULL, BENCH_Unscramble);
+
+    static const int slots[] = { 16, 24, 32 };
+    static const int density[] = { 0, 50, 100 }; // percent of slots keyed on
+    for (int s = 0; s < 3; s++)
+    {
+        for (int d = 0; d < 3; d++)
+        {
+            char name[64];
+            snprintf(name, sizeof(name), "PCM_Update slots=%d active=%d%%", slots[s], density[d]);
+            bench_pcm_slots = slots[s];
+            bench_pcm_active = (slots[s] * density[d]) / 100;
+            BENCH_Run(name, 200000, BENCH_PCMSetup, BENCH_PCMUpdate);
+        }
+    }
+    BENCH_Run("calc_tv", 10000000, NULL, BENCH_CalcTV);
+    BENCH_Run("eram_unpack", 10000000, NULL, BENCH_EramUnpack);
+    BENCH_Run("eram_pack", 10000000, NULL, BENCH_EramPack);
+
+    static const struct {
+        const char *name;
+        uint32_t address;
+    } regions[] = {
+        { "MCU_Read rom1", 0x00100 },
+        { "MCU_Read rom2", 0x10100 },
+        { "MCU_Read sram", 0x08100 },
+        { "MCU_Read ram", 0x0fc00 },
+        { "MCU_Read pcm", 0x0e000 },
+    };
+    for (size_t i = 0; i < sizeof(regions) / sizeof(regions[0]); i++)
+    {
+        bench_read_address = regions[i].address;
+        BENCH_Run(regions[i].name, 10000000, BENCH_MCUSetup, BENCH_MCURead);
+    }
+
+    static const struct {
+        const char *name;
+        uint8_t code[6];
+        int len;
+    } insns[] = {
+        { "op nop", { 0x00 }, 1 },
+        { "op mov:e.b #xx,r0", { 0x50, 0x12 }, 2 },
+        { "op mov:i.w #xxxx,r0", { 0x58, 0x12, 0x34 }, 3 },
+        { "op cmp:e.b #xx,r0", { 0x40, 0x12 }, 2 },
+        { "op bra", { 0x20, 0x00 }, 2 },
+        { "op add:g.w r1,r0", { 0xa9, 0x20 }, 2 },
+        { "op mulxu.b r1,r0", { 0xa1, 0xa8 }, 2 },
+        { "op mov:g.w @r1,r0", { 0xd9, 0x80 }, 2 },
+        { "op mov:g.w r0,@(d:8,r1)", { 0xe9, 0x10, 0x90 }, 3 },
+        { "op mov:g.b @aa:16,r0", { 0x15, 0x81, 0x00, 0x80 }, 4 },
+    };
+    for (size_t i = 0; i < sizeof(insns) / sizeof(insns[0]); i++)
+    {
+        bench_insn = insns[i].code;
+        bench_insn_len = insns[i].len;
+        BENCH_Run(insns[i].name, 10000000, BENCH_OpcodeSetup, BENCH_Opcode);
+    }
+
+    BENCH_Run("TIMER_Clock", 10000000, BENCH_MCUSetup, BENCH_TimerClock);
+    BENCH_Run("SM_Update", 10000000, BENCH_SMSetup, BENCH_SMUpdate);
+
+    SDL_Quit();
+
+    return 0;
+}
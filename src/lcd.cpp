@@ -32,9 +32,17 @@
  *  POSSIBILITY OF SUCH DAMAGE.
  */
 
+#include <signal.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#ifdef _WIN32
+#include <io.h>
+#define isatty _isatty
+#define fileno _fileno
+#else
+#include <unistd.h>
+#endif
 #include "SDL.h"
 #include "SDL_mutex.h"
 #include "lcd.h"
@@ -53,14 +61,66 @@ static uint8_t LCD_CG[64];
 static uint8_t lcd_enable = 1;
 static bool lcd_quit_requested = false;
 
+// bumped on every write that can change what is displayed
+static uint32_t lcd_generation = 1;
+
+// Display state as seen by the UI thread. The emulator thread publishes it
+// after every write through a seqlock (odd sequence = update in progress),
+// so rendering never has to take the work thread lock.
+struct lcd_snapshot_t {
+    uint8_t data[80];
+    uint8_t cg[64];
+    uint8_t dd_ram;
+    uint8_t cursor;
+    uint8_t enable;
+    uint32_t generation;
+};
+
+static lcd_snapshot_t lcd_shared;
+static SDL_atomic_t lcd_seq;
+static lcd_snapshot_t lcd_snap; // UI thread copy
+
+static void LCD_Publish(void)
+{
+    SDL_AtomicAdd(&lcd_seq, 1);
+    memcpy(lcd_shared.data, LCD_Data, sizeof(LCD_Data));
+    memcpy(lcd_shared.cg, LCD_CG, sizeof(LCD_CG));
+    lcd_shared.dd_ram = LCD_DD_RAM;
+    lcd_shared.cursor = LCD_C;
+    lcd_shared.enable = lcd_enable;
+    lcd_shared.generation = lcd_generation;
+    SDL_AtomicAdd(&lcd_seq, 1);
+}
+
+static void LCD_Snapshot(lcd_snapshot_t *snap)
+{
+    for (;;)
+    {
+        int seq = SDL_AtomicGet(&lcd_seq);
+        if (seq & 1)
+            continue; // writer is in the middle of an update
+        SDL_MemoryBarrierAcquire();
+        memcpy(snap, &lcd_shared, sizeof(lcd_snapshot_t));
+        SDL_MemoryBarrierAcquire();
+        if (SDL_AtomicGet(&lcd_seq) == seq)
+            return;
+    }
+}
+
 void LCD_Enable(uint32_t enable)
 {
+    if (lcd_enable == enable)
+        return;
     lcd_enable = enable;
+    lcd_generation++;
+    LCD_Publish();
 }
 
+static volatile sig_atomic_t lcd_signal_quit = 0;
+
 bool LCD_QuitRequested()
 {
-    return lcd_quit_requested;
+    return lcd_quit_requested || lcd_signal_quit;
 }
 
 void LCD_Write(uint32_t address, uint8_t data)
@@ -155,6 +215,8 @@ void LCD_Write(uint32_t address, uint8_t data)
             LCD_DD_RAM &= 0x7f;
         }
     }
+    lcd_generation++;
+    LCD_Publish();
     //printf("%i %.2x ", address, data);
     // if (data >= 0x20 && data <= 'z')
     //     printf("%c\n", data);
@@ -177,6 +239,37 @@ static uint32_t lcd_background[268][741];
 
 static uint32_t lcd_init = 0;
 
+// Screen layout: every character cell with the area it covers. Cells are
+// re-rendered only when their character, its CG RAM glyph or the cursor
+// changed, and only their rectangles are uploaded to the texture.
+enum {
+    LCD_CELL_STANDARD,
+    LCD_CELL_LEVEL,
+    LCD_CELL_LR
+};
+
+struct lcd_cell_t {
+    uint8_t type;
+    uint8_t data; // LCD_Data index
+    uint8_t arg; // level width or LR part
+    int x, y; // lcd_buffer row, column
+    int w, h;
+};
+
+static const int lcd_cells_max = 64;
+static lcd_cell_t lcd_cells[lcd_cells_max];
+static int lcd_cell_count;
+static uint16_t lcd_cell_key[lcd_cells_max]; // last rendered character | cursor << 8
+static uint8_t lcd_cg_rendered[64];
+static uint32_t lcd_rendered_generation;
+static bool lcd_full_redraw = true;
+static bool lcd_present = true;
+static SDL_Rect lcd_dirty[lcd_cells_max];
+static int lcd_dirty_count;
+
+static void LCD_SetupCells(void);
+static void LCD_BuildAtlas(void);
+
 const int button_map_sc55[][2] =
 {
     SDL_SCANCODE_Q, MCU_BUTTON_POWER,
@@ -226,6 +319,28 @@ void LCD_SetBackPath(const std::string &path)
     m_back_path = path;
 }
 
+int lcd_nogui = 0;
+
+// text renderer
+static std::string lcd_text_path; // "-" is the terminal
+static FILE *lcd_text_out;
+static bool lcd_text_tty;
+static int lcd_text_lines;
+static uint32_t lcd_text_generation;
+static uint64_t lcd_text_last;
+static std::string lcd_text_shown;
+static const int lcd_text_interval = 200; // ms
+
+void LCD_SetTextPath(const std::string &path)
+{
+    lcd_text_path = path;
+}
+
+static void LCD_SignalQuit(int)
+{
+    lcd_signal_quit = 1;
+}
+
 void LCD_Init(void)
 {
     FILE *raw;
@@ -235,6 +350,26 @@ void LCD_Init(void)
 
     lcd_quit_requested = false;
 
+    LCD_Publish();
+
+    if (lcd_text_path == "-")
+    {
+        lcd_text_out = stdout;
+        lcd_text_tty = isatty(fileno(stdout)) != 0;
+    }
+    lcd_text_lines = 0;
+    lcd_text_generation = 0;
+    lcd_text_last = 0;
+    lcd_text_shown.clear();
+
+    if (lcd_nogui)
+    {
+        // no window to close, quit on Ctrl+C instead so outputs get finalized
+        signal(SIGINT, LCD_SignalQuit);
+        signal(SIGTERM, LCD_SignalQuit);
+        return;
+    }
+
     std::string title = "Nuked SC-55: ";
 
     title += rs_name[romset];
@@ -259,6 +394,11 @@ void LCD_Init(void)
     fread(lcd_background, 1, sizeof(lcd_background), raw);
     fclose(raw);
 
+    LCD_BuildAtlas();
+    LCD_SetupCells();
+    lcd_full_redraw = true;
+    lcd_present = true;
+
     lcd_init = 1;
 }
 
@@ -271,75 +411,89 @@ void LCD_UnInit(void)
 uint32_t lcd_col1 = 0x000000;
 uint32_t lcd_col2 = 0x0050c8;
 
-void LCD_FontRenderStandard(int32_t x, int32_t y, uint8_t ch, bool overlay = false)
+// Glyph atlas: every character pre-rendered as one row of pixels per dot row,
+// 0 in the gaps between dots. The gaps keep the background, so rows are
+// combined with it through a mask instead of testing every dot.
+static const int lcd_glyph_width = 4 * 6 + 5;
+static const int lcd_level_width = 4 * 26 + 24;
+static uint32_t lcd_atlas_standard[256][7][lcd_glyph_width];
+static uint32_t lcd_atlas_level[256][8][lcd_level_width];
+static uint32_t lcd_mask_standard[lcd_glyph_width];
+static uint32_t lcd_mask_level[lcd_level_width];
+
+static void LCD_BuildGlyph(int ch)
 {
-    uint8_t* f;
+    const uint8_t* f;
     if (ch >= 16)
         f = &lcd_font[ch - 16][0];
     else
-        f = &LCD_CG[(ch & 7) * 8];
-    for (int i = 0; i < 7; i++)
+        f = &lcd_snap.cg[(ch & 7) * 8];
+
+    memset(lcd_atlas_standard[ch], 0, sizeof(lcd_atlas_standard[ch]));
+    memset(lcd_atlas_level[ch], 0, sizeof(lcd_atlas_level[ch]));
+    for (int i = 0; i < 8; i++)
     {
         for (int j = 0; j < 5; j++)
         {
-            uint32_t col;
-            if (f[i] & (1<<(4-j)))
-            {
-                col = lcd_col1;
-            }
-            else
-            {
-                col = lcd_col2;
-            }
-            int xx = x + i * 6;
-            int yy = y + j * 6;
-            for (int ii = 0; ii < 5; ii++)
+            uint32_t col = (f[i] & (1<<(4-j))) ? lcd_col1 : lcd_col2;
+            if (i < 7)
             {
                 for (int jj = 0; jj < 5; jj++)
-                {
-                    if (overlay)
-                        lcd_buffer[xx+ii][yy+jj] &= col;
-                    else
-                        lcd_buffer[xx+ii][yy+jj] = col;
-                }
+                    lcd_atlas_standard[ch][i][j * 6 + jj] = col;
             }
+            for (int jj = 0; jj < 24; jj++)
+                lcd_atlas_level[ch][i][j * 26 + jj] = col;
         }
     }
 }
 
-void LCD_FontRenderLevel(int32_t x, int32_t y, uint8_t ch, uint8_t width = 5)
+static void LCD_BuildAtlas(void)
 {
-    uint8_t* f;
-    if (ch >= 16)
-        f = &lcd_font[ch - 16][0];
-    else
-        f = &LCD_CG[(ch & 7) * 8];
-    for (int i = 0; i < 8; i++)
+    for (int j = 0; j < lcd_glyph_width; j++)
+        lcd_mask_standard[j] = (j % 6) < 5 ? 0 : 0xffffffff;
+    for (int j = 0; j < lcd_level_width; j++)
+        lcd_mask_level[j] = (j % 26) < 24 ? 0 : 0xffffffff;
+    for (int ch = 0; ch < 256; ch++)
+        LCD_BuildGlyph(ch);
+}
+
+void LCD_FontRenderStandard(int32_t x, int32_t y, uint8_t ch, bool overlay = false)
+{
+    for (int i = 0; i < 7; i++)
     {
-        for (int j = 0; j < width; j++)
+        const uint32_t *src = lcd_atlas_standard[ch][i];
+        for (int ii = 0; ii < 5; ii++)
         {
-            uint32_t col;
-            if (f[i] & (1<<(4-j)))
+            uint32_t *dst = &lcd_buffer[x + i * 6 + ii][y];
+            if (overlay)
             {
-                col = lcd_col1;
+                for (int j = 0; j < lcd_glyph_width; j++)
+                    dst[j] &= src[j] | lcd_mask_standard[j];
             }
             else
             {
-                col = lcd_col2;
-            }
-            int xx = x + i * 11;
-            int yy = y + j * 26;
-            for (int ii = 0; ii < 9; ii++)
-            {
-                for (int jj = 0; jj < 24; jj++)
-                {
-                    lcd_buffer[xx+ii][yy+jj] = col;
-                }
+                for (int j = 0; j < lcd_glyph_width; j++)
+                    dst[j] = (dst[j] & lcd_mask_standard[j]) | src[j];
             }
         }
     }
 }
 
+void LCD_FontRenderLevel(int32_t x, int32_t y, uint8_t ch, uint8_t width = 5)
+{
+    int w = (width - 1) * 26 + 24;
+    for (int i = 0; i < 8; i++)
+    {
+        const uint32_t *src = lcd_atlas_level[ch][i];
+        for (int ii = 0; ii < 9; ii++)
+        {
+            uint32_t *dst = &lcd_buffer[x + i * 11 + ii][y];
+            for (int j = 0; j < w; j++)
+                dst[j] = (dst[j] & lcd_mask_level[j]) | src[j];
+        }
+    }
+}
+
 static const uint8_t LR[2][12][11] =
 {
     {
@@ -378,13 +532,13 @@ static const int LR_xy[2][2] = {
 };
 
 
-void LCD_FontRenderLR(uint8_t ch)
+void LCD_FontRenderLR(uint8_t ch, int part)
 {
     uint8_t* f;
     if (ch >= 16)
         f = &lcd_font[ch - 16][0];
     else
-        f = &LCD_CG[(ch & 7) * 8];
+        f = &lcd_snap.cg[(ch & 7) * 8];
     int col;
     if (f[0] & 1)
     {
@@ -394,129 +548,364 @@ void LCD_FontRenderLR(uint8_t ch)
     {
         col = lcd_col2;
     }
-    for (int f = 0; f < 2; f++)
+    for (int i = 0; i < 12; i++)
     {
-        for (int i = 0; i < 12; i++)
+        for (int j = 0; j < 11; j++)
         {
-            for (int j = 0; j < 11; j++)
-            {
-                if (LR[f][i][j])
-                    lcd_buffer[i+LR_xy[f][0]][j+LR_xy[f][1]] = col;
-            }
+            if (LR[part][i][j])
+                lcd_buffer[i+LR_xy[part][0]][j+LR_xy[part][1]] = col;
         }
     }
 }
 
-void LCD_Update(void)
+static void LCD_AddCell(uint8_t type, uint8_t data, uint8_t arg, int x, int y)
 {
-    if (!lcd_init)
+    lcd_cell_t *cell = &lcd_cells[lcd_cell_count++];
+    cell->type = type;
+    cell->data = data;
+    cell->arg = arg;
+    cell->x = x;
+    cell->y = y;
+    switch (type)
+    {
+        case LCD_CELL_STANDARD:
+            cell->w = 4 * 6 + 5;
+            cell->h = 6 * 6 + 5;
+            break;
+        case LCD_CELL_LEVEL:
+            cell->w = (arg - 1) * 26 + 24;
+            cell->h = 7 * 11 + 9;
+            break;
+        case LCD_CELL_LR:
+            cell->w = 11;
+            cell->h = 12;
+            break;
+    }
+}
+
+static void LCD_SetupCells(void)
+{
+    lcd_cell_count = 0;
+
+    if (mcu_jv880)
+    {
+        for (int i = 0; i < 2; i++)
+        {
+            for (int j = 0; j < 24; j++)
+                LCD_AddCell(LCD_CELL_STANDARD, i * 40 + j, 0, 4 + i * 50, 4 + j * 34);
+        }
         return;
+    }
 
-    if (!mcu_cm300 && !mcu_st && !mcu_scb55)
+    static const int groups[8][4] = {
+        // x, y, first, count
+        { 11, 34, 0, 3 },
+        { 11, 153, 3, 16 },
+        { 75, 34, 40, 3 },
+        { 75, 153, 43, 3 },
+        { 139, 34, 49, 3 },
+        { 139, 153, 46, 3 },
+        { 203, 34, 52, 3 },
+        { 203, 153, 55, 3 },
+    };
+    for (int g = 0; g < 8; g++)
+    {
+        for (int i = 0; i < groups[g][3]; i++)
+            LCD_AddCell(LCD_CELL_STANDARD, groups[g][2] + i, 0, groups[g][0], groups[g][1] + i * 35);
+    }
+
+    LCD_AddCell(LCD_CELL_LR, 58, 0, LR_xy[0][0], LR_xy[0][1]);
+    LCD_AddCell(LCD_CELL_LR, 58, 1, LR_xy[1][0], LR_xy[1][1]);
+
+    for (int i = 0; i < 2; i++)
+    {
+        for (int j = 0; j < 4; j++)
+            LCD_AddCell(LCD_CELL_LEVEL, 20 + j + i * 40, j == 3 ? 1 : 5, 71 + i * 88, 293 + j * 130);
+    }
+}
+
+static void LCD_RenderBackground(int x, int y, int w, int h)
+{
+    for (int i = x; i < x + h; i++)
+    {
+        if (mcu_jv880)
+        {
+            for (int j = y; j < y + w; j++)
+                lcd_buffer[i][j] = 0xFF03be51;
+        }
+        else
+            memcpy(&lcd_buffer[i][y], &lcd_background[i][y], w * sizeof(uint32_t));
+    }
+}
+
+static void LCD_RenderCell(const lcd_cell_t *cell, uint8_t ch, bool cursor)
+{
+    switch (cell->type)
+    {
+        case LCD_CELL_STANDARD:
+            LCD_FontRenderStandard(cell->x, cell->y, ch);
+            if (cursor)
+                LCD_FontRenderStandard(cell->x, cell->y, '_', true);
+            break;
+        case LCD_CELL_LEVEL:
+            LCD_FontRenderLevel(cell->x, cell->y, ch, cell->arg);
+            break;
+        case LCD_CELL_LR:
+            LCD_FontRenderLR(ch, cell->arg);
+            break;
+    }
+}
+
+// Re-renders changed cells into lcd_buffer and collects their rectangles.
+// Returns false if nothing changed.
+static bool LCD_Render(void)
+{
+    lcd_dirty_count = 0;
+
+    LCD_Snapshot(&lcd_snap);
+
+    if (lcd_snap.generation == lcd_rendered_generation && !lcd_full_redraw)
+        return false;
+    lcd_rendered_generation = lcd_snap.generation;
+
+    if (!lcd_snap.enable && !mcu_jv880)
+    {
+        memset(lcd_buffer, 0, sizeof(lcd_buffer));
+        // everything has to come back once the display is enabled again
+        lcd_full_redraw = true;
+        lcd_dirty_count = -1;
+        return true;
+    }
+
+    bool full = lcd_full_redraw;
+    if (full)
     {
-        MCU_WorkThread_Lock();
+        LCD_RenderBackground(0, 0, lcd_width, lcd_height);
+        lcd_full_redraw = false;
+    }
+
+    // CG RAM glyphs that changed since the last render
+    uint8_t cg_changed = 0;
+    for (int i = 0; i < 8; i++)
+    {
+        if (memcmp(&lcd_snap.cg[i * 8], &lcd_cg_rendered[i * 8], 8))
+            cg_changed |= 1 << i;
+    }
+    memcpy(lcd_cg_rendered, lcd_snap.cg, sizeof(lcd_snap.cg));
+    for (int i = 0; i < 8; i++)
+    {
+        if (cg_changed & (1 << i))
+        {
+            LCD_BuildGlyph(i);
+            LCD_BuildGlyph(i + 8);
+        }
+    }
+
+    int cursor = -1;
+    if (mcu_jv880 && lcd_snap.cursor)
+    {
+        int j = lcd_snap.dd_ram % 0x40;
+        int i = lcd_snap.dd_ram / 0x40;
+        if (i < 2 && j < 24)
+            cursor = i * 40 + j;
+    }
+
+    for (int i = 0; i < lcd_cell_count; i++)
+    {
+        const lcd_cell_t *cell = &lcd_cells[i];
+        uint8_t ch = lcd_snap.data[cell->data];
+        uint16_t key = ch | ((cell->data == cursor) << 8);
 
-        if (!lcd_enable && !mcu_jv880)
+        if (!full && key == lcd_cell_key[i] && (ch >= 16 || !(cg_changed & (1 << (ch & 7)))))
+            continue;
+        lcd_cell_key[i] = key;
+
+        if (!full)
+            LCD_RenderBackground(cell->x, cell->y, cell->w, cell->h);
+        LCD_RenderCell(cell, ch, key >> 8);
+
+        if (!full)
         {
-            memset(lcd_buffer, 0, sizeof(lcd_buffer));
+            SDL_Rect *rect = &lcd_dirty[lcd_dirty_count++];
+            rect->x = cell->y;
+            rect->y = cell->x;
+            rect->w = cell->w;
+            rect->h = cell->h;
         }
+    }
+
+    if (full)
+        lcd_dirty_count = -1;
+
+    return lcd_dirty_count != 0;
+}
+
+static const uint8_t *LCD_TextGlyph(const lcd_snapshot_t *snap, uint8_t ch)
+{
+    if (ch >= 16)
+        return &lcd_font[ch - 16][0];
+    return &snap->cg[(ch & 7) * 8];
+}
+
+static void LCD_TextAppend(std::string &out, const lcd_snapshot_t *snap, int first, int count)
+{
+    for (int i = first; i < first + count; i++)
+    {
+        uint8_t ch = snap->data[i];
+        if (ch < 16)
+            out += '#'; // user defined glyph
+        else if (ch == 0x7e)
+            out += "\xe2\x86\x92";
+        else if (ch == 0x7f)
+            out += "\xe2\x86\x90";
+        else if (ch < 0x20 || ch > 0x7f)
+            out += '?';
         else
+            out += (char)ch;
+    }
+}
+
+static void LCD_TextRender(std::string &out, const lcd_snapshot_t *snap)
+{
+    if (mcu_jv880)
+    {
+        for (int i = 0; i < 2; i++)
         {
-            if (mcu_jv880)
-            {
-                for (size_t i = 0; i < lcd_height; i++) {
-                    for (size_t j = 0; j < lcd_width; j++) {
-                        lcd_buffer[i][j] = 0xFF03be51;
-                    }
-                }
-            }
-            else
-            {
-                for (size_t i = 0; i < lcd_height; i++) {
-                    for (size_t j = 0; j < lcd_width; j++) {
-                        lcd_buffer[i][j] = lcd_background[i][j];
-                    }
-                }
-            }
+            LCD_TextAppend(out, snap, i * 40, 24);
+            out += '\n';
+        }
+        return;
+    }
 
-            if (mcu_jv880)
+    if (!snap->enable)
+    {
+        out += "(display off)\n";
+        return;
+    }
+
+    static const struct {
+        const char *name;
+        int first, count;
+    } fields[8] = {
+        { "PART     ", 0, 3 },
+        { "INSTRUMENT ", 3, 16 },
+        { "LEVEL    ", 40, 3 },
+        { "PAN        ", 43, 3 },
+        { "REVERB   ", 49, 3 },
+        { "CHORUS     ", 46, 3 },
+        { "K SHIFT  ", 52, 3 },
+        { "MIDI CH    ", 55, 3 },
+    };
+    for (int i = 0; i < 8; i += 2)
+    {
+        out += fields[i].name;
+        LCD_TextAppend(out, snap, fields[i].first, fields[i].count);
+        out += "   ";
+        out += fields[i + 1].name;
+        LCD_TextAppend(out, snap, fields[i + 1].first, fields[i + 1].count);
+        out += '\n';
+    }
+
+    // level bars: 16 columns of 16 dots, two rows of four cells (5, 5, 5 and 1 dots wide)
+    static const char *bars[9] = {
+        " ", "\xe2\x96\x81", "\xe2\x96\x82", "\xe2\x96\x83", "\xe2\x96\x84",
+        "\xe2\x96\x85", "\xe2\x96\x86", "\xe2\x96\x87", "\xe2\x96\x88"
+    };
+    out += "[";
+    for (int c = 0; c < 16; c++)
+    {
+        int height = 0;
+        for (int r = 0; r < 16; r++)
+        {
+            const uint8_t *f = LCD_TextGlyph(snap, snap->data[20 + c / 5 + (r / 8) * 40]);
+            if (f[r % 8] & (1 << (4 - c % 5)))
             {
-                for (int i = 0; i < 2; i++)
-                {
-                    for (int j = 0; j < 24; j++)
-                    {
-                        uint8_t ch = LCD_Data[i * 40 + j];
-                        LCD_FontRenderStandard(4 + i * 50, 4 + j * 34, ch);
-                    }
-                }
-                
-                // cursor
-                int j = LCD_DD_RAM % 0x40;
-                int i = LCD_DD_RAM / 0x40;
-                if (i < 2 && j < 24 && LCD_C)
-                    LCD_FontRenderStandard(4 + i * 50, 4 + j * 34, '_', true);
+                height = 16 - r;
+                break;
             }
-            else
-            {
-                for (int i = 0; i < 3; i++)
-                {
-                    uint8_t ch = LCD_Data[0 + i];
-                    LCD_FontRenderStandard(11, 34 + i * 35, ch);
-                }
-                for (int i = 0; i < 16; i++)
-                {
-                    uint8_t ch = LCD_Data[3 + i];
-                    LCD_FontRenderStandard(11, 153 + i * 35, ch);
-                }
-                for (int i = 0; i < 3; i++)
-                {
-                    uint8_t ch = LCD_Data[40 + i];
-                    LCD_FontRenderStandard(75, 34 + i * 35, ch);
-                }
-                for (int i = 0; i < 3; i++)
-                {
-                    uint8_t ch = LCD_Data[43 + i];
-                    LCD_FontRenderStandard(75, 153 + i * 35, ch);
-                }
-                for (int i = 0; i < 3; i++)
-                {
-                    uint8_t ch = LCD_Data[49 + i];
-                    LCD_FontRenderStandard(139, 34 + i * 35, ch);
-                }
-                for (int i = 0; i < 3; i++)
-                {
-                    uint8_t ch = LCD_Data[46 + i];
-                    LCD_FontRenderStandard(139, 153 + i * 35, ch);
-                }
-                for (int i = 0; i < 3; i++)
-                {
-                    uint8_t ch = LCD_Data[52 + i];
-                    LCD_FontRenderStandard(203, 34 + i * 35, ch);
-                }
-                for (int i = 0; i < 3; i++)
-                {
-                    uint8_t ch = LCD_Data[55 + i];
-                    LCD_FontRenderStandard(203, 153 + i * 35, ch);
-                }
+        }
+        out += bars[(height + 1) / 2];
+    }
+    out += "]\n";
+}
 
-                LCD_FontRenderLR(LCD_Data[58]);
+static void LCD_TextUpdate(void)
+{
+    if (mcu_cm300 || mcu_st || mcu_scb55)
+        return; // no display
 
-                for (int i = 0; i < 2; i++)
-                {
-                    for (int j = 0; j < 4; j++)
-                    {
-                        uint8_t ch = LCD_Data[20 + j + i * 40];
-                        LCD_FontRenderLevel(71 + i * 88, 293 + j * 130, ch, j == 3 ? 1 : 5);
-                    }
-                }
-            }
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (lcd_text_last && now - lcd_text_last < SDL_GetPerformanceFrequency() * lcd_text_interval / 1000)
+        return;
+
+    lcd_snapshot_t snap;
+    LCD_Snapshot(&snap);
+    if (snap.generation == lcd_text_generation)
+        return;
+    lcd_text_generation = snap.generation;
+
+    std::string text;
+    LCD_TextRender(text, &snap);
+    if (text == lcd_text_shown)
+        return;
+    lcd_text_shown = text;
+    lcd_text_last = now;
+
+    if (lcd_text_out)
+    {
+        // redraw in place on a terminal, otherwise append
+        if (lcd_text_tty && lcd_text_lines)
+            fprintf(lcd_text_out, "\x1b[%dA", lcd_text_lines);
+        lcd_text_lines = 0;
+        size_t pos = 0;
+        while (pos < text.size())
+        {
+            size_t end = text.find('\n', pos);
+            fprintf(lcd_text_out, "%s%s\n", text.substr(pos, end - pos).c_str(), lcd_text_tty ? "\x1b[K" : "");
+            lcd_text_lines++;
+            pos = end + 1;
         }
+        if (!lcd_text_tty)
+            fprintf(lcd_text_out, "\n");
+        fflush(lcd_text_out);
+    }
+    else
+    {
+        // status file always holds the current display
+        Files::writeFileAtomic(lcd_text_path, text);
+    }
+}
 
-        MCU_WorkThread_Unlock();
+void LCD_Update(void)
+{
+    if (!lcd_text_path.empty())
+        LCD_TextUpdate();
+
+    if (!lcd_init)
+        return;
 
-        SDL_UpdateTexture(texture, NULL, lcd_buffer, lcd_width_max * 4);
-        SDL_RenderCopy(renderer, texture, NULL, NULL);
-        SDL_RenderPresent(renderer);
+    if (!mcu_cm300 && !mcu_st && !mcu_scb55)
+    {
+        bool changed = LCD_Render();
+
+        if (changed)
+        {
+            if (lcd_dirty_count < 0)
+                SDL_UpdateTexture(texture, NULL, lcd_buffer, lcd_width_max * 4);
+            for (int i = 0; i < lcd_dirty_count; i++)
+            {
+                const SDL_Rect *rect = &lcd_dirty[i];
+                SDL_UpdateTexture(texture, rect, &lcd_buffer[rect->y][rect->x], lcd_width_max * 4);
+            }
+            lcd_present = true;
+        }
+
+        if (lcd_present)
+        {
+            SDL_RenderCopy(renderer, texture, NULL, NULL);
+            SDL_RenderPresent(renderer);
+            lcd_present = false;
+        }
     }
 
     SDL_Event sdl_event;
@@ -528,6 +917,12 @@ void LCD_Update(void)
                 MCU_EncoderTrigger(0);
             if (sdl_event.key.keysym.scancode == SDL_SCANCODE_PERIOD)
                 MCU_EncoderTrigger(1);
+            if (sdl_event.key.keysym.scancode == SDL_SCANCODE_F12 && !sdl_event.key.repeat)
+            {
+                MCU_WorkThread_Lock();
+                MCU_ITraceDump(stderr, "F12");
+                MCU_WorkThread_Unlock();
+            }
         }
 
         switch (sdl_event.type)
@@ -536,6 +931,11 @@ void LCD_Update(void)
                 lcd_quit_requested = true;
                 break;
 
+            case SDL_WINDOWEVENT:
+                if (sdl_event.window.event == SDL_WINDOWEVENT_EXPOSED)
+                    lcd_present = true;
+                break;
+
             case SDL_KEYDOWN:
             case SDL_KEYUP:
             {
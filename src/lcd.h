@@ -42,7 +42,10 @@ extern int lcd_height;
 extern uint32_t lcd_col1;
 extern uint32_t lcd_col2;
 
+extern int lcd_nogui;
+
 void LCD_SetBackPath(const std::string &path);
+void LCD_SetTextPath(const std::string &path); // "-" prints to the terminal
 void LCD_Init(void);
 void LCD_UnInit(void);
 void LCD_Write(uint32_t address, uint8_t data);
@@ -31,18 +31,28 @@
  *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
  *  POSSIBILITY OF SUCH DAMAGE.
  */
+#include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include <vector>
+#include <set>
 #define SDL_MAIN_HANDLED
 #include "SDL.h"
 #include "mcu.h"
 #include "mcu_opcodes.h"
 #include "mcu_interrupt.h"
 #include "mcu_timer.h"
+#include "mcu_profile.h"
+#include "mcu_jit.h"
+#include "trace.h"
 #include "pcm.h"
 #include "lcd.h"
 #include "submcu.h"
 #include "midi.h"
+#include "midi_tx.h"
+#include "midi_file.h"
+#include "resampler.h"
+#include "audio.h"
 #include "utf8main.h"
 #include "utils/files.h"
 
@@ -51,6 +61,18 @@
 #include <limits.h>
 #endif
 
+#include <signal.h>
+#ifdef _WIN32
+#include <io.h>
+#endif
+#ifndef _WIN32
+#include <sys/time.h>
+#include <sys/wait.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 const char* rs_name[ROM_SET_COUNT] = {
     "SC-55mk2",
     "SC-55st",
@@ -142,18 +164,58 @@ static const int CARDRAM_SIZE = 0x8000; // JV880 only
 static const int ROMSM_SIZE = 0x1000;
 
 
-static int audio_buffer_size;
-static int audio_page_size;
-static short *sample_buffer;
-
-static int sample_read_ptr;
-static int sample_write_ptr;
-
-static SDL_AudioDeviceID sdl_audio;
+static int audio_rate_native;
+static int audio_rate_out;
+static bool audio_resample;
+static resampler_t resampler;
+static short resample_out[resampler_block_max * 4];
+static int resample_out_max;
+
+// samples are passed to the sink (or resampler) in blocks
+static const int audio_block_size = 64;
+static short audio_block[audio_block_size * 2];
+static int audio_block_count;
+static bool audio_block_done;
+static int audio_burst; // max samples written per block
+static uint64_t audio_frames_total; // native rate frames rendered
+
+// adaptive rate control
+static bool audio_ratectl;
+static double audio_latency; // seconds
+static int ratectl_target; // ring fill target, samples
+static double ratectl_fill;
+static double ratectl_integral;
+static double ratectl_adjust;
+static uint64_t audio_pace_t0;
+static uint64_t audio_pace_frames;
+
+// pull mode
+static bool audio_pull;
+// the work thread parks holding the emulator lock and lends the emulator to
+// the callback, which then never waits on the lock
+static SDL_atomic_t pull_parked; // set by the work thread, callback may step
+static SDL_atomic_t pull_busy; // callback is stepping
+static int pull_frames_due; // output frames the current callback still needs
+static int audio_out_rate_actual;
+static uint64_t pull_cb_max;
+static uint64_t pull_cb_total;
+static uint64_t pull_cb_count;
+static int pull_cb_max_len;
+// emulated cycle <-> wall clock mapping for stamping MIDI input
+static SDL_SpinLock input_clock_lock;
+static uint64_t input_clock_cycles;
+static uint64_t input_clock_time;
+static double input_clock_rate; // cycles per performance counter tick
+static uint64_t input_clock_span; // max cycles an event is scheduled ahead
+
+static const double ratectl_kp = 0.002;
+static const double ratectl_ki = 0.00002;
+static const double ratectl_max = 0.005; // +-0.5%
 
 void MCU_ErrorTrap(void)
 {
     printf("%.2x %.4x\n", mcu.cp, mcu.pc);
+    MCU_ITraceFault("error trap");
 }
 
 int mcu_mk1 = 0; // 0 - SC-55mkII, SC-55ST. 1 - SC-55, CM-300/SCC-1
@@ -162,6 +224,8 @@ int mcu_st = 0; // 0 - SC-55mk2, 1 - SC-55ST
 int mcu_jv880 = 0; // 0 - SC-55, 1 - JV880
 int mcu_scb55 = 0; // 0 - sub mcu (e.g SC-55mk2), 1 - no sub mcu (e.g SCB-55)
 int mcu_sc155 = 0; // 0 - SC-55(MK2), 1 - SC-155(MK2)
+int mcu_fast_uart = 0; // 1 - don't pace MIDI input at 31250 baud while no voice is playing
+int mcu_reference = 0; // 1 - use the straightforward implementations instead of the optimized ones
 
 static int ga_int[8];
 static int ga_int_enable = 0;
@@ -207,11 +271,12 @@ uint16_t MCU_SC155Sliders(uint32_t index)
     return 0x0;
 }
 
-uint16_t MCU_AnalogReadPin(uint32_t pin)
+template<class model>
+static uint16_t MCU_AnalogReadPin(uint32_t pin)
 {
-    if (mcu_cm300)
+    if (model::cm300())
         return 0;
-    if (mcu_jv880)
+    if (model::jv880())
     {
         if (pin == 1)
             return ANALOG_LEVEL_BATTERY;
@@ -226,7 +291,7 @@ READ_RCU:
         else
             return ANALOG_LEVEL_RCU_LOW;
     }
-    if (mcu_mk1)
+    if (model::mk1())
     {
         if (mcu_sc155 && (dev_register[DEV_P9DR] & 1) != 0)
         {
@@ -250,7 +315,7 @@ READ_RCU:
         }
         if (pin == 7)
         {
-            if (mcu_mk1)
+            if (model::mk1())
                 return ANALOG_LEVEL_BATTERY;
             switch ((io_sd >> 2) & 3)
             {
@@ -282,9 +347,10 @@ READ_RCU:
     }
 }
 
-void MCU_AnalogSample(int channel)
+template<class model>
+static void MCU_AnalogSample(int channel)
 {
-    int value = MCU_AnalogReadPin(channel);
+    int value = MCU_AnalogReadPin<model>(channel);
     int dest = (channel << 1) & 6;
     dev_register[DEV_ADDRAH + dest] = value >> 2;
     dev_register[DEV_ADDRAL + dest] = (value << 6) & 0xc0;
@@ -296,9 +362,53 @@ uint64_t analog_end_time;
 
 int ssr_rd = 0;
 
-uint32_t uart_write_ptr;
-uint32_t uart_read_ptr;
-uint8_t uart_buffer[uart_buffer_size];
+// MIDI input rings, one per producer thread so each is single producer,
+// single consumer and needs nothing but acquire/release ordering on its
+// indices. Indices are free running, the consumer (emulator thread) never
+// blocks and takes whichever head byte is due first.
+enum {
+    UART_SOURCE_MIDI = 0, // MIDI driver thread, MCU_PostUARTTimed
+    UART_SOURCE_UI, // main thread (UI test keys, resets), MCU_PostUART
+    UART_SOURCE_EMU, // emulator thread (--bench, --replay, --batch), MCU_PostUARTCycles
+    UART_SOURCE_COUNT
+};
+
+struct uart_ring_t {
+    SDL_atomic_t write_ptr;
+    SDL_atomic_t read_ptr;
+    SDL_atomic_t overflow; // bytes dropped
+    SDL_atomic_t max_fill;
+    uint32_t dropped; // producer side, bytes dropped since the last posted one
+    uint64_t ticks[uart_buffer_size]; // earliest delivery, in uart_ticks_per_cycle units
+    uint64_t time[uart_buffer_size]; // host arrival time, 0 if unknown
+    uint32_t gap[uart_buffer_size]; // bytes dropped just before this one
+    uint8_t data[uart_buffer_size];
+};
+
+static uart_ring_t uart_ring[UART_SOURCE_COUNT];
+
+static uint32_t uart_read_ptr[UART_SOURCE_COUNT]; // consumer copies
+static uint32_t uart_write_cache[UART_SOURCE_COUNT];
+static int uart_peeked; // ring of the byte MCU_UART_Peek returned
+
+struct midi_log_entry_t {
+    uint64_t ticks;
+    uint8_t data;
+};
+
+static FILE *midi_record; // log of bytes as they are taken by the firmware
+static std::vector<midi_log_entry_t> midi_replay;
+static size_t midi_replay_pos;
+
+// MIDI output ring, written by the emulator thread
+static struct {
+    SDL_atomic_t write_ptr;
+    SDL_atomic_t read_ptr;
+    SDL_atomic_t overflow;
+    uint8_t data[uart_buffer_size];
+} uart_tx_ring;
+
+int mcu_uart_tx_capture = 0;
 
 static uint8_t uart_rx_byte;
 static uint64_t uart_rx_delay;
@@ -400,11 +510,13 @@ void MCU_DeviceWrite(uint32_t address, uint8_t data)
         {
             dev_register[address] &= ~0x80;
             uart_tx_delay = mcu.cycles + 3000;
+            if (mcu_uart_tx_capture && (dev_register[DEV_SCR] & 32) != 0)
+                MCU_UART_TXPush(dev_register[DEV_TDR]);
             MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_UART_TX, 0);
         }
         if ((data & 0x40) == 0 && (ssr_rd & 0x40) != 0)
         {
-            uart_rx_delay = mcu.cycles + 3000;
+            uart_rx_delay = mcu.cycles + MCU_UART_RXGap();
             dev_register[address] &= ~0x40;
             MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_UART_RX, 0);
         }
@@ -515,7 +627,8 @@ void MCU_DeviceReset(void)
     dev_register[DEV_SSR] = 0x80;
 }
 
-void MCU_UpdateAnalog(uint64_t cycles)
+template<class model>
+static void MCU_UpdateAnalog(uint64_t cycles)
 {
     int ctrl = dev_register[DEV_ADCSR];
     int isscan = (ctrl & 16) != 0;
@@ -530,12 +643,12 @@ void MCU_UpdateAnalog(uint64_t cycles)
             {
                 int base = ctrl & 4;
                 for (int i = 0; i <= (ctrl & 3); i++)
-                    MCU_AnalogSample(base + i);
+                    MCU_AnalogSample<model>(base + i);
                 analog_end_time = cycles + 200;
             }
             else
             {
-                MCU_AnalogSample(ctrl & 7);
+                MCU_AnalogSample<model>(ctrl & 7);
                 dev_register[DEV_ADCSR] &= ~0x20;
                 analog_end_time = 0;
             }
@@ -559,10 +672,11 @@ uint8_t cardram[CARDRAM_SIZE];
 
 int rom2_mask = ROM2_SIZE - 1;
 
-uint8_t MCU_Read(uint32_t address)
+template<class model>
+uint8_t MCU_ReadImpl(uint32_t address)
 {
     uint32_t address_rom = address & 0x3ffff;
-    if (address & 0x80000 && !mcu_jv880)
+    if (address & 0x80000 && !model::jv880())
         address_rom |= 0x40000;
     uint8_t page = (address >> 16) & 0xf;
     address &= 0xffff;
@@ -574,14 +688,14 @@ uint8_t MCU_Read(uint32_t address)
             ret = rom1[address & 0x7fff];
         else
         {
-            if (!mcu_mk1)
+            if (!model::mk1())
             {
-                uint16_t base = mcu_jv880 ? 0xf000 : 0xe000;
+                uint16_t base = model::jv880() ? 0xf000 : 0xe000;
                 if (address >= base && address < (base | 0x400))
                 {
                     ret = PCM_Read(address & 0x3f);
                 }
-                else if (!mcu_scb55 && address >= 0xec00 && address < 0xf000)
+                else if (!model::scb55() && address >= 0xec00 && address < 0xf000)
                 {
                     ret = SM_SysRead(address & 0xff);
                 }
@@ -600,7 +714,7 @@ uint8_t MCU_Read(uint32_t address)
                 {
                     ret = ga_int_trigger;
                     ga_int_trigger = 0;
-                    MCU_Interrupt_SetRequest(mcu_jv880 ? INTERRUPT_SOURCE_IRQ0 : INTERRUPT_SOURCE_IRQ1, 0);
+                    MCU_Interrupt_SetRequest(model::jv880() ? INTERRUPT_SOURCE_IRQ0 : INTERRUPT_SOURCE_IRQ1, 0);
                 }
                 else
                 {
@@ -634,7 +748,7 @@ uint8_t MCU_Read(uint32_t address)
                 {
                     io_sd = address & 0xff;
 
-                    if (mcu_cm300)
+                    if (model::cm300())
                         return 0xff;
 
                     LCD_Enable((io_sd & 8) != 0);
@@ -696,40 +810,40 @@ uint8_t MCU_Read(uint32_t address)
         ret = rom2[address_rom & rom2_mask];
         break;
     case 8:
-        if (!mcu_jv880)
+        if (!model::jv880())
             ret = rom2[address_rom & rom2_mask];
         else
             ret = 0xff;
         break;
     case 9:
-        if (!mcu_jv880)
+        if (!model::jv880())
             ret = rom2[address_rom & rom2_mask];
         else
             ret = 0xff;
         break;
     case 14:
     case 15:
-        if (!mcu_jv880)
+        if (!model::jv880())
             ret = rom2[address_rom & rom2_mask];
         else
             ret = cardram[address & 0x7fff]; // FIXME
         break;
     case 10:
     case 11:
-        if (!mcu_mk1)
+        if (!model::mk1())
             ret = sram[address & 0x7fff]; // FIXME
         else
             ret = 0xff;
         break;
     case 12:
     case 13:
-        if (mcu_jv880)
+        if (model::jv880())
             ret = nvram[address & 0x7fff]; // FIXME
         else
             ret = 0xff;
         break;
     case 5:
-        if (mcu_mk1)
+        if (model::mk1())
             ret = sram[address & 0x7fff]; // FIXME
         else
             ret = 0xff;
@@ -741,12 +855,13 @@ uint8_t MCU_Read(uint32_t address)
     return ret;
 }
 
-uint16_t MCU_Read16(uint32_t address)
+template<class model>
+uint16_t MCU_Read16Impl(uint32_t address)
 {
     address &= ~1;
     uint8_t b0, b1;
-    b0 = MCU_Read(address);
-    b1 = MCU_Read(address+1);
+    b0 = MCU_ReadImpl<model>(address);
+    b1 = MCU_ReadImpl<model>(address+1);
     return (b0 << 8) + b1;
 }
 
@@ -761,7 +876,8 @@ uint32_t MCU_Read32(uint32_t address)
     return (b0 << 24) + (b1 << 16) + (b2 << 8) + b3;
 }
 
-void MCU_Write(uint32_t address, uint8_t value)
+template<class model>
+void MCU_WriteImpl(uint32_t address, uint8_t value)
 {
     uint8_t page = (address >> 16) & 0xf;
     address &= 0xffff;
@@ -769,9 +885,9 @@ void MCU_Write(uint32_t address, uint8_t value)
     {
         if (address & 0x8000)
         {
-            if (!mcu_mk1)
+            if (!model::mk1())
             {
-                uint16_t base = mcu_jv880 ? 0xf000 : 0xe000;
+                uint16_t base = model::jv880() ? 0xf000 : 0xe000;
                 if (address >= (base | 0x400) && address < (base | 0x800))
                 {
                     if (address == (base | 0x404) || address == (base | 0x405))
@@ -800,7 +916,7 @@ void MCU_Write(uint32_t address, uint8_t value)
                 {
                     PCM_Write(address & 0x3f, value);
                 }
-                else if (!mcu_scb55 && address >= 0xec00 && address < 0xf000)
+                else if (!model::scb55() && address >= 0xec00 && address < 0xf000)
                 {
                     SM_SysWrite(address & 0xff, value);
                 }
@@ -866,7 +982,7 @@ void MCU_Write(uint32_t address, uint8_t value)
                 }
             }
         }
-        else if (mcu_jv880 && address >= 0x6196 && address <= 0x6199)
+        else if (model::jv880() && address >= 0x6196 && address <= 0x6199)
         {
             // nop: the jv880 rom writes into the rom at 002E77-002E7D
         }
@@ -875,19 +991,19 @@ void MCU_Write(uint32_t address, uint8_t value)
             printf("Unknown write %x %x\n", address, value);
         }
     }
-    else if (page == 5 && mcu_mk1)
+    else if (page == 5 && model::mk1())
     {
         sram[address & 0x7fff] = value; // FIXME
     }
-    else if (page == 10 && !mcu_mk1)
+    else if (page == 10 && !model::mk1())
     {
         sram[address & 0x7fff] = value; // FIXME
     }
-    else if (page == 12 && mcu_jv880)
+    else if (page == 12 && model::jv880())
     {
         nvram[address & 0x7fff] = value; // FIXME
     }
-    else if (page == 14 && mcu_jv880)
+    else if (page == 14 && model::jv880())
     {
         cardram[address & 0x7fff] = value; // FIXME
     }
@@ -897,18 +1013,247 @@ void MCU_Write(uint32_t address, uint8_t value)
     }
 }
 
-void MCU_Write16(uint32_t address, uint16_t value)
+template<class model>
+void MCU_Write16Impl(uint32_t address, uint16_t value)
 {
     address &= ~1;
-    MCU_Write(address, value >> 8);
-    MCU_Write(address + 1, value & 0xff);
+    MCU_WriteImpl<model>(address, value >> 8);
+    MCU_WriteImpl<model>(address + 1, value & 0xff);
+}
+
+uint8_t (*MCU_Read)(uint32_t address) = MCU_ReadImpl<mcu_model_any_t>;
+uint16_t (*MCU_Read16)(uint32_t address) = MCU_Read16Impl<mcu_model_any_t>;
+void (*MCU_Write)(uint32_t address, uint8_t value) = MCU_WriteImpl<mcu_model_any_t>;
+void (*MCU_Write16)(uint32_t address, uint16_t value) = MCU_Write16Impl<mcu_model_any_t>;
+
+#define MEMORY_INSTANTIATE(model) \
+    template uint8_t MCU_ReadImpl<model>(uint32_t address); \
+    template uint16_t MCU_Read16Impl<model>(uint32_t address); \
+    template void MCU_WriteImpl<model>(uint32_t address, uint8_t value); \
+    template void MCU_Write16Impl<model>(uint32_t address, uint16_t value);
+MCU_MODEL_INSTANTIATE(MEMORY_INSTANTIATE)
+#undef MEMORY_INSTANTIATE
+
+#ifdef USE_INSTRUCTION_TRACE
+// last executed instructions, for crash and hang diagnosis
+struct mcu_itrace_t {
+    uint64_t cycles;
+    uint16_t r[8];
+    uint16_t pc;
+    uint16_t sr;
+    uint8_t cp;
+    uint8_t dp;
+    uint8_t ep;
+    mcu_itrace_code_t code;
+};
+
+static const uint32_t itrace_size = 4096; // power of 2
+static mcu_itrace_t itrace[itrace_size];
+static uint32_t itrace_ptr;
+// takes no bytes, for code fetched outside MCU_ReadInstruction (translated code)
+static mcu_itrace_code_t itrace_code_none = { { 0 }, sizeof(itrace_code_none.bytes) };
+mcu_itrace_code_t *mcu_itrace_code = &itrace_code_none;
+#endif
+static bool itrace_faulted;
+
+// last instruction the reference decoder fetched, --lockstep names it in
+// reports without reading memory again
+static struct {
+    uint16_t pc;
+    uint8_t cp;
+    uint8_t opcode;
+    bool valid;
+} lockstep_fetch;
+
+#ifdef USE_INSTRUCTION_TRACE
+// The dump is formatted by hand into a line buffer so the crash handler can
+// use it too: no stdio, no allocation, only write(2) on stderr's descriptor
+// when f is NULL.
+struct mcu_itrace_line_t {
+    char buf[160];
+    int len;
+};
+
+static void MCU_ITraceStr(mcu_itrace_line_t *l, const char *s)
+{
+    while (*s && l->len < (int)sizeof(l->buf))
+        l->buf[l->len++] = *s++;
+}
+
+static void MCU_ITraceHex(mcu_itrace_line_t *l, uint32_t v, int digits)
+{
+    static const char hex[] = "0123456789abcdef";
+    while (digits-- > 0 && l->len < (int)sizeof(l->buf))
+        l->buf[l->len++] = hex[(v >> (digits * 4)) & 15];
+}
+
+// right aligned in width
+static void MCU_ITraceDec(mcu_itrace_line_t *l, uint64_t v, int width)
+{
+    char digits[20];
+    int n = 0;
+    do
+    {
+        digits[n++] = (char)('0' + v % 10);
+        v /= 10;
+    } while (v);
+    for (int i = n; i < width; i++)
+        MCU_ITraceStr(l, " ");
+    while (n > 0 && l->len < (int)sizeof(l->buf))
+        l->buf[l->len++] = digits[--n];
+}
+
+static void MCU_ITraceFlush(FILE *f, mcu_itrace_line_t *l)
+{
+    const char *p = l->buf;
+    size_t len = l->len;
+    l->len = 0;
+    if (f)
+    {
+        fwrite(p, 1, len, f);
+        return;
+    }
+    while (len > 0)
+    {
+#ifdef _WIN32
+        int n = _write(2, p, (unsigned int)len);
+#else
+        ssize_t n = write(2, p, len);
+#endif
+        if (n <= 0)
+            break;
+        p += n;
+        len -= n;
+    }
+}
+
+static void MCU_ITraceFormat(FILE *f, const char *reason)
+{
+    mcu_itrace_line_t l;
+    l.len = 0;
+    uint32_t count = itrace_ptr < itrace_size ? itrace_ptr : itrace_size;
+    MCU_ITraceStr(&l, "Instruction trace (");
+    MCU_ITraceStr(&l, reason);
+    MCU_ITraceStr(&l, "), last ");
+    MCU_ITraceDec(&l, count, 0);
+    MCU_ITraceStr(&l, " instructions, oldest first:\n");
+    MCU_ITraceFlush(f, &l);
+    MCU_ITraceStr(&l, "       cycle cp:pc   code         r0   r1   r2   r3   r4   r5   r6   r7   sr   dp ep\n");
+    MCU_ITraceFlush(f, &l);
+    for (uint32_t i = itrace_ptr - count; i != itrace_ptr; i++)
+    {
+        const mcu_itrace_t *it = &itrace[i & (itrace_size - 1)];
+        MCU_ITraceDec(&l, it->cycles, 12);
+        MCU_ITraceStr(&l, " ");
+        MCU_ITraceHex(&l, it->cp, 2);
+        MCU_ITraceStr(&l, ":");
+        MCU_ITraceHex(&l, it->pc, 4);
+        MCU_ITraceStr(&l, " ");
+        // the code bytes the instruction fetched, up to 4
+        for (int j = 0; j < (int)sizeof(it->code.bytes); j++)
+        {
+            if (j)
+                MCU_ITraceStr(&l, " ");
+            if (j < it->code.length)
+                MCU_ITraceHex(&l, it->code.bytes[j], 2);
+            else
+                MCU_ITraceStr(&l, "  ");
+        }
+        MCU_ITraceStr(&l, " ");
+        for (int j = 0; j < 8; j++)
+        {
+            MCU_ITraceStr(&l, " ");
+            MCU_ITraceHex(&l, it->r[j], 4);
+        }
+        MCU_ITraceStr(&l, " ");
+        MCU_ITraceHex(&l, it->sr, 4);
+        MCU_ITraceStr(&l, " ");
+        MCU_ITraceHex(&l, it->dp, 2);
+        MCU_ITraceStr(&l, " ");
+        MCU_ITraceHex(&l, it->ep, 2);
+        MCU_ITraceStr(&l, "\n");
+        MCU_ITraceFlush(f, &l);
+    }
+    MCU_ITraceStr(&l, "now at ");
+    MCU_ITraceHex(&l, mcu.cp, 2);
+    MCU_ITraceStr(&l, ":");
+    MCU_ITraceHex(&l, mcu.pc, 4);
+    MCU_ITraceStr(&l, ", cycle ");
+    MCU_ITraceDec(&l, mcu.cycles, 0);
+    MCU_ITraceStr(&l, "\n");
+    MCU_ITraceFlush(f, &l);
+}
+#endif
+
+void MCU_ITraceDump(FILE *f, const char *reason)
+{
+#ifdef USE_INSTRUCTION_TRACE
+    MCU_ITraceFormat(f, reason);
+#else
+    fprintf(f, "Instruction trace (%s) not available, built without USE_INSTRUCTION_TRACE.\n", reason);
+#endif
+    fflush(f);
+}
+
+void MCU_ITraceFault(const char *reason)
+{
+    // a misbehaving firmware keeps faulting, the first trace is the useful one
+    if (itrace_faulted)
+        return;
+    itrace_faulted = true;
+    MCU_ITraceDump(stderr, reason);
+}
+
+#ifdef USE_INSTRUCTION_TRACE
+static void MCU_ITraceCrash(int sig)
+{
+    // stdio may be what crashed or hold its lock, so only write(2)
+    const char *reason = "crash";
+    if (sig == SIGSEGV)
+        reason = "SIGSEGV";
+    else if (sig == SIGILL)
+        reason = "SIGILL";
+    else if (sig == SIGFPE)
+        reason = "SIGFPE";
+    MCU_ITraceFormat(NULL, reason);
+    signal(sig, SIG_DFL);
+    raise(sig);
 }
+#endif
 
+template<class model>
 void MCU_ReadInstruction(void)
 {
-    uint8_t operand = MCU_ReadCodeAdvance();
+#ifdef USE_INSTRUCTION_TRACE
+    mcu_itrace_t *it = &itrace[itrace_ptr++ & (itrace_size - 1)];
+    it->cycles = mcu.cycles;
+    memcpy(it->r, mcu.r, sizeof(it->r));
+    it->pc = mcu.pc;
+    it->sr = mcu.sr;
+    it->cp = mcu.cp;
+    it->dp = mcu.dp;
+    it->ep = mcu.ep;
+    it->code.length = 0;
+    mcu_itrace_code = &it->code;
+#endif
+    uint8_t operand = MCU_ReadCodeAdvance<model>();
+    if (model::any())
+    {
+        lockstep_fetch.pc = mcu.pc - 1;
+        lockstep_fetch.cp = mcu.cp;
+        lockstep_fetch.opcode = operand;
+        lockstep_fetch.valid = true;
+    }
 
-    MCU_Operand_Table[operand](operand);
+#ifdef MCU_THREADED_DISPATCH
+    if (!mcu_reference)
+        MCU_Operand_Threaded<model>(operand);
+    else
+#endif
+    mcu_opcode_tables_t<model>::operand[operand](operand);
+#ifdef USE_INSTRUCTION_TRACE
+    mcu_itrace_code = &itrace_code_none;
+#endif
 
     if (mcu.sr & STATUS_T)
     {
@@ -916,6 +1261,10 @@ void MCU_ReadInstruction(void)
     }
 }
 
+#define READINSTRUCTION_INSTANTIATE(model) template void MCU_ReadInstruction<model>(void);
+MCU_MODEL_INSTANTIATE(READINSTRUCTION_INSTANTIATE)
+#undef READINSTRUCTION_INSTANTIATE
+
 void MCU_Init(void)
 {
     memset(&mcu, 0, sizeof(mcu_t));
@@ -956,18 +1305,329 @@ void MCU_Reset(void)
     }
 }
 
+static uint64_t MCU_GetInputCycles(uint64_t now)
+{
+    if (!audio_pull && !audio_ratectl)
+        return 0; // deliver as soon as possible
+
+    SDL_AtomicLock(&input_clock_lock);
+    uint64_t cycles = input_clock_cycles;
+    uint64_t time = input_clock_time;
+    double rate = input_clock_rate;
+    uint64_t span = input_clock_span;
+    SDL_AtomicUnlock(&input_clock_lock);
+
+    if (!time)
+        return 0;
+
+    // place the event at the same offset into the emulated timeline as it
+    // arrived into the wall clock one, so latency is constant instead of jittering
+    if (now < time)
+        return cycles;
+    uint64_t offset = (uint64_t)((double)(now - time) * rate);
+    if (offset > span)
+        offset = span;
+    return cycles + offset;
+}
+
+int MCU_UART_RXGap(void)
+{
+    // one byte at 31250 baud
+    if (!mcu_fast_uart)
+        return 3000;
+
+    // firmware idle: next byte as soon as the current one was taken
+    if ((pcm.voice_mask & pcm.voice_mask_pending) == 0)
+        return 24;
+
+    return 3000;
+}
+
+// MIDI in to audio out latency, since the previous stats report
+static SDL_SpinLock midi_latency_lock;
+static uint32_t midi_latency_count;
+static double midi_latency_sum;
+static double midi_latency_min;
+static double midi_latency_max;
+
+// Called as the firmware takes a byte: time it waited to get here plus the
+// audio already queued ahead of what the byte will affect.
+static void MCU_StatsMIDILatency(uint64_t time)
+{
+    double freq = (double)SDL_GetPerformanceFrequency();
+    uint64_t now = SDL_GetPerformanceCounter();
+    double latency = now > time ? (double)(now - time) / freq : 0.0;
+    int fill = audio_sink->get_fill();
+    if (fill > 0)
+        latency += (double)(fill / 2) / (double)audio_out_rate_actual;
+    latency += (double)audio_block_size / (double)audio_rate_native;
+
+    SDL_AtomicLock(&midi_latency_lock);
+    if (midi_latency_count == 0 || latency < midi_latency_min)
+        midi_latency_min = latency;
+    if (midi_latency_count == 0 || latency > midi_latency_max)
+        midi_latency_max = latency;
+    midi_latency_sum += latency;
+    midi_latency_count++;
+    SDL_AtomicUnlock(&midi_latency_lock);
+}
+
+static void MCU_UART_Post(int source, uint8_t data, uint64_t ticks, uint64_t time)
+{
+    uart_ring_t *ring = &uart_ring[source];
+    // only this producer moves write_ptr
+    uint32_t write_ptr = (uint32_t)SDL_AtomicGet(&ring->write_ptr);
+    uint32_t fill = write_ptr - (uint32_t)SDL_AtomicGet(&ring->read_ptr);
+    if (fill >= uart_buffer_size)
+    {
+        SDL_AtomicAdd(&ring->overflow, 1);
+        ring->dropped++;
+        return;
+    }
+    SDL_MemoryBarrierAcquire(); // the consumer is done with the slot
+    ring->ticks[write_ptr & (uart_buffer_size - 1)] = ticks;
+    ring->time[write_ptr & (uart_buffer_size - 1)] = time;
+    ring->gap[write_ptr & (uart_buffer_size - 1)] = ring->dropped;
+    ring->data[write_ptr & (uart_buffer_size - 1)] = data;
+    ring->dropped = 0;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring->write_ptr, (int)(write_ptr + 1));
+    if ((int)(fill + 1) > SDL_AtomicGet(&ring->max_fill))
+        SDL_AtomicSet(&ring->max_fill, (int)(fill + 1));
+}
+
+void MCU_PostUARTCycles(uint8_t data, uint64_t cycles)
+{
+    MCU_UART_Post(UART_SOURCE_EMU, data, cycles * uart_ticks_per_cycle, 0);
+}
+
+static void MCU_UART_PostTimed(int source, uint8_t data, uint64_t time)
+{
+    if (trace_enabled)
+        TRACE_Instant("MIDI in", "byte", data);
+    MCU_UART_Post(source, data, MCU_GetInputCycles(time) * uart_ticks_per_cycle, time);
+}
+
+void MCU_PostUARTTimed(uint8_t data, uint64_t time)
+{
+    MCU_UART_PostTimed(UART_SOURCE_MIDI, data, time);
+}
+
 void MCU_PostUART(uint8_t data)
 {
-    uart_buffer[uart_write_ptr] = data;
-    uart_write_ptr = (uart_write_ptr + 1) % uart_buffer_size;
+    MCU_UART_PostTimed(UART_SOURCE_UI, data, SDL_GetPerformanceCounter());
+}
+
+static inline bool MCU_UART_Head(int source)
+{
+    if (uart_read_ptr[source] == uart_write_cache[source])
+    {
+        uart_write_cache[source] = (uint32_t)SDL_AtomicGet(&uart_ring[source].write_ptr);
+        if (uart_read_ptr[source] == uart_write_cache[source]) // no byte
+            return false;
+        SDL_MemoryBarrierAcquire();
+    }
+    return true;
+}
+
+bool MCU_UART_Peek(uint64_t *ticks)
+{
+    bool found = false;
+    for (int i = 0; i < UART_SOURCE_COUNT; i++)
+    {
+        if (!MCU_UART_Head(i))
+            continue;
+        uint64_t t = uart_ring[i].ticks[uart_read_ptr[i] & (uart_buffer_size - 1)];
+        if (!found || t < *ticks)
+        {
+            *ticks = t;
+            uart_peeked = i;
+            found = true;
+        }
+    }
+    return found;
+}
+
+uint8_t MCU_UART_Pop(uint64_t ticks)
+{
+    uart_ring_t *ring = &uart_ring[uart_peeked];
+    uint32_t &read_ptr = uart_read_ptr[uart_peeked];
+    uint8_t data = ring->data[read_ptr & (uart_buffer_size - 1)];
+    uint64_t time = ring->time[read_ptr & (uart_buffer_size - 1)];
+    uint32_t gap = ring->gap[read_ptr & (uart_buffer_size - 1)];
+    read_ptr++;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring->read_ptr, (int)read_ptr);
+    if (time && audio_sink->realtime)
+        MCU_StatsMIDILatency(time);
+    if (gap)
+    {
+        // bytes lost to a full ring, marked where they were in the stream
+        if (trace_enabled)
+            TRACE_Instant("MIDI in dropped", "bytes", gap);
+        if (midi_record)
+            fprintf(midi_record, "# %llu dropped %u\n", (unsigned long long)ticks, gap);
+    }
+    if (midi_record)
+        fprintf(midi_record, "%llu %02x\n", (unsigned long long)ticks, data);
+    return data;
+}
+
+int MCU_RecordOpen(const char *path)
+{
+    midi_record = Files::utf8_fopen(path, "w");
+    if (!midi_record)
+    {
+        fprintf(stderr, "ERROR: Failed to open the MIDI log %s.\n", path);
+        return 0;
+    }
+    fprintf(midi_record, "# nuked-sc55 MIDI log: <time> <byte>, time in sub mcu clocks (%d per mcu cycle) since reset\n",
+            (int)uart_ticks_per_cycle);
+    fprintf(midi_record, "romset %s\n", rs_name[romset]);
+    fprintf(midi_record, "fastuart %d\n", mcu_fast_uart);
+    return 1;
+}
+
+void MCU_RecordClose(void)
+{
+    if (midi_record)
+        fclose(midi_record);
+    midi_record = NULL;
+}
+
+int MCU_ReplayOpen(const char *path)
+{
+    FILE *f = Files::utf8_fopen(path, "r");
+    if (!f)
+    {
+        fprintf(stderr, "ERROR: Failed to open the MIDI log %s.\n", path);
+        return 0;
+    }
+
+    midi_replay.clear();
+    midi_replay_pos = 0;
+
+    char line[256];
+    int lineno = 0;
+    while (fgets(line, sizeof(line), f))
+    {
+        lineno++;
+        char name[64];
+        unsigned long long ticks;
+        unsigned int data;
+        int value;
+        if (line[0] == '#' || line[0] == '\n')
+            continue;
+        if (sscanf(line, "romset %63s", name) == 1)
+        {
+            if (strcmp(name, rs_name[romset]))
+            {
+                fprintf(stderr, "ERROR: MIDI log was recorded with %s, not %s.\n", name, rs_name[romset]);
+                fclose(f);
+                return 0;
+            }
+        }
+        else if (sscanf(line, "fastuart %d", &value) == 1)
+            mcu_fast_uart = value;
+        else if (sscanf(line, "%llu %x", &ticks, &data) == 2)
+        {
+            midi_log_entry_t entry = { ticks, (uint8_t)data };
+            midi_replay.push_back(entry);
+        }
+        else
+        {
+            fprintf(stderr, "ERROR: %s:%d: bad MIDI log line.\n", path, lineno);
+            fclose(f);
+            return 0;
+        }
+    }
+    fclose(f);
+
+    printf("MIDI log: %u bytes\n", (unsigned)midi_replay.size());
+    return 1;
+}
+
+// no room to post, for producers on the emulator thread
+static inline bool MCU_UART_Full(void)
+{
+    return (uint32_t)SDL_AtomicGet(&uart_ring[UART_SOURCE_EMU].write_ptr)
+        - uart_read_ptr[UART_SOURCE_EMU] >= uart_buffer_size;
+}
+
+// Tops up the UART ring from the log. Entries carry the exact time the
+// firmware took them, so it takes them at the same instruction again.
+static inline void MCU_ReplayFeed(void)
+{
+    while (midi_replay_pos < midi_replay.size())
+    {
+        if (MCU_UART_Full())
+            return;
+        MCU_UART_Post(UART_SOURCE_EMU, midi_replay[midi_replay_pos].data, midi_replay[midi_replay_pos].ticks, 0);
+        midi_replay_pos++;
+    }
+}
+
+// All of the log is posted and its last byte is due. Doesn't wait for the
+// ring to drain, a firmware that diverged from the recording may never
+// take the rest.
+static bool MCU_ReplayDone(void)
+{
+    if (midi_replay_pos != midi_replay.size())
+        return false;
+    return midi_replay.empty() || mcu.cycles * uart_ticks_per_cycle >= midi_replay.back().ticks;
+}
+
+void MCU_UART_TXPush(uint8_t data)
+{
+    uint32_t write_ptr = (uint32_t)SDL_AtomicGet(&uart_tx_ring.write_ptr);
+    if (write_ptr - (uint32_t)SDL_AtomicGet(&uart_tx_ring.read_ptr) >= uart_buffer_size)
+    {
+        SDL_AtomicAdd(&uart_tx_ring.overflow, 1);
+        return;
+    }
+    uart_tx_ring.data[write_ptr & (uart_buffer_size - 1)] = data;
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&uart_tx_ring.write_ptr, (int)(write_ptr + 1));
+}
+
+int MCU_UART_TXRead(uint8_t *data, int max)
+{
+    uint32_t read_ptr = (uint32_t)SDL_AtomicGet(&uart_tx_ring.read_ptr);
+    uint32_t write_ptr = (uint32_t)SDL_AtomicGet(&uart_tx_ring.write_ptr);
+    SDL_MemoryBarrierAcquire();
+    int count = 0;
+    while (read_ptr != write_ptr && count < max)
+    {
+        data[count++] = uart_tx_ring.data[read_ptr & (uart_buffer_size - 1)];
+        read_ptr++;
+    }
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&uart_tx_ring.read_ptr, (int)read_ptr);
+    return count;
+}
+
+uint32_t MCU_UART_TXGetOverflow(void)
+{
+    return (uint32_t)SDL_AtomicGet(&uart_tx_ring.overflow);
+}
+
+void MCU_UART_GetStats(uint32_t *overflow, uint32_t *max_fill)
+{
+    *overflow = 0;
+    *max_fill = 0;
+    for (int i = 0; i < UART_SOURCE_COUNT; i++)
+    {
+        *overflow += (uint32_t)SDL_AtomicGet(&uart_ring[i].overflow);
+        uint32_t fill = (uint32_t)SDL_AtomicGet(&uart_ring[i].max_fill);
+        if (fill > *max_fill)
+            *max_fill = fill;
+    }
 }
 
 void MCU_UpdateUART_RX(void)
 {
     if ((dev_register[DEV_SCR] & 16) == 0) // RX disabled
         return;
-    if (uart_write_ptr == uart_read_ptr) // no byte
-        return;
 
     if (dev_register[DEV_SSR] & 0x40)
         return;
@@ -975,13 +1635,18 @@ void MCU_UpdateUART_RX(void)
     if (mcu.cycles < uart_rx_delay)
         return;
 
-    uart_rx_byte = uart_buffer[uart_read_ptr];
-    uart_read_ptr = (uart_read_ptr + 1) % uart_buffer_size;
+    uint64_t ticks;
+    if (!MCU_UART_Peek(&ticks)) // no byte
+        return;
+
+    if (mcu.cycles * uart_ticks_per_cycle < ticks)
+        return;
+
+    uart_rx_byte = MCU_UART_Pop(mcu.cycles * uart_ticks_per_cycle);
     dev_register[DEV_SSR] |= 0x40;
     MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_UART_RX, (dev_register[DEV_SCR] & 0x40) != 0);
 }
 
-// dummy TX
 void MCU_UpdateUART_TX(void)
 {
     if ((dev_register[DEV_SCR] & 32) == 0) // TX disabled
@@ -995,17 +1660,22 @@ void MCU_UpdateUART_TX(void)
 
     dev_register[DEV_SSR] |= 0x80;
     MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_UART_TX, (dev_register[DEV_SCR] & 0x80) != 0);
-
-    // printf("tx:%x\n", dev_register[DEV_TDR]);
 }
 
 static bool work_thread_run = false;
 
 static SDL_mutex *work_thread_lock;
 
+static SDL_atomic_t work_thread_waiters;
+
 void MCU_WorkThread_Lock(void)
 {
+    uint64_t t0 = trace_enabled ? SDL_GetPerformanceCounter() : 0;
+    SDL_AtomicAdd(&work_thread_waiters, 1);
     SDL_LockMutex(work_thread_lock);
+    SDL_AtomicAdd(&work_thread_waiters, -1);
+    if (trace_enabled)
+        TRACE_Span("lock wait", t0, SDL_GetPerformanceCounter());
 }
 
 void MCU_WorkThread_Unlock(void)
@@ -1013,403 +1683,2104 @@ void MCU_WorkThread_Unlock(void)
     SDL_UnlockMutex(work_thread_lock);
 }
 
-int SDLCALL work_thread(void* data)
+static double MCU_AudioAhead(void)
 {
-    work_thread_lock = SDL_CreateMutex();
+    uint64_t now = SDL_GetPerformanceCounter();
+    if (!audio_pace_t0)
+        audio_pace_t0 = now;
+    double wall = (double)(now - audio_pace_t0) / (double)SDL_GetPerformanceFrequency();
+    double emu = (double)audio_pace_frames / (double)audio_rate_native;
+    return emu - wall;
+}
 
-    MCU_WorkThread_Lock();
-    while (work_thread_run)
+// In rate controlled mode the emulator is paced to run audio_latency ahead of
+// the wall clock, stamp input so that it lands at the same distance.
+// -lat is the normal realtime mode, without this mapping arrival stamps
+// (the -alsa kernel timestamps, the RtMidi receive time) would only be
+// honoured with -pull and input would land wherever the work thread
+// happened to be rendering.
+static void MCU_AudioPaceClock(void)
+{
+    static uint64_t last_cycles;
+    static uint64_t last_frames;
+
+    uint64_t cycles = mcu.cycles;
+    uint64_t frames = audio_pace_frames;
+    double emu = (double)frames / (double)audio_rate_native - audio_latency;
+    if (!audio_pace_t0 || frames <= last_frames || emu < 0.0)
     {
-        if (pcm.config_reg_3c & 0x40)
-            sample_write_ptr &= ~3;
-        else
-            sample_write_ptr &= ~1;
-        if (sample_read_ptr == sample_write_ptr)
-        {
-            MCU_WorkThread_Unlock();
-            while (sample_read_ptr == sample_write_ptr)
-            {
-                SDL_Delay(1);
-            }
-            MCU_WorkThread_Lock();
-        }
+        last_cycles = cycles;
+        last_frames = frames;
+        return;
+    }
 
-        if (!mcu.ex_ignore)
-            MCU_Interrupt_Handle();
-        else
-            mcu.ex_ignore = 0;
+    double freq = (double)SDL_GetPerformanceFrequency();
+    double rate = (double)(cycles - last_cycles) * (double)audio_rate_native / ((double)(frames - last_frames) * freq);
+    last_cycles = cycles;
+    last_frames = frames;
+
+    SDL_AtomicLock(&input_clock_lock);
+    input_clock_cycles = cycles;
+    input_clock_time = audio_pace_t0 + (uint64_t)(emu * freq);
+    input_clock_rate = rate;
+    input_clock_span = (uint64_t)(audio_latency * freq * rate);
+    SDL_AtomicUnlock(&input_clock_lock);
+}
 
-        if (!mcu.sleep)
-            MCU_ReadInstruction();
+static void MCU_AudioRateControl(void)
+{
+    int fill = audio_sink->get_fill();
+    if (fill < 0)
+        fill = 0;
+
+    ratectl_fill += (fill - ratectl_fill) * 0.01;
+    double err = (ratectl_fill - ratectl_target) / ratectl_target;
+
+    ratectl_integral += err * ratectl_ki;
+    if (ratectl_integral > ratectl_max)
+        ratectl_integral = ratectl_max;
+    else if (ratectl_integral < -ratectl_max)
+        ratectl_integral = -ratectl_max;
+
+    // more buffered than wanted -> larger step -> fewer output frames
+    double adjust = err * ratectl_kp + ratectl_integral;
+    if (adjust > ratectl_max)
+        adjust = ratectl_max;
+    else if (adjust < -ratectl_max)
+        adjust = -ratectl_max;
+    ratectl_adjust = 1.0 + adjust;
+    RESAMPLER_SetRatioAdjust(&resampler, ratectl_adjust);
+}
 
-        mcu.cycles += 12; // FIXME: assume 12 cycles per instruction
+// --bench profiling: the part of MCU_Step currently executing, sampled by
+// SIGALRM on a wall clock timer
+enum {
+    BENCH_PHASE_OTHER = 0,
+    BENCH_PHASE_INTERRUPT,
+    BENCH_PHASE_INSTRUCTION,
+    BENCH_PHASE_PCM,
+    BENCH_PHASE_TIMER,
+    BENCH_PHASE_SUBMCU,
+    BENCH_PHASE_UART, // models without a sub MCU service the UART directly
+    BENCH_PHASE_MAX
+};
 
-        // if (mcu.cycles % 24000000 == 0)
-        //     printf("seconds: %i\n", (int)(mcu.cycles / 24000000));
+static volatile sig_atomic_t bench_phase;
+static volatile uint32_t bench_samples[BENCH_PHASE_MAX];
+static uint64_t bench_instructions;
 
-        PCM_Update(mcu.cycles);
+static uint64_t jit_steps; // steps done by the current MCU_JIT_Run
+static uint64_t jit_frames;
+static uint64_t jit_budget = UINT64_MAX;
 
-        TIMER_Clock(mcu.cycles);
+// Everything of a step after the instruction
+template <bool bench, class model>
+static inline void MCU_StepPeripherals(void)
+{
+    mcu.cycles += 12; // FIXME: assume 12 cycles per instruction
 
-        if (!mcu_mk1 && !mcu_jv880 && !mcu_scb55)
-            SM_Update(mcu.cycles);
-        else
-        {
-            MCU_UpdateUART_RX();
-            MCU_UpdateUART_TX();
-        }
+    // if (mcu.cycles % 24000000 == 0)
+    //     printf("seconds: %i\n", (int)(mcu.cycles / 24000000));
 
-        MCU_UpdateAnalog(mcu.cycles);
+    if (bench)
+        bench_phase = BENCH_PHASE_PCM;
+    PCM_Update<model>(mcu.cycles);
 
-        if (mcu_mk1)
+    if (bench)
+        bench_phase = BENCH_PHASE_TIMER;
+    TIMER_Clock<model>(mcu.cycles);
+
+    if (!model::mk1() && !model::jv880() && !model::scb55())
+    {
+        if (bench)
+            bench_phase = BENCH_PHASE_SUBMCU;
+        SM_Update(mcu.cycles);
+    }
+    else
+    {
+        if (bench)
+            bench_phase = BENCH_PHASE_UART;
+        MCU_UpdateUART_RX();
+        MCU_UpdateUART_TX();
+    }
+
+    if (bench)
+        bench_phase = BENCH_PHASE_OTHER;
+    MCU_UpdateAnalog<model>(mcu.cycles);
+
+    if (model::mk1())
+    {
+        if (ga_lcd_counter)
         {
-            if (ga_lcd_counter)
+            ga_lcd_counter--;
+            if (ga_lcd_counter == 0)
             {
-                ga_lcd_counter--;
-                if (ga_lcd_counter == 0)
-                {
-                    MCU_GA_SetGAInt(1, 0);
-                    MCU_GA_SetGAInt(1, 1);
-                }
+                MCU_GA_SetGAInt(1, 0);
+                MCU_GA_SetGAInt(1, 1);
             }
         }
     }
-    MCU_WorkThread_Unlock();
-
-    SDL_DestroyMutex(work_thread_lock);
-
-    return 0;
 }
 
-static void MCU_Run()
+// Called by translated code after each instruction, finishes the step like
+// MCU_StepImpl would. Nonzero leaves the translated code: the next step has
+// to start an interrupt, skip the instruction or stop.
+template <bool bench, class model>
+static int MCU_JIT_Tail(void)
 {
-    bool working = true;
-
-    work_thread_run = true;
-    SDL_Thread *thread = SDL_CreateThread(work_thread, "work thread", 0);
-
-    while (working)
+    if (mcu.sr & STATUS_T)
     {
-        if(LCD_QuitRequested())
-            working = false;
-
-        LCD_Update();
-        SDL_Delay(15);
+        MCU_Interrupt_Exception(EXCEPTION_SOURCE_TRACE);
     }
 
-    work_thread_run = false;
-    SDL_WaitThread(thread, 0);
-}
+    MCU_StepPeripherals<bench, model>();
 
-void MCU_PatchROM(void)
-{
-    //rom2[0x1333] = 0x11;
-    //rom2[0x1334] = 0x19;
-    //rom1[0x622d] = 0x19;
-}
-
-uint8_t mcu_p0_data = 0x00;
-uint8_t mcu_p1_data = 0x00;
+    if (bench)
+        bench_phase = BENCH_PHASE_INSTRUCTION;
 
-uint8_t MCU_ReadP0(void)
-{
-    return 0xff;
+    return ++jit_steps >= jit_budget || mcu.ex_ignore || mcu.sleep
+        || audio_frames_total != jit_frames || MCU_Interrupt_Taken();
 }
 
-uint8_t MCU_ReadP1(void)
+template <bool bench, class model>
+static void MCU_StepImpl(void)
 {
-    uint8_t data = 0xff;
-    uint32_t button_pressed = (uint32_t)SDL_AtomicGet(&mcu_button_pressed);
+    if (!mcu.ex_ignore)
+    {
+        if (bench)
+            bench_phase = BENCH_PHASE_INTERRUPT;
+        MCU_Interrupt_Handle();
+    }
+    else
+        mcu.ex_ignore = 0;
 
-    if ((mcu_p0_data & 1) == 0)
-        data &= ((button_pressed >> 0) & 255) ^ 255;
-    if ((mcu_p0_data & 2) == 0)
-        data &= ((button_pressed >> 8) & 255) ^ 255;
-    if ((mcu_p0_data & 4) == 0)
-        data &= ((button_pressed >> 16) & 255) ^ 255;
-    if ((mcu_p0_data & 8) == 0)
-        data &= ((button_pressed >> 24) & 255) ^ 255;
+    if (!mcu.sleep)
+    {
+        if (bench)
+            bench_phase = BENCH_PHASE_INSTRUCTION;
+        if (mcu_jit && !mcu_reference && !profile_interval)
+        {
+            jit_steps = 0;
+            jit_frames = audio_frames_total;
+            mcu_jit_tail = MCU_JIT_Tail<bench, model>;
+            if (MCU_JIT_Run())
+            {
+                if (bench)
+                    bench_instructions += jit_steps;
+                return;
+            }
+        }
+        if (bench)
+            bench_instructions++;
+        MCU_ReadInstruction<model>();
+    }
 
-    return data;
-}
+    if (profile_interval && --profile_countdown == 0)
+        PROFILE_Sample();
 
-void MCU_WriteP0(uint8_t data)
-{
-    mcu_p0_data = data;
+    MCU_StepPeripherals<bench, model>();
 }
 
-void MCU_WriteP1(uint8_t data)
+static void (*mcu_step)(void) = MCU_StepImpl<false, mcu_model_any_t>;
+static void (*mcu_step_bench)(void) = MCU_StepImpl<true, mcu_model_any_t>;
+
+void MCU_Step(void)
 {
-    mcu_p1_data = data;
+    mcu_step();
 }
 
-uint8_t tempbuf[0x800000];
-
-void unscramble(uint8_t *src, uint8_t *dst, int len)
+template<class model>
+static void MCU_SelectModelImpl(void)
 {
-    for (int i = 0; i < len; i++)
-    {
-        int address = i & ~0xfffff;
-        static const int aa[] = {
-            2, 0, 3, 4, 1, 9, 13, 10, 18, 17, 6, 15, 11, 16, 8, 5, 12, 7, 14, 19
-        };
-        for (int j = 0; j < 20; j++)
-        {
-            if (i & (1 << j))
-                address |= 1<<aa[j];
-        }
-        uint8_t srcdata = src[address];
-        uint8_t data = 0;
-        static const int dd[] = {
-            2, 0, 4, 5, 7, 6, 3, 1
-        };
-        for (int j = 0; j < 8; j++)
-        {
-            if (srcdata & (1 << dd[j]))
-                data |= 1<<j;
-        }
-        dst[i] = data;
-    }
+    MCU_Read = MCU_ReadImpl<model>;
+    MCU_Read16 = MCU_Read16Impl<model>;
+    MCU_Write = MCU_WriteImpl<model>;
+    MCU_Write16 = MCU_Write16Impl<model>;
+    MCU_Operand_Table = mcu_opcode_tables_t<model>::operand;
+    MCU_Opcode_Table = mcu_opcode_tables_t<model>::opcode;
+#ifdef MCU_THREADED_DISPATCH
+    mcu_opcode_specialized = MCU_Opcode_Specialized<model>;
+#endif
+    MCU_JIT_Flush(); // translated code calls the handlers of one model
+    mcu_step = MCU_StepImpl<false, model>;
+    mcu_step_bench = MCU_StepImpl<true, model>;
 }
 
-void audio_callback(void* /*userdata*/, Uint8* stream, int len)
+void MCU_SelectModel(void)
 {
-    len /= 2;
-    memcpy(stream, &sample_buffer[sample_read_ptr], len * 2);
-    memset(&sample_buffer[sample_read_ptr], 0, len * 2);
-    sample_read_ptr += len;
-    sample_read_ptr %= audio_buffer_size;
+    if (mcu_reference)
+        MCU_SelectModelImpl<mcu_model_any_t>();
+    else if (mcu_jv880)
+        MCU_SelectModelImpl<mcu_model_t<MCU_MODEL_JV880> >();
+    else if (mcu_cm300)
+        MCU_SelectModelImpl<mcu_model_t<MCU_MODEL_CM300> >();
+    else if (mcu_mk1)
+        MCU_SelectModelImpl<mcu_model_t<MCU_MODEL_MK1> >();
+    else if (mcu_scb55)
+        MCU_SelectModelImpl<mcu_model_t<MCU_MODEL_SCB55> >();
+    else
+        MCU_SelectModelImpl<mcu_model_t<MCU_MODEL_MK2> >();
 }
 
-static const char* audio_format_to_str(int format)
+// Takes the emulator back from the audio callback, waiting for a callback
+// in progress. Both sides use full barrier operations.
+static void MCU_PullReclaim(void)
 {
-    switch(format)
+    SDL_AtomicCAS(&pull_parked, 1, 0);
+    while (SDL_AtomicAdd(&pull_busy, 0))
     {
-    case AUDIO_S8:
-        return "S8";
-    case AUDIO_U8:
-        return "U8";
-    case AUDIO_S16MSB:
-        return "S16MSB";
-    case AUDIO_S16LSB:
-        return "S16LSB";
-    case AUDIO_U16MSB:
-        return "U16MSB";
-    case AUDIO_U16LSB:
-        return "U16LSB";
-    case AUDIO_S32MSB:
-        return "S32MSB";
-    case AUDIO_S32LSB:
-        return "S32LSB";
-    case AUDIO_F32MSB:
-        return "F32MSB";
-    case AUDIO_F32LSB:
-        return "F32LSB";
+        SDL_Delay(0);
     }
-    return "UNK";
 }
 
-int MCU_OpenAudio(int deviceIndex, int pageSize, int pageNum)
+int SDLCALL work_thread(void* data)
 {
-    SDL_AudioSpec spec = {};
-    SDL_AudioSpec spec_actual = {};
+    TRACE_ThreadName("work thread");
+    uint64_t quantum_t0 = SDL_GetPerformanceCounter();
 
-    audio_page_size = (pageSize/2)*2; // must be even
-    audio_buffer_size = audio_page_size*pageNum;
-    
-    spec.format = AUDIO_S16SYS;
-    spec.freq = (mcu_mk1 || mcu_jv880) ? 64000 : 66207;
-    spec.channels = 2;
-    spec.callback = audio_callback;
-    spec.samples = audio_page_size / 4;
-    
-    sample_buffer = (short*)calloc(audio_buffer_size, sizeof(short));
-    if (!sample_buffer)
-    {
-        printf("Cannot allocate audio buffer.\n");
-        return 0;
-    }
-    sample_read_ptr = 0;
-    sample_write_ptr = 0;
-    
-    int num = SDL_GetNumAudioDevices(0);
-    if (num == 0)
-    {
-        printf("No audio output device found.\n");
-        return 0;
-    }
-    
-    if (deviceIndex < -1 || deviceIndex >= num)
+    MCU_WorkThread_Lock();
+    if (audio_pull)
     {
-        printf("Out of range audio device index is requested. Default audio output device is selected.\n");
-        deviceIndex = -1;
+        // emulator is advanced from the audio callback, only hold it for the
+        // callback and hand it to the UI thread on request
+        SDL_AtomicSet(&pull_parked, 1);
+        while (work_thread_run)
+        {
+            if (SDL_AtomicGet(&work_thread_waiters))
+            {
+                MCU_PullReclaim();
+                MCU_WorkThread_Unlock();
+                while (SDL_AtomicGet(&work_thread_waiters))
+                {
+                    SDL_Delay(0);
+                }
+                MCU_WorkThread_Lock();
+                SDL_AtomicSet(&pull_parked, 1);
+            }
+            SDL_Delay(1);
+        }
+        MCU_PullReclaim();
     }
-    
-    const char* audioDevicename = deviceIndex == -1 ? "Default device" : SDL_GetAudioDeviceName(deviceIndex, 0);
-    
-    sdl_audio = SDL_OpenAudioDevice(deviceIndex == -1 ? NULL : audioDevicename, 0, &spec, &spec_actual, 0);
-    if (!sdl_audio)
+    while (work_thread_run)
     {
-        return 0;
-    }
+        if (audio_block_done)
+        {
+            audio_block_done = false;
+
+            uint64_t wait_t0 = 0;
+            if (trace_enabled)
+            {
+                wait_t0 = SDL_GetPerformanceCounter();
+                TRACE_Span("run", quantum_t0, wait_t0);
+            }
 
-    printf("Audio device: %s\n", audioDevicename);
+            if (audio_sink->realtime)
+            {
+                // wait for room for the next block
+                if (audio_sink->get_free() < audio_burst)
+                {
+                    MCU_WorkThread_Unlock();
+                    while (audio_sink->get_free() < audio_burst)
+                    {
+                        SDL_Delay(1);
+                    }
+                    MCU_WorkThread_Lock();
+                    if (trace_enabled)
+                        TRACE_Span("wait for audio buffer", wait_t0, SDL_GetPerformanceCounter());
+                }
 
-    printf("Audio Requested: F=%s, C=%d, R=%d, B=%d\n",
-           audio_format_to_str(spec.format),
-           spec.channels,
-           spec.freq,
-           spec.samples);
+                if (audio_ratectl)
+                {
+                    MCU_AudioRateControl();
 
-    printf("Audio Actual: F=%s, C=%d, R=%d, B=%d\n",
-           audio_format_to_str(spec_actual.format),
-           spec_actual.channels,
-           spec_actual.freq,
-           spec_actual.samples);
-    fflush(stdout);
+                    // don't run further ahead of wall clock than the target latency
+                    double ahead = MCU_AudioAhead();
+                    if (ahead < -0.25)
+                    {
+                        // too far behind (stall), don't try to catch up
+                        audio_pace_t0 = 0;
+                        audio_pace_frames = 0;
+                    }
+                    else if (ahead > audio_latency)
+                    {
+                        uint64_t pace_t0 = trace_enabled ? SDL_GetPerformanceCounter() : 0;
+                        MCU_WorkThread_Unlock();
+                        while (MCU_AudioAhead() > audio_latency)
+                        {
+                            SDL_Delay(1);
+                        }
+                        MCU_WorkThread_Lock();
+                        if (trace_enabled)
+                            TRACE_Span("pace", pace_t0, SDL_GetPerformanceCounter());
+                    }
+
+                    MCU_AudioPaceClock();
+                }
+            }
+            else if (SDL_AtomicGet(&work_thread_waiters))
+            {
+                // unthrottled, let the UI thread in
+                MCU_WorkThread_Unlock();
+                while (SDL_AtomicGet(&work_thread_waiters))
+                {
+                    SDL_Delay(0);
+                }
+                MCU_WorkThread_Lock();
+            }
 
-    SDL_PauseAudioDevice(sdl_audio, 0);
+            if (trace_enabled)
+                quantum_t0 = SDL_GetPerformanceCounter();
+        }
 
-    return 1;
-}
+        MCU_Step();
+    }
+    MCU_WorkThread_Unlock();
 
-void MCU_CloseAudio(void)
-{
-    SDL_CloseAudio();
-    if (sample_buffer) free(sample_buffer);
+    return 0;
 }
 
-void MCU_PostSample(int *sample)
+static double stats_interval; // seconds, 0 - no periodic stats
+static std::string stats_path; // empty - stderr
+
+#ifndef _WIN32
+static volatile sig_atomic_t stats_dump_requested;
+
+static void MCU_StatsSignal(int)
 {
-    sample[0] >>= 15;
-    if (sample[0] > INT16_MAX)
-        sample[0] = INT16_MAX;
-    else if (sample[0] < INT16_MIN)
-        sample[0] = INT16_MIN;
-    sample[1] >>= 15;
-    if (sample[1] > INT16_MAX)
-        sample[1] = INT16_MAX;
-    else if (sample[1] < INT16_MIN)
-        sample[1] = INT16_MIN;
-    sample_buffer[sample_write_ptr + 0] = sample[0];
-    sample_buffer[sample_write_ptr + 1] = sample[1];
-    sample_write_ptr = (sample_write_ptr + 2) % audio_buffer_size;
+    stats_dump_requested = 1;
 }
+#endif
 
-void MCU_GA_SetGAInt(int line, int value)
+static void MCU_StatsAppend(std::string &out, const char *format, ...)
 {
-    // guesswork
-    if (value && !ga_int[line] && (ga_int_enable & (1 << line)) != 0)
-        ga_int_trigger = line;
-    ga_int[line] = value;
-
-    if (mcu_jv880)
-        MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_IRQ0, ga_int_trigger != 0);
-    else
-        MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_IRQ1, ga_int_trigger != 0);
+    char buf[128];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(buf, sizeof(buf), format, args);
+    va_end(args);
+    out += buf;
 }
 
-void MCU_EncoderTrigger(int dir)
+// Formats the health counters as key=value pairs separated by sep. The
+// min/max values cover the time since the previous call.
+static void MCU_StatsFormat(std::string &out, const char *sep, double uptime)
 {
-    if (!mcu_jv880) return;
-    MCU_GA_SetGAInt(dir == 0 ? 3 : 4, 0);
-    MCU_GA_SetGAInt(dir == 0 ? 3 : 4, 1);
+    audio_stats_t audio;
+    AUDIO_GetStats(&audio);
+
+    SDL_AtomicLock(&midi_latency_lock);
+    uint32_t midi_count = midi_latency_count;
+    double midi_min = midi_latency_min;
+    double midi_avg = midi_count ? midi_latency_sum / midi_count : 0.0;
+    double midi_max = midi_latency_max;
+    midi_latency_count = 0;
+    midi_latency_sum = 0.0;
+    midi_latency_min = 0.0;
+    midi_latency_max = 0.0;
+    SDL_AtomicUnlock(&midi_latency_lock);
+
+    uint32_t uart_overflow, uart_max_fill;
+    MCU_UART_GetStats(&uart_overflow, &uart_max_fill);
+
+    double rate = audio_out_rate_actual ? (double)audio_out_rate_actual : 1.0;
+
+    MCU_StatsAppend(out, "uptime=%.1f%s", uptime, sep);
+    MCU_StatsAppend(out, "audio_callbacks=%u%s", audio.callbacks, sep);
+    MCU_StatsAppend(out, "underruns=%u%s", audio.underruns, sep);
+    MCU_StatsAppend(out, "behind_ms=%.1f%s", (double)(audio.underrun_samples / 2) * 1000.0 / rate, sep);
+    MCU_StatsAppend(out, "overruns=%u%s", audio.overruns, sep);
+    MCU_StatsAppend(out, "fill_min_ms=%.1f%s", (double)(audio.fill_min / 2) * 1000.0 / rate, sep);
+    MCU_StatsAppend(out, "fill_max_ms=%.1f%s", (double)(audio.fill_max / 2) * 1000.0 / rate, sep);
+    MCU_StatsAppend(out, "midi_bytes=%u%s", midi_count, sep);
+    MCU_StatsAppend(out, "midi_latency_min_ms=%.1f%s", midi_min * 1000.0, sep);
+    MCU_StatsAppend(out, "midi_latency_avg_ms=%.1f%s", midi_avg * 1000.0, sep);
+    MCU_StatsAppend(out, "midi_latency_max_ms=%.1f%s", midi_max * 1000.0, sep);
+    MCU_StatsAppend(out, "midi_overflow=%u\n", uart_overflow);
 }
 
-static FILE *s_rf[ROM_SET_N_FILES] =
+static void MCU_Run()
 {
-    nullptr,
-    nullptr,
-    nullptr,
-    nullptr,
-    nullptr,
-    nullptr
-};
+    bool working = true;
+    SDL_Thread *thread = NULL;
 
-static void closeAllR()
-{
-    for(size_t i = 0; i < ROM_SET_N_FILES; ++i)
+    work_thread_lock = SDL_CreateMutex();
+
+    work_thread_run = true;
+    thread = SDL_CreateThread(work_thread, "work thread", 0);
+
+    uint32_t uart_overflow_reported = 0;
+
+    uint64_t freq = SDL_GetPerformanceFrequency();
+    uint64_t run_t0 = SDL_GetPerformanceCounter();
+    uint64_t stats_next = run_t0 + (uint64_t)(stats_interval * freq);
+#ifndef _WIN32
+    signal(SIGUSR1, MCU_StatsSignal);
+#endif
+
+    TRACE_ThreadName("main");
+
+    while (working)
     {
-        if(s_rf[i])
-            fclose(s_rf[i]);
-        s_rf[i] = nullptr;
+        if(LCD_QuitRequested())
+            working = false;
+
+        uint64_t lcd_t0 = trace_enabled ? SDL_GetPerformanceCounter() : 0;
+        LCD_Update();
+        if (trace_enabled)
+        {
+            TRACE_Span("LCD_Update", lcd_t0, SDL_GetPerformanceCounter());
+            TRACE_Flush();
+        }
+
+        uint32_t uart_overflow, uart_max_fill;
+        MCU_UART_GetStats(&uart_overflow, &uart_max_fill);
+        if (uart_overflow != uart_overflow_reported)
+        {
+            fprintf(stderr, "WARNING: MIDI input buffer overflow, %u bytes dropped.\n", uart_overflow - uart_overflow_reported);
+            fflush(stderr);
+            uart_overflow_reported = uart_overflow;
+        }
+
+        uint64_t now = SDL_GetPerformanceCounter();
+        double uptime = (double)(now - run_t0) / (double)freq;
+#ifndef _WIN32
+        if (stats_dump_requested)
+        {
+            stats_dump_requested = 0;
+            std::string stats;
+            MCU_StatsFormat(stats, " ", uptime);
+            fprintf(stderr, "stats: %s", stats.c_str());
+        }
+#endif
+        if (stats_interval > 0.0 && now >= stats_next)
+        {
+            stats_next = now + (uint64_t)(stats_interval * freq);
+            std::string stats;
+            if (stats_path.empty())
+            {
+                MCU_StatsFormat(stats, " ", uptime);
+                fprintf(stderr, "stats: %s", stats.c_str());
+            }
+            else
+            {
+                MCU_StatsFormat(stats, "\n", uptime);
+                Files::writeFileAtomic(stats_path, stats);
+            }
+        }
+
+        SDL_Delay(15);
     }
+
+    work_thread_run = false;
+    SDL_WaitThread(thread, 0);
+
+    SDL_DestroyMutex(work_thread_lock);
 }
 
-enum class ResetType {
-    NONE,
-    GS_RESET,
-    GM_RESET,
-};
+#ifndef _WIN32
+static void MCU_BenchSample(int)
+{
+    bench_samples[bench_phase]++;
+}
+#endif
 
-void MIDI_Reset(ResetType resetType)
+// --bench posts from the emulator thread
+static inline void MCU_BenchPost(uint8_t data)
 {
-    const unsigned char gmReset[] = { 0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7 };
-    const unsigned char gsReset[] = { 0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41, 0xF7 };
-    
-    if (resetType == ResetType::GS_RESET)
+    MCU_UART_PostTimed(UART_SOURCE_EMU, data, SDL_GetPerformanceCounter());
+}
+
+// Synthetic MIDI load for --bench: a chord on 8 parts plus drums every
+// 250 ms of emulated time, released on the next beat.
+static void MCU_BenchMIDI(uint64_t beat)
+{
+    static const uint8_t chords[4][4] = {
+        { 48, 55, 60, 64 },
+        { 45, 52, 57, 60 },
+        { 41, 48, 53, 57 },
+        { 43, 50, 55, 59 },
+    };
+
+    if (beat == 0)
     {
-        for (size_t i = 0; i < sizeof(gsReset); i++)
+        for (int ch = 0; ch < 8; ch++)
         {
-            MCU_PostUART(gsReset[i]);
+            MCU_BenchPost(0xc0 | ch);
+            MCU_BenchPost(ch * 8);
         }
     }
-    else  if (resetType == ResetType::GM_RESET)
+
+    const uint8_t *prev = chords[(beat + 3) & 3];
+    const uint8_t *chord = chords[beat & 3];
+    for (int ch = 0; ch < 8; ch++)
     {
-        for (size_t i = 0; i < sizeof(gmReset); i++)
+        for (int i = 0; i < 4; i++)
         {
-            MCU_PostUART(gmReset[i]);
+            if (beat)
+            {
+                MCU_BenchPost(0x80 | ch);
+                MCU_BenchPost(prev[i] + (ch & 1) * 12);
+                MCU_BenchPost(0);
+            }
+            MCU_BenchPost(0x90 | ch);
+            MCU_BenchPost(chord[i] + (ch & 1) * 12);
+            MCU_BenchPost(100);
         }
     }
-
+    MCU_BenchPost(0x99);
+    MCU_BenchPost((beat & 1) ? 38 : 36);
+    MCU_BenchPost(110);
+    MCU_BenchPost(0x99);
+    MCU_BenchPost(42);
+    MCU_BenchPost(90);
 }
 
-int main(int argc, char *argv[])
+// Runs the emulator unthrottled for the given emulated time and prints
+// the results as JSON.
+static void MCU_Bench(double seconds, bool midi, FILE *out)
 {
-    (void)argc;
-    std::string basePath;
+    uint64_t frames_target = (uint64_t)(seconds * audio_rate_native);
+    uint64_t beat_frames = audio_rate_native / 4;
+    uint64_t midi_start = audio_rate_native; // let the firmware boot first
+    uint64_t beat = 0;
+
+    for (int i = 0; i < BENCH_PHASE_MAX; i++)
+        bench_samples[i] = 0;
+    bench_instructions = 0;
+    audio_frames_total = 0;
+
+#ifndef _WIN32
+    // ITIMER_PROF would count CPU time of all threads, so time spent in
+    // other threads would be charged to whatever this one was doing
+    signal(SIGALRM, MCU_BenchSample);
+    struct itimerval timer = {};
+    timer.it_interval.tv_usec = 1000;
+    timer.it_value.tv_usec = 1000;
+    setitimer(ITIMER_REAL, &timer, NULL);
+#endif
 
-    int port = 0;
-    int audioDeviceIndex = -1;
-    int pageSize = 512;
-    int pageNum = 32;
-    bool autodetect = true;
-    ResetType resetType = ResetType::NONE;
+    uint64_t sm_start = sm.instructions;
+    uint64_t t0 = SDL_GetPerformanceCounter();
 
-    romset = ROM_SET_MK2;
+    while (audio_frames_total < frames_target)
+    {
+        if (midi && audio_frames_total >= midi_start + beat * beat_frames)
+            MCU_BenchMIDI(beat++);
+        MCU_ReplayFeed();
+        mcu_step_bench();
+    }
+
+    uint64_t t1 = SDL_GetPerformanceCounter();
+
+#ifndef _WIN32
+    timer.it_interval.tv_usec = 0;
+    timer.it_value.tv_usec = 0;
+    setitimer(ITIMER_REAL, &timer, NULL);
+    signal(SIGALRM, SIG_DFL);
+#endif
 
+    double wall = (double)(t1 - t0) / (double)SDL_GetPerformanceFrequency();
+    double emulated = (double)audio_frames_total / (double)audio_rate_native;
+    uint64_t sm_instructions = sm.instructions - sm_start;
+
+    fprintf(out, "{\n");
+    fprintf(out, "  \"romset\": \"%s\",\n", rs_name[romset]);
+    fprintf(out, "  \"midi\": %s,\n", midi ? "true" : "false");
+    fprintf(out, "  \"emulated_seconds\": %.3f,\n", emulated);
+    fprintf(out, "  \"wall_seconds\": %.3f,\n", wall);
+    fprintf(out, "  \"realtime_factor\": %.3f,\n", emulated / wall);
+    fprintf(out, "  \"mcu_mips\": %.3f,\n", (double)bench_instructions / wall / 1e6);
+    fprintf(out, "  \"submcu_mips\": %.3f,\n", (double)sm_instructions / wall / 1e6);
+    fprintf(out, "  \"pcm_frames_per_sec\": %.0f,\n", (double)audio_frames_total / wall);
+
+    static const char *phase_names[BENCH_PHASE_MAX] = {
+        "other",
+        "MCU_Interrupt_Handle",
+        "MCU_ReadInstruction",
+        "PCM_Update",
+        "TIMER_Clock",
+        "SM_Update",
+        "MCU_UpdateUART",
+    };
+    uint64_t total = 0;
+    for (int i = 0; i < BENCH_PHASE_MAX; i++)
+        total += bench_samples[i];
+    fprintf(out, "  \"profile_wall_samples\": %llu,\n", (unsigned long long)total);
+    fprintf(out, "  \"profile_wall\": {");
+    for (int i = 0; i < BENCH_PHASE_MAX; i++)
     {
-        for (int i = 1; i < argc; i++)
-        {
-            if (!strncmp(argv[i], "-p:", 3))
+        fprintf(out, "%s\n    \"%s\": %.4f", i ? "," : "", phase_names[i],
+               total ? (double)bench_samples[i] / (double)total : 0.0);
+    }
+    fprintf(out, "\n  }\n");
+    fprintf(out, "}\n");
+    fflush(out);
+}
+
+// Plays a --replay log headless and unthrottled into the selected audio
+// sink, plus two seconds for the release tails.
+static void MCU_Replay(void)
+{
+    uint64_t tail = audio_rate_native * 2;
+    uint64_t end = 0;
+    uint64_t t0 = SDL_GetPerformanceCounter();
+
+    audio_frames_total = 0;
+
+    while (!end || audio_frames_total < end)
+    {
+        MCU_ReplayFeed();
+        MCU_Step();
+        if (!end && MCU_ReplayDone())
+            end = audio_frames_total + tail;
+    }
+
+    uint64_t t1 = SDL_GetPerformanceCounter();
+    double wall = (double)(t1 - t0) / (double)SDL_GetPerformanceFrequency();
+
+    fprintf(stderr, "Replay: %u bytes, %.3f s emulated in %.3f s, last byte at cycle %llu.\n",
+            (unsigned)midi_replay.size(), (double)audio_frames_total / (double)audio_rate_native, wall,
+            midi_replay.empty() ? 0ull : (unsigned long long)(midi_replay.back().ticks / uart_ticks_per_cycle));
+}
+
+// State compared between the two contexts of --lockstep. Filled field by
+// field over a zeroed struct so it can be compared with memcmp.
+struct lockstep_state_t {
+    uint64_t step;
+    uint64_t cycles;
+    uint16_t r[8];
+    uint16_t pc;
+    uint16_t sr;
+    uint8_t cp, dp, ep, tp, br;
+    uint8_t sleep;
+    uint8_t dev_register[0x80];
+    uint32_t ram1[32][8];
+    uint16_t ram2[32][16];
+};
+
+// a stopped copy of a --lockstep context, taken at a matching check
+struct lockstep_snapshot_t {
+    pid_t pid;
+    int fd; // resume: step to re-run up to, close: discard
+    uint64_t step;
+};
+
+static const uint64_t lockstep_snapshot_steps = 1000000; // at most re-run at interval 1
+
+static void MCU_LockstepCapture(lockstep_state_t *state, uint64_t step)
+{
+    memset(state, 0, sizeof(lockstep_state_t));
+    state->step = step;
+    state->cycles = mcu.cycles;
+    memcpy(state->r, mcu.r, sizeof(state->r));
+    state->pc = mcu.pc;
+    state->sr = mcu.sr;
+    state->cp = mcu.cp;
+    state->dp = mcu.dp;
+    state->ep = mcu.ep;
+    state->tp = mcu.tp;
+    state->br = mcu.br;
+    state->sleep = mcu.sleep;
+    memcpy(state->dev_register, dev_register, sizeof(state->dev_register));
+    memcpy(state->ram1, pcm.ram1, sizeof(state->ram1));
+    memcpy(state->ram2, pcm.ram2, sizeof(state->ram2));
+}
+
+static void MCU_LockstepReport(const lockstep_state_t *last, const lockstep_state_t *ref, const lockstep_state_t *opt)
+{
+    if (ref->step == last->step + 1)
+        printf("Lockstep: divergence in step %llu\n", (unsigned long long)ref->step);
+    else
+    {
+        printf("Lockstep: divergence between step %llu and %llu\n",
+               (unsigned long long)last->step, (unsigned long long)ref->step);
+    }
+    printf("  last match: pc %02x:%04x cycle %llu\n",
+           last->cp, last->pc, (unsigned long long)last->cycles);
+    if (lockstep_fetch.valid)
+    {
+        printf("  last instruction: pc %02x:%04x opcode %02x\n",
+               lockstep_fetch.cp, lockstep_fetch.pc, lockstep_fetch.opcode);
+    }
+    else
+        printf("  last instruction: none, the step ran no instruction\n");
+    printf("  reference:  pc %02x:%04x cycle %llu\n",
+           ref->cp, ref->pc, (unsigned long long)ref->cycles);
+    printf("  optimized:  pc %02x:%04x cycle %llu\n",
+           opt->cp, opt->pc, (unsigned long long)opt->cycles);
+
+    int shown = 0;
+    const int max_shown = 32;
+#define LOCKSTEP_DIFF(name, index, field) \
+    if (ref->field != opt->field && shown++ < max_shown) \
+        printf("  %s%s: %x != %x\n", name, index, (unsigned)ref->field, (unsigned)opt->field)
+
+    char index[16] = "";
+    for (int i = 0; i < 8; i++)
+    {
+        snprintf(index, sizeof(index), "[%d]", i);
+        LOCKSTEP_DIFF("r", index, r[i]);
+    }
+    index[0] = '\0';
+    LOCKSTEP_DIFF("sr", index, sr);
+    LOCKSTEP_DIFF("dp", index, dp);
+    LOCKSTEP_DIFF("ep", index, ep);
+    LOCKSTEP_DIFF("tp", index, tp);
+    LOCKSTEP_DIFF("br", index, br);
+    LOCKSTEP_DIFF("sleep", index, sleep);
+    for (int i = 0; i < 0x80; i++)
+    {
+        snprintf(index, sizeof(index), "[%02x]", i);
+        LOCKSTEP_DIFF("dev_register", index, dev_register[i]);
+    }
+    for (int i = 0; i < 32; i++)
+    {
+        for (int j = 0; j < 8; j++)
+        {
+            snprintf(index, sizeof(index), "[%d][%d]", i, j);
+            LOCKSTEP_DIFF("pcm.ram1", index, ram1[i][j]);
+        }
+        for (int j = 0; j < 16; j++)
+        {
+            snprintf(index, sizeof(index), "[%d][%d]", i, j);
+            LOCKSTEP_DIFF("pcm.ram2", index, ram2[i][j]);
+        }
+    }
+#undef LOCKSTEP_DIFF
+    if (shown > max_shown)
+        printf("  ... %d more differences\n", shown - max_shown);
+    fflush(stdout);
+}
+
+#ifndef _WIN32
+static void MCU_LockstepDiscard(lockstep_snapshot_t *snapshot)
+{
+    if (snapshot->pid <= 0)
+        return;
+    close(snapshot->fd);
+    waitpid(snapshot->pid, NULL, 0);
+    snapshot->pid = -1;
+}
+
+// Replaces the snapshot with a stopped fork of this context, which closes
+// the given pipe ends so it can't hold them open for the other context.
+// Returns the step to re-run up to in the fork once it is resumed, 0 in the
+// caller.
+static uint64_t MCU_LockstepSnapshot(lockstep_snapshot_t *snapshot, uint64_t step, int data, int reply)
+{
+    int fds[2];
+    if (pipe(fds) != 0)
+        return 0;
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        close(fds[0]);
+        close(fds[1]);
+        return 0;
+    }
+    if (pid == 0)
+    {
+        close(fds[1]);
+        close(data);
+        close(reply);
+        if (snapshot->pid > 0)
+            close(snapshot->fd); // not our child, the caller discards it
+        uint64_t end;
+        if (read(fds[0], &end, sizeof(end)) != (ssize_t)sizeof(end))
+            _exit(0);
+        close(fds[0]);
+        return end;
+    }
+
+    close(fds[0]);
+    MCU_LockstepDiscard(snapshot);
+    snapshot->pid = pid;
+    snapshot->fd = fds[1];
+    snapshot->step = step;
+    return 0;
+}
+
+// Lets the snapshot re-run up to step end and returns its exit code.
+static int MCU_LockstepResume(lockstep_snapshot_t *snapshot, uint64_t end)
+{
+    if (snapshot->pid <= 0)
+        return -1;
+    int status = 0;
+    bool ok = write(snapshot->fd, &end, sizeof(end)) == (ssize_t)sizeof(end);
+    close(snapshot->fd);
+    ok = waitpid(snapshot->pid, &status, 0) == snapshot->pid && ok;
+    snapshot->pid = -1;
+    return ok && WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+}
+#endif
+
+// Runs the reference and the optimized implementations side by side on the
+// same input and compares their state every interval steps. The optimized
+// context is a fork of this process, so both start from identical state.
+// With interval > 1 both contexts keep a stopped fork from a matching check;
+// on divergence the forks re-run from there comparing every step, so the
+// report names the exact instruction. Returns the process exit code.
+static int MCU_Lockstep(uint64_t interval, double seconds, bool midi)
+{
+#ifdef _WIN32
+    (void)interval;
+    (void)seconds;
+    (void)midi;
+    fprintf(stderr, "--lockstep is not supported on Windows.\n");
+    return 1;
+#else
+    // states go from the optimized context to the reference one over fds,
+    // verdicts back over verdict (interval > 1 only) and the states of a
+    // re-run over rewind
+    int fds[2], verdict[2], rewind[2];
+    if (pipe(fds) != 0 || pipe(verdict) != 0 || pipe(rewind) != 0)
+    {
+        fprintf(stderr, "Lockstep: pipe failed.\n");
+        return 1;
+    }
+
+    fflush(stdout);
+    fflush(stderr);
+    pid_t pid = fork();
+    if (pid < 0)
+    {
+        fprintf(stderr, "Lockstep: fork failed.\n");
+        return 1;
+    }
+
+    bool reference = pid != 0;
+    close(reference ? fds[1] : fds[0]);
+    close(reference ? verdict[0] : verdict[1]);
+    close(reference ? rewind[1] : rewind[0]);
+    int data = reference ? fds[0] : fds[1];
+    int reply = reference ? verdict[1] : verdict[0];
+    int spare = reference ? rewind[0] : rewind[1];
+    mcu_reference = reference;
+    MCU_SelectModel();
+    jit_budget = 1; // translated code is compared instruction by instruction
+
+    uint64_t frames_target = (uint64_t)(seconds * audio_rate_native);
+    uint64_t beat_frames = audio_rate_native / 4;
+    uint64_t midi_start = audio_rate_native; // let the firmware boot first
+    uint64_t beat = 0;
+    uint64_t step = 0;
+    uint64_t step_end = UINT64_MAX;
+    uint64_t checks = 0;
+    bool rerun = false;
+    int result = 0;
+
+    lockstep_state_t last, state, other;
+    MCU_LockstepCapture(&last, 0);
+    lockstep_snapshot_t snapshot = { -1, -1, 0 };
+
+    audio_frames_total = 0;
+
+    while (audio_frames_total < frames_target && step < step_end)
+    {
+        if (interval > 1 && step % interval == 0
+            && (snapshot.pid <= 0 || step - snapshot.step >= lockstep_snapshot_steps))
+        {
+            uint64_t end = MCU_LockstepSnapshot(&snapshot, step, data, reply);
+            if (end)
+            {
+                // resumed fork: compare every step up to the divergent check
+                rerun = true;
+                interval = 1;
+                step_end = end;
+                data = spare;
+                snapshot.pid = -1;
+            }
+        }
+
+        if (midi && audio_frames_total >= midi_start + beat * beat_frames)
+            MCU_BenchMIDI(beat++);
+        MCU_ReplayFeed();
+        lockstep_fetch.valid = false;
+        MCU_Step();
+
+        if (++step % interval)
+            continue;
+
+        MCU_LockstepCapture(&state, step);
+
+        if (!reference)
+        {
+            if (write(data, &state, sizeof(state)) != (ssize_t)sizeof(state))
+                _exit(0); // reference is gone
+            if (interval == 1)
+                continue;
+            uint8_t diverged;
+            if (read(reply, &diverged, 1) != 1)
+                _exit(0);
+            if (diverged)
+            {
+                close(spare);
+                MCU_LockstepResume(&snapshot, step);
+                _exit(0);
+            }
+            continue;
+        }
+
+        size_t got = 0;
+        while (got < sizeof(other))
+        {
+            ssize_t n = read(data, (uint8_t *)&other + got, sizeof(other) - got);
+            if (n <= 0)
+                break;
+            got += n;
+        }
+        if (got < sizeof(other))
+        {
+            fprintf(stderr, "Lockstep: optimized context stopped at step %llu.\n", (unsigned long long)step);
+            result = 1;
+            break;
+        }
+
+        checks++;
+        bool match = memcmp(&state, &other, sizeof(state)) == 0;
+        if (interval > 1)
+        {
+            uint8_t diverged = !match;
+            if (write(reply, &diverged, 1) != 1)
+                match = false; // optimized context is gone
+        }
+        if (!match)
+        {
+            close(spare);
+            if (interval == 1 || MCU_LockstepResume(&snapshot, step) != 3)
+                MCU_LockstepReport(&last, &state, &other);
+            result = 3;
+            break;
+        }
+        last = state;
+    }
+
+    if (rerun)
+    {
+        // a fork resumed for a divergence, it only reports one
+        if (reference && result == 0)
+        {
+            printf("Lockstep: re-run up to step %llu matched, no exact divergence found.\n",
+                   (unsigned long long)step_end);
+        }
+        fflush(stdout);
+        _exit(result);
+    }
+
+    MCU_LockstepDiscard(&snapshot);
+    if (!reference)
+        _exit(0);
+
+    close(fds[0]);
+    kill(pid, SIGKILL);
+    waitpid(pid, NULL, 0);
+
+    if (result == 0)
+    {
+        printf("Lockstep: %llu steps, %llu checks, no divergence.\n",
+               (unsigned long long)step, (unsigned long long)checks);
+    }
+
+    return result;
+#endif
+}
+
+void MCU_PatchROM(void)
+{
+    //rom2[0x1333] = 0x11;
+    //rom2[0x1334] = 0x19;
+    //rom1[0x622d] = 0x19;
+}
+
+uint8_t mcu_p0_data = 0x00;
+uint8_t mcu_p1_data = 0x00;
+
+uint8_t MCU_ReadP0(void)
+{
+    return 0xff;
+}
+
+uint8_t MCU_ReadP1(void)
+{
+    uint8_t data = 0xff;
+    uint32_t button_pressed = (uint32_t)SDL_AtomicGet(&mcu_button_pressed);
+
+    if ((mcu_p0_data & 1) == 0)
+        data &= ((button_pressed >> 0) & 255) ^ 255;
+    if ((mcu_p0_data & 2) == 0)
+        data &= ((button_pressed >> 8) & 255) ^ 255;
+    if ((mcu_p0_data & 4) == 0)
+        data &= ((button_pressed >> 16) & 255) ^ 255;
+    if ((mcu_p0_data & 8) == 0)
+        data &= ((button_pressed >> 24) & 255) ^ 255;
+
+    return data;
+}
+
+void MCU_WriteP0(uint8_t data)
+{
+    mcu_p0_data = data;
+}
+
+void MCU_WriteP1(uint8_t data)
+{
+    mcu_p1_data = data;
+}
+
+uint8_t tempbuf[0x800000];
+
+void unscramble(uint8_t *src, uint8_t *dst, int len)
+{
+    for (int i = 0; i < len; i++)
+    {
+        int address = i & ~0xfffff;
+        static const int aa[] = {
+            2, 0, 3, 4, 1, 9, 13, 10, 18, 17, 6, 15, 11, 16, 8, 5, 12, 7, 14, 19
+        };
+        for (int j = 0; j < 20; j++)
+        {
+            if (i & (1 << j))
+                address |= 1<<aa[j];
+        }
+        uint8_t srcdata = src[address];
+        uint8_t data = 0;
+        static const int dd[] = {
+            2, 0, 4, 5, 7, 6, 3, 1
+        };
+        for (int j = 0; j < 8; j++)
+        {
+            if (srcdata & (1 << dd[j]))
+                data |= 1<<j;
+        }
+        dst[i] = data;
+    }
+}
+
+static void MCU_AudioResample(const short *in, int count);
+
+static void MCU_AudioPull(int len)
+{
+    SDL_AtomicAdd(&pull_busy, 1);
+    if (!SDL_AtomicGet(&pull_parked))
+    {
+        // work thread has the emulator (UI, startup, shutdown), skip the period
+        SDL_AtomicAdd(&pull_busy, -1);
+        return;
+    }
+
+    uint64_t t0 = SDL_GetPerformanceCounter();
+
+    uint64_t c0 = mcu.cycles;
+    // frames rendered past the previous period are already in the ring
+    int fill = audio_sink->get_fill();
+    if (fill < 0)
+        fill = 0;
+    pull_frames_due = len / 2 - fill / 2;
+    if (audio_resample && pull_frames_due > 0)
+        MCU_AudioResample(NULL, 0); // output the resampler held back last time
+    while (pull_frames_due > 0 && audio_sink->get_free() >= audio_burst)
+        MCU_Step();
+    uint64_t c1 = mcu.cycles;
+    SDL_AtomicAdd(&pull_busy, -1);
+
+    uint64_t t1 = SDL_GetPerformanceCounter();
+
+    double period = (double)(len / 2) / (double)audio_out_rate_actual;
+    SDL_AtomicLock(&input_clock_lock);
+    input_clock_cycles = c1;
+    input_clock_time = t0;
+    input_clock_span = c1 - c0;
+    input_clock_rate = (double)(c1 - c0) / (period * (double)SDL_GetPerformanceFrequency());
+    SDL_AtomicUnlock(&input_clock_lock);
+
+    uint64_t dt = t1 - t0;
+    if (dt > pull_cb_max)
+    {
+        pull_cb_max = dt;
+        pull_cb_max_len = len / 2;
+    }
+    pull_cb_total += dt;
+    pull_cb_count++;
+}
+
+int MCU_OpenAudio(int deviceIndex, int pageSize, int pageNum, int rate, int quality, int latency, bool pull)
+{
+    audio_config_t config = {};
+
+    config.device_index = deviceIndex;
+    config.page_size = (pageSize/2)*2; // must be even
+    config.buffer_size = config.page_size*pageNum;
+
+    if (!audio_sink->realtime)
+    {
+        if (pull)
+            printf("Audio output '%s' is not realtime, -pull ignored.\n", audio_sink->name);
+        if (latency > 0)
+            printf("Audio output '%s' is not realtime, -lat ignored.\n", audio_sink->name);
+        pull = false;
+        latency = 0;
+    }
+
+    audio_rate_native = (mcu_mk1 || mcu_jv880) ? 64000 : 66207;
+    audio_rate_out = rate > 0 ? rate : audio_rate_native;
+    audio_pull = pull;
+    SDL_AtomicSet(&pull_parked, 0);
+    pull_cb_max = 0;
+    pull_cb_total = 0;
+    pull_cb_count = 0;
+    input_clock_time = 0;
+    audio_ratectl = latency > 0 && !pull;
+    // rate control works by nudging the resampler, so keep it in the path even at the native rate
+    audio_resample = audio_rate_out != audio_rate_native || audio_ratectl;
+    audio_block_count = 0;
+    audio_block_done = false;
+    audio_burst = audio_block_size * 2;
+
+    if (audio_ratectl)
+    {
+        audio_latency = latency / 1000.0;
+        ratectl_target = ((int)(audio_latency * audio_rate_out)) * 2;
+        ratectl_fill = ratectl_target;
+        ratectl_integral = 0.0;
+        ratectl_adjust = 1.0;
+        audio_pace_t0 = 0;
+        audio_pace_frames = 0;
+        // leave headroom above the target for clock drift and bursts
+        if (config.buffer_size < ratectl_target * 4)
+            config.buffer_size = ratectl_target * 4;
+    }
+
+    if (audio_resample)
+    {
+        if (!RESAMPLER_Init(&resampler, audio_rate_native, audio_rate_out, quality))
+        {
+            printf("Cannot initialize resampler.\n");
+            return 0;
+        }
+        resample_out_max = RESAMPLER_MaxOutput(&resampler, audio_block_size);
+        audio_burst = resample_out_max * 2;
+        if (resample_out_max * 2 > (int)(sizeof(resample_out) / sizeof(short)))
+        {
+            printf("Unsupported resampling ratio: %d -> %d Hz.\n", audio_rate_native, audio_rate_out);
+            RESAMPLER_Free(&resampler);
+            return 0;
+        }
+        printf("Resampler: %d -> %d Hz, quality %s, kernel %s, latency %.2f ms\n",
+               audio_rate_native, audio_rate_out,
+               resampler_quality_name[resampler.quality],
+               RESAMPLER_GetKernelName(),
+               RESAMPLER_GetLatency(&resampler) * 1000.0);
+        if (audio_ratectl)
+            printf("Target latency: %d ms\n", latency);
+    }
+
+    if (audio_sink->realtime && audio_burst >= config.buffer_size)
+    {
+        printf("Audio buffer is too small.\n");
+        return 0;
+    }
+
+    if (audio_pull)
+        audio_pull_handler = MCU_AudioPull;
+
+    config.rate = audio_rate_out;
+    if (!AUDIO_Open(&config))
+        return 0;
+
+    audio_out_rate_actual = config.rate;
+    if (audio_ratectl && latency * config.rate < 2000 * config.period)
+        printf("WARNING: Target latency is shorter than two audio device periods, expect underruns.\n");
+    fflush(stdout);
+
+    return 1;
+}
+
+void MCU_CloseAudio(void)
+{
+    AUDIO_Close();
+    if (audio_pull && pull_cb_count)
+    {
+        double freq = (double)SDL_GetPerformanceFrequency();
+        printf("Pull mode: worst callback %.3f ms for %d frames (period %.3f ms), average %.3f ms\n",
+               pull_cb_max * 1000.0 / freq,
+               pull_cb_max_len,
+               pull_cb_max_len * 1000.0 / audio_out_rate_actual,
+               (double)pull_cb_total / (double)pull_cb_count * 1000.0 / freq);
+    }
+    if (audio_resample)
+    {
+        printf("Resampler CPU load: %.3f%%\n", RESAMPLER_GetCPULoad(&resampler) * 100.0);
+        if (audio_ratectl)
+            printf("Rate control: final ratio adjust %+.1f ppm\n", (ratectl_adjust - 1.0) * 1e6);
+        RESAMPLER_Free(&resampler);
+    }
+}
+
+// With -pull output stops at the frames the callback asked for, the rest
+// stays in the resampler history until the next callback.
+static void MCU_AudioResample(const short *in, int count)
+{
+    int pos = 0;
+    do
+    {
+        int out_max = resample_out_max;
+        if (audio_pull && out_max > pull_frames_due)
+            out_max = pull_frames_due > 0 ? pull_frames_due : 0;
+        int used = count - pos;
+        int frames = RESAMPLER_Process(&resampler, in + pos * 2, &used, resample_out, out_max);
+        audio_sink->write(resample_out, frames * 2);
+        if (audio_pull)
+            pull_frames_due -= frames;
+        if (!used && !frames) // stuck, cannot happen with resample_out_max
+            break;
+        pos += used;
+    } while (pos < count);
+}
+
+void MCU_PostSample(int *sample)
+{
+    sample[0] >>= 15;
+    if (sample[0] > INT16_MAX)
+        sample[0] = INT16_MAX;
+    else if (sample[0] < INT16_MIN)
+        sample[0] = INT16_MIN;
+    sample[1] >>= 15;
+    if (sample[1] > INT16_MAX)
+        sample[1] = INT16_MAX;
+    else if (sample[1] < INT16_MIN)
+        sample[1] = INT16_MIN;
+    audio_block[audio_block_count * 2 + 0] = sample[0];
+    audio_block[audio_block_count * 2 + 1] = sample[1];
+    // -pull renders frame by frame so the callback gets exactly its period
+    if (++audio_block_count < audio_block_size && !audio_pull)
+        return;
+
+    if (audio_resample)
+        MCU_AudioResample(audio_block, audio_block_count);
+    else
+    {
+        audio_sink->write(audio_block, audio_block_count * 2);
+        if (audio_pull)
+            pull_frames_due -= audio_block_count;
+    }
+
+    audio_pace_frames += audio_block_count;
+    audio_frames_total += audio_block_count;
+    audio_block_count = 0;
+    audio_block_done = true;
+}
+
+void MCU_GA_SetGAInt(int line, int value)
+{
+    // guesswork
+    if (value && !ga_int[line] && (ga_int_enable & (1 << line)) != 0)
+        ga_int_trigger = line;
+    ga_int[line] = value;
+
+    if (mcu_jv880)
+        MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_IRQ0, ga_int_trigger != 0);
+    else
+        MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_IRQ1, ga_int_trigger != 0);
+}
+
+void MCU_EncoderTrigger(int dir)
+{
+    if (!mcu_jv880) return;
+    MCU_GA_SetGAInt(dir == 0 ? 3 : 4, 0);
+    MCU_GA_SetGAInt(dir == 0 ? 3 : 4, 1);
+}
+
+static FILE *s_rf[ROM_SET_N_FILES] =
+{
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr,
+    nullptr
+};
+
+static void closeAllR()
+{
+    for(size_t i = 0; i < ROM_SET_N_FILES; ++i)
+    {
+        if(s_rf[i])
+            fclose(s_rf[i]);
+        s_rf[i] = nullptr;
+    }
+}
+
+enum class ResetType {
+    NONE,
+    GS_RESET,
+    GM_RESET,
+};
+
+void MIDI_Reset(ResetType resetType)
+{
+    const unsigned char gmReset[] = { 0xF0, 0x7E, 0x7F, 0x09, 0x01, 0xF7 };
+    const unsigned char gsReset[] = { 0xF0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7F, 0x00, 0x41, 0xF7 };
+    
+    if (resetType == ResetType::GS_RESET)
+    {
+        for (size_t i = 0; i < sizeof(gsReset); i++)
+        {
+            MCU_PostUART(gsReset[i]);
+        }
+    }
+    else  if (resetType == ResetType::GM_RESET)
+    {
+        for (size_t i = 0; i < sizeof(gmReset); i++)
+        {
+            MCU_PostUART(gmReset[i]);
+        }
+    }
+
+}
+
+// --batch renders MIDI files to WAV files in parallel. The emulator state is
+// global, so the workers are processes: the rom set boots and takes the
+// GS/GM reset once, then each song is rendered by a fork of that state, at
+// most jobs at a time. Every song starts from the same state, whatever
+// worker it lands on. Results come back through a pipe for the summary CSV.
+enum {
+    BATCH_OK = 0,
+    BATCH_LOAD_FAILED,
+    BATCH_OUTPUT_FAILED,
+    BATCH_CRASHED
+};
+
+static const char *batch_status_name[] = {
+    "ok",
+    "load failed",
+    "output failed",
+    "crashed"
+};
+
+struct batch_result_t {
+    int32_t index;
+    int32_t status;
+    uint32_t bytes; // MIDI bytes sent
+    double length; // emulated seconds rendered
+    double wall; // seconds it took
+};
+
+static const double batch_boot = 2.0; // seconds before the reset
+static const double batch_settle = 0.5; // after it
+static const double batch_tail = 2.0; // rendered after the last event
+
+static void MCU_BatchRun(double seconds)
+{
+    uint64_t end = audio_frames_total + (uint64_t)(seconds * audio_rate_native);
+    while (audio_frames_total < end)
+        MCU_Step();
+}
+
+static int MCU_BatchRender(const char *midiPath, const std::string &wavPath, int pageSize, int pageNum,
+                           int rate, int quality, batch_result_t *result)
+{
+    std::vector<midi_file_byte_t> bytes;
+    if (!MIDIFILE_Load(midiPath, bytes))
+        return BATCH_LOAD_FAILED;
+    result->bytes = (uint32_t)bytes.size();
+
+    MCU_CloseAudio();
+    std::string spec = "wav:" + wavPath;
+    if (!AUDIO_SelectSink(spec.c_str()) || !MCU_OpenAudio(-1, pageSize, pageNum, rate, quality, 0, false))
+        return BATCH_OUTPUT_FAILED;
+
+    uint64_t t0 = SDL_GetPerformanceCounter();
+
+    // the mcu clock per audio frame is fixed for a romset, so an event's
+    // cycle follows from its time, measured over the boot
+    uint64_t base = mcu.cycles;
+    uint64_t base_frames = audio_frames_total;
+    audio_frames_total = 0;
+
+    // bytes are posted ahead and wait in the ring for their cycle
+    size_t pos = 0;
+    uint64_t end = (uint64_t)(batch_tail * audio_rate_native);
+    if (!bytes.empty())
+        end += (uint64_t)(bytes.back().time * audio_rate_native);
+    while (audio_frames_total < end)
+    {
+        while (pos < bytes.size() && !MCU_UART_Full())
+        {
+            uint64_t frames = (uint64_t)(bytes[pos].time * audio_rate_native);
+            MCU_PostUARTCycles(bytes[pos].data, base + frames * base / base_frames);
+            pos++;
+        }
+        MCU_Step();
+    }
+
+    MCU_CloseAudio();
+    result->length = (double)audio_frames_total / (double)audio_rate_native;
+    result->wall = (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency();
+    return BATCH_OK;
+}
+
+static void MCU_BatchCSVString(FILE *f, const std::string &str)
+{
+    fputc('"', f);
+    for (size_t i = 0; i < str.size(); i++)
+    {
+        if (str[i] == '"')
+            fputc('"', f);
+        fputc(str[i], f);
+    }
+    fputc('"', f);
+}
+
+static int MCU_Batch(const char *listPath, const std::string &outDir, int jobs, ResetType resetType,
+                     int pageSize, int pageNum, int rate, int quality)
+{
+#ifdef _WIN32
+    (void)listPath;
+    (void)outDir;
+    (void)jobs;
+    (void)resetType;
+    (void)pageSize;
+    (void)pageNum;
+    (void)rate;
+    (void)quality;
+    fprintf(stderr, "--batch is not supported on Windows.\n");
+    return 1;
+#else
+    FILE *list = Files::utf8_fopen(listPath, "r");
+    if (!list)
+    {
+        fprintf(stderr, "ERROR: Failed to open the batch list %s.\n", listPath);
+        return 1;
+    }
+    std::vector<std::string> songs;
+    char line[4096];
+    while (fgets(line, sizeof(line), list))
+    {
+        size_t len = strlen(line);
+        while (len && (line[len - 1] == '\n' || line[len - 1] == '\r'))
+            line[--len] = 0;
+        if (len && line[0] != '#')
+            songs.push_back(line);
+    }
+    fclose(list);
+    if (songs.empty())
+    {
+        fprintf(stderr, "ERROR: No MIDI files in %s.\n", listPath);
+        return 1;
+    }
+
+    // <out dir>/<name>.wav, a name already taken gets -2, -3, ... appended
+    // until it is unique, also against files literally named like that
+    std::vector<std::string> outputs;
+    std::set<std::string> used;
+    for (size_t i = 0; i < songs.size(); i++)
+    {
+        std::string base = Files::basenameNoSuffix(songs[i]);
+        std::string name = base;
+        for (int n = 2; used.count(name); n++)
+            name = base + "-" + std::to_string(n);
+        used.insert(name);
+        outputs.push_back(outDir + "/" + name + ".wav");
+    }
+
+    if (!Files::dirExists(outDir) && mkdir(outDir.c_str(), 0777) != 0)
+    {
+        fprintf(stderr, "ERROR: Failed to create %s.\n", outDir.c_str());
+        return 1;
+    }
+
+    std::string csvPath = outDir + "/summary.csv";
+    FILE *csv = Files::utf8_fopen(csvPath.c_str(), "w");
+    if (!csv)
+    {
+        fprintf(stderr, "ERROR: Failed to create %s.\n", csvPath.c_str());
+        return 1;
+    }
+
+    int fds[2];
+    if (pipe(fds) != 0)
+    {
+        fprintf(stderr, "Batch: pipe failed.\n");
+        fclose(csv);
+        return 1;
+    }
+    fcntl(fds[0], F_SETFL, fcntl(fds[0], F_GETFL) | O_NONBLOCK);
+
+    // the state every song starts from
+    audio_frames_total = 0;
+    MCU_BatchRun(batch_boot);
+    MIDI_Reset(resetType);
+    MCU_BatchRun(batch_settle);
+
+    std::vector<batch_result_t> results(songs.size());
+    std::vector<bool> reported(songs.size(), false);
+    std::vector<pid_t> workers(songs.size(), 0);
+    for (size_t i = 0; i < songs.size(); i++)
+    {
+        memset(&results[i], 0, sizeof(batch_result_t));
+        results[i].index = (int32_t)i;
+        results[i].status = BATCH_CRASHED; // unless the worker reports back
+    }
+
+    uint64_t t0 = SDL_GetPerformanceCounter();
+    size_t next = 0;
+    size_t finished = 0;
+    int running = 0;
+    while (next < songs.size() || running)
+    {
+        while (running < jobs && next < songs.size())
+        {
+            fflush(stdout);
+            fflush(stderr);
+            pid_t pid = fork();
+            if (pid < 0)
+            {
+                fprintf(stderr, "Batch: fork failed.\n");
+                break;
+            }
+            if (pid == 0)
+            {
+                close(fds[0]);
+                batch_result_t result = results[next];
+                result.status = MCU_BatchRender(songs[next].c_str(), outputs[next], pageSize, pageNum,
+                                                rate, quality, &result);
+                // smaller than PIPE_BUF, so workers' writes don't interleave
+                if (write(fds[1], &result, sizeof(result)) != (ssize_t)sizeof(result))
+                    fprintf(stderr, "Batch: failed to report %s.\n", songs[next].c_str());
+                fflush(stdout);
+                fflush(stderr);
+                _exit(0);
+            }
+            workers[next] = pid;
+            next++;
+            running++;
+        }
+        if (!running)
+            break;
+
+        int status;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid < 0)
+            break;
+        running--;
+
+        batch_result_t result;
+        while (read(fds[0], &result, sizeof(result)) == (ssize_t)sizeof(result))
+        {
+            if (result.index < 0 || (size_t)result.index >= songs.size())
+                continue;
+            results[result.index] = result;
+            reported[result.index] = true;
+            finished++;
+            fprintf(stderr, "[%u/%u] %s: %s", (unsigned)finished, (unsigned)songs.size(),
+                    songs[result.index].c_str(), batch_status_name[result.status]);
+            if (result.status == BATCH_OK)
+                fprintf(stderr, ", %.1f s in %.1f s", result.length, result.wall);
+            fprintf(stderr, "\n");
+        }
+
+        // a worker that died before reporting back, its result stays crashed
+        for (size_t i = 0; i < next; i++)
+        {
+            if (workers[i] != pid || reported[i])
+                continue;
+            reported[i] = true;
+            finished++;
+            fprintf(stderr, "[%u/%u] %s: %s", (unsigned)finished, (unsigned)songs.size(),
+                    songs[i].c_str(), batch_status_name[BATCH_CRASHED]);
+            if (WIFSIGNALED(status))
+                fprintf(stderr, " (signal %d)", WTERMSIG(status));
+            else if (WIFEXITED(status))
+                fprintf(stderr, " (exit code %d)", WEXITSTATUS(status));
+            fprintf(stderr, "\n");
+        }
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    double wall = (double)(SDL_GetPerformanceCounter() - t0) / (double)SDL_GetPerformanceFrequency();
+    double rendered = 0.0;
+    int failed = 0;
+
+    fprintf(csv, "file,output,status,midi_bytes,length_seconds,render_seconds,realtime_factor\n");
+    for (size_t i = 0; i < songs.size(); i++)
+    {
+        const batch_result_t &r = results[i];
+        MCU_BatchCSVString(csv, songs[i]);
+        fputc(',', csv);
+        MCU_BatchCSVString(csv, r.status == BATCH_OK ? outputs[i] : std::string());
+        fprintf(csv, ",%s,%u,%.3f,%.3f,%.2f\n", batch_status_name[r.status], r.bytes, r.length, r.wall,
+                r.wall > 0.0 ? r.length / r.wall : 0.0);
+        if (r.status == BATCH_OK)
+            rendered += r.length;
+        else
+            failed++;
+    }
+    fclose(csv);
+
+    fprintf(stderr, "Batch: %u files, %d failed, %.1f s of audio in %.1f s with %d jobs (%.1fx realtime). Summary in %s.\n",
+            (unsigned)songs.size(), failed, rendered, wall, jobs, wall > 0.0 ? rendered / wall : 0.0, csvPath.c_str());
+    return failed ? 1 : 0;
+#endif
+}
+
+void MCU_SetRomset(int rs)
+{
+    romset = rs;
+
+    mcu_mk1 = false;
+    mcu_cm300 = false;
+    mcu_st = false;
+    mcu_jv880 = false;
+    mcu_scb55 = false;
+    mcu_sc155 = false;
+    switch (romset)
+    {
+        case ROM_SET_MK2:
+        case ROM_SET_SC155MK2:
+            if (romset == ROM_SET_SC155MK2)
+                mcu_sc155 = true;
+            break;
+        case ROM_SET_ST:
+            mcu_st = true;
+            break;
+        case ROM_SET_MK1:
+        case ROM_SET_SC155:
+            mcu_mk1 = true;
+            mcu_st = false;
+            if (romset == ROM_SET_SC155)
+                mcu_sc155 = true;
+            break;
+        case ROM_SET_CM300:
+            mcu_mk1 = true;
+            mcu_cm300 = true;
+            break;
+        case ROM_SET_JV880:
+            mcu_jv880 = true;
+            rom2_mask /= 2; // rom is half the size
+            lcd_width = 820;
+            lcd_height = 100;
+            lcd_col1 = 0x000000;
+            lcd_col2 = 0x78b500;
+            break;
+        case ROM_SET_SCB55:
+        case ROM_SET_RLP3237:
+            mcu_scb55 = true;
+            break;
+    }
+
+    MCU_SelectModel();
+}
+
+int MCU_RomsPresent(int rs, const std::string &basePath)
+{
+    for (size_t i = 0; i < ROM_SET_N_FILES; i++)
+    {
+        if (roms[rs][i][0] == '\0')
+            continue;
+        if (rs == ROM_SET_JV880 && i >= 4) // expansion and card are optional
+            continue;
+        std::string path = basePath + "/" + roms[rs][i];
+        FILE *h = Files::utf8_fopen(path.c_str(), "rb");
+        if (!h)
+            return 0;
+        fclose(h);
+    }
+    return 1;
+}
+
+int MCU_LoadRoms(const std::string &basePath)
+{
+    std::string rpaths[ROM_SET_N_FILES];
+
+    bool r_ok = true;
+    std::string errors_list;
+
+    for(size_t i = 0; i < ROM_SET_N_FILES; ++i)
+    {
+        if (roms[romset][i][0] == '\0')
+        {
+            rpaths[i] = "";
+            continue;
+        }
+        rpaths[i] = basePath + "/" + roms[romset][i];
+        s_rf[i] = Files::utf8_fopen(rpaths[i].c_str(), "rb");
+        bool optional = mcu_jv880 && i >= 4;
+        r_ok &= optional || (s_rf[i] != nullptr);
+        if(!s_rf[i])
+        {
+            if(!errors_list.empty())
+                errors_list.append(", ");
+
+            errors_list.append(rpaths[i]);
+        }
+    }
+
+    if (!r_ok)
+    {
+        fprintf(stderr, "FATAL ERROR: One of required data ROM files is missing: %s.\n", errors_list.c_str());
+        fflush(stderr);
+        closeAllR();
+        return 0;
+    }
+
+    if (fread(rom1, 1, ROM1_SIZE, s_rf[0]) != ROM1_SIZE)
+    {
+        fprintf(stderr, "FATAL ERROR: Failed to read the mcu ROM1.\n");
+        fflush(stderr);
+        closeAllR();
+        return 0;
+    }
+
+    size_t rom2_read = fread(rom2, 1, ROM2_SIZE, s_rf[1]);
+
+    if (rom2_read == ROM2_SIZE || rom2_read == ROM2_SIZE / 2)
+    {
+        rom2_mask = rom2_read - 1;
+    }
+    else
+    {
+        fprintf(stderr, "FATAL ERROR: Failed to read the mcu ROM2.\n");
+        fflush(stderr);
+        closeAllR();
+        return 0;
+    }
+
+    if (mcu_mk1)
+    {
+        if (fread(tempbuf, 1, 0x100000, s_rf[2]) != 0x100000)
+        {
+            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom1.\n");
+            fflush(stderr);
+            closeAllR();
+            return 0;
+        }
+
+        unscramble(tempbuf, waverom1, 0x100000);
+
+        if (fread(tempbuf, 1, 0x100000, s_rf[3]) != 0x100000)
+        {
+            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom2.\n");
+            fflush(stderr);
+            closeAllR();
+            return 0;
+        }
+
+        unscramble(tempbuf, waverom2, 0x100000);
+
+        if (fread(tempbuf, 1, 0x100000, s_rf[4]) != 0x100000)
+        {
+            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom3.\n");
+            fflush(stderr);
+            closeAllR();
+            return 0;
+        }
+
+        unscramble(tempbuf, waverom3, 0x100000);
+    }
+    else if (mcu_jv880)
+    {
+        if (fread(tempbuf, 1, 0x200000, s_rf[2]) != 0x200000)
+        {
+            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom1.\n");
+            fflush(stderr);
+            closeAllR();
+            return 0;
+        }
+
+        unscramble(tempbuf, waverom1, 0x200000);
+
+        if (fread(tempbuf, 1, 0x200000, s_rf[3]) != 0x200000)
+        {
+            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom2.\n");
+            fflush(stderr);
+            closeAllR();
+            return 0;
+        }
+
+        unscramble(tempbuf, waverom2, 0x200000);
+        
+        if (s_rf[4] && fread(tempbuf, 1, 0x800000, s_rf[4]))
+            unscramble(tempbuf, waverom_exp, 0x800000);
+        else
+            printf("WaveRom EXP not found, skipping it.\n");
+        
+        if (s_rf[5] && fread(tempbuf, 1, 0x200000, s_rf[5]))
+            unscramble(tempbuf, waverom_card, 0x200000);
+        else
+            printf("WaveRom PCM not found, skipping it.\n");
+    }
+    else
+    {
+        if (fread(tempbuf, 1, 0x200000, s_rf[2]) != 0x200000)
+        {
+            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom1.\n");
+            fflush(stderr);
+            closeAllR();
+            return 0;
+        }
+
+        unscramble(tempbuf, waverom1, 0x200000);
+
+        if (s_rf[3])
+        {
+            if (fread(tempbuf, 1, 0x100000, s_rf[3]) != 0x100000)
+            {
+                fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom2.\n");
+                fflush(stderr);
+                closeAllR();
+                return 0;
+            }
+
+            unscramble(tempbuf, mcu_scb55 ? waverom3 : waverom2, 0x100000);
+        }
+
+        if (s_rf[4] && fread(sm_rom, 1, ROMSM_SIZE, s_rf[4]) != ROMSM_SIZE)
+        {
+            fprintf(stderr, "FATAL ERROR: Failed to read the sub mcu ROM.\n");
+            fflush(stderr);
+            closeAllR();
+            return 0;
+        }
+    }
+
+    // Close all files as they no longer needed being open
+    closeAllR();
+
+    return 1;
+}
+
+#ifndef SC55_NO_MAIN // the benchmark target brings its own
+int main(int argc, char *argv[])
+{
+    (void)argc;
+    std::string basePath;
+
+    int port = 0;
+    int outPort = -1;
+    std::string txPath;
+    bool alsaSeq = false;
+    std::string alsaName = "Nuked SC55";
+    std::string lcdTextPath;
+    std::string recordPath;
+    std::string replayPath;
+    std::string batchPath;
+    std::string batchOut = ".";
+    int batchJobs = 0; // 0 - one per CPU
+    double benchSeconds = 0.0;
+    bool benchMIDI = false;
+    FILE *benchOut = NULL;
+    std::string tracePath;
+    std::string profilePath;
+    uint32_t profileInterval = 101; // prime, so it doesn't lock onto firmware loops
+    uint64_t lockstepInterval = 0;
+    double lockstepSeconds = 60.0;
+    int audioDeviceIndex = -1;
+    int pageSize = 512;
+    int pageNum = 32;
+    int audioRate = 0;
+    int resampleQuality = RESAMPLER_QUALITY_HIGH;
+    int audioLatency = 0;
+    bool audioPull = false;
+    bool autodetect = true;
+    ResetType resetType = ResetType::NONE;
+
+    romset = ROM_SET_MK2;
+
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            if (!strncmp(argv[i], "-p:", 3))
+            {
+                port = atoi(argv[i] + 3);
+            }
+            else if (!strncmp(argv[i], "-po:", 4))
+            {
+                outPort = atoi(argv[i] + 4);
+            }
+            else if (!strncmp(argv[i], "-txf:", 5))
+            {
+                txPath = argv[i] + 5;
+            }
+            else if (!strcmp(argv[i], "-alsa") || !strncmp(argv[i], "-alsa:", 6))
+            {
+#ifdef USE_ALSA_SEQ
+                alsaSeq = true;
+                if (argv[i][5] == ':' && argv[i][6])
+                    alsaName = argv[i] + 6;
+#else
+                printf("ALSA sequencer support is not compiled in, -alsa ignored.\n");
+#endif
+            }
+            else if (!strncmp(argv[i], "-a:", 3))
+            {
+                audioDeviceIndex = atoi(argv[i] + 3);
+            }
+            else if (!strncmp(argv[i], "-ab:", 4))
+            {
+                char* pColon = argv[i] + 3;
+                
+                if (pColon[1] != 0)
+                {
+                    pageSize = atoi(++pColon);
+                    pColon = strchr(pColon, ':');
+                    if (pColon && pColon[1] != 0)
+                    {
+                        pageNum = atoi(++pColon);
+                    }
+                }
+                
+                // reset both if either is invalid
+                if (pageSize <= 0 || pageNum <= 0)
+                {
+                    pageSize = 512;
+                    pageNum = 32;
+                }
+            }
+            else if (!strncmp(argv[i], "-sr:", 4))
+            {
+                audioRate = atoi(argv[i] + 4);
+                if (audioRate < 0)
+                    audioRate = 0;
+            }
+            else if (!strncmp(argv[i], "-rq:", 4))
+            {
+                for (int j = 0; j < RESAMPLER_QUALITY_COUNT; j++)
+                {
+                    if (!strcmp(argv[i] + 4, resampler_quality_name[j]))
+                        resampleQuality = j;
+                }
+            }
+            else if (!strncmp(argv[i], "-lat:", 5))
+            {
+                audioLatency = atoi(argv[i] + 5);
+                if (audioLatency < 0)
+                    audioLatency = 0;
+            }
+            else if (!strncmp(argv[i], "-ao:", 4))
+            {
+                if (!AUDIO_SelectSink(argv[i] + 4))
+                    return 1;
+            }
+            else if (!strncmp(argv[i], "-stats:", 7))
+            {
+                stats_interval = atof(argv[i] + 7);
+                if (stats_interval <= 0.0)
+                {
+                    printf("Invalid stats interval: %s\n", argv[i] + 7);
+                    return 1;
+                }
+            }
+            else if (!strncmp(argv[i], "-statsfile:", 11))
             {
-                port = atoi(argv[i] + 3);
+                stats_path = argv[i] + 11;
+                if (stats_interval == 0.0)
+                    stats_interval = 5.0;
             }
-            else if (!strncmp(argv[i], "-a:", 3))
+            else if (!strcmp(argv[i], "-fastuart"))
             {
-                audioDeviceIndex = atoi(argv[i] + 3);
+                mcu_fast_uart = 1;
             }
-            else if (!strncmp(argv[i], "-ab:", 4))
+            else if (!strcmp(argv[i], "-jit"))
             {
-                char* pColon = argv[i] + 3;
-                
-                if (pColon[1] != 0)
+                mcu_jit = 1;
+            }
+            else if (!strcmp(argv[i], "--bench") && i + 1 < argc)
+            {
+                benchSeconds = atof(argv[++i]);
+                if (benchSeconds <= 0.0)
                 {
-                    pageSize = atoi(++pColon);
-                    pColon = strchr(pColon, ':');
-                    if (pColon && pColon[1] != 0)
-                    {
-                        pageNum = atoi(++pColon);
-                    }
+                    printf("Invalid benchmark duration: %s\n", argv[i]);
+                    return 1;
                 }
-                
-                // reset both if either is invalid
-                if (pageSize <= 0 || pageNum <= 0)
+                // results only on stdout, log output goes to stderr
+                benchOut = AUDIO_ClaimStdout();
+                if (!benchOut)
+                    return 1;
+            }
+            else if (!strcmp(argv[i], "--bench-midi"))
+            {
+                benchMIDI = true;
+            }
+            else if (!strcmp(argv[i], "--record") && i + 1 < argc)
+            {
+                recordPath = argv[++i];
+            }
+            else if (!strcmp(argv[i], "--replay") && i + 1 < argc)
+            {
+                replayPath = argv[++i];
+            }
+            else if (!strcmp(argv[i], "--batch") && i + 1 < argc)
+            {
+                batchPath = argv[++i];
+            }
+            else if (!strcmp(argv[i], "--batch-out") && i + 1 < argc)
+            {
+                batchOut = argv[++i];
+            }
+            else if (!strcmp(argv[i], "--batch-jobs") && i + 1 < argc)
+            {
+                batchJobs = atoi(argv[++i]);
+                if (batchJobs <= 0)
                 {
-                    pageSize = 512;
-                    pageNum = 32;
+                    printf("Invalid number of batch jobs: %s\n", argv[i]);
+                    return 1;
                 }
             }
+            else if (!strcmp(argv[i], "--trace") && i + 1 < argc)
+            {
+                tracePath = argv[++i];
+            }
+            else if (!strcmp(argv[i], "--profile") && i + 1 < argc)
+            {
+                profilePath = argv[++i];
+            }
+            else if (!strcmp(argv[i], "--profile-interval") && i + 1 < argc)
+            {
+                profileInterval = (uint32_t)strtoul(argv[++i], NULL, 10);
+                if (profileInterval == 0)
+                {
+                    printf("Invalid profile interval: %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if (!strcmp(argv[i], "--lockstep") && i + 1 < argc)
+            {
+                lockstepInterval = strtoull(argv[++i], NULL, 10);
+                if (lockstepInterval == 0)
+                {
+                    printf("Invalid lockstep interval: %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if (!strcmp(argv[i], "--lockstep-time") && i + 1 < argc)
+            {
+                lockstepSeconds = atof(argv[++i]);
+                if (lockstepSeconds <= 0.0)
+                {
+                    printf("Invalid lockstep duration: %s\n", argv[i]);
+                    return 1;
+                }
+            }
+            else if (!strcmp(argv[i], "-nogui"))
+            {
+                lcd_nogui = 1;
+            }
+            else if (!strcmp(argv[i], "-lcdtext"))
+            {
+                lcdTextPath = "-";
+            }
+            else if (!strncmp(argv[i], "-lcdtext:", 9))
+            {
+                lcdTextPath = argv[i] + 9;
+            }
+            else if (!strcmp(argv[i], "-pull"))
+            {
+                audioPull = true;
+            }
             else if (!strcmp(argv[i], "-mk2"))
             {
                 romset = ROM_SET_MK2;
@@ -1461,8 +3832,18 @@ int main(int argc, char *argv[])
                 printf("  -h, -help, --help              Display this information.\n");
                 printf("\n");
                 printf("  -p:<port_number>               Set MIDI port.\n");
+                printf("  -po:<port_number>              Set MIDI output port (data sent by the emulated unit).\n");
+                printf("  -txf:<path>                    Write data sent by the emulated unit to a file.\n");
+#ifdef USE_ALSA_SEQ
+                printf("  -alsa[:<name>]                 Create a virtual ALSA sequencer client instead of using -p.\n");
+#endif
                 printf("  -a:<device_number>             Set Audio Device index.\n");
                 printf("  -ab:<page_size>:[page_count]   Set Audio Buffer size.\n");
+                printf("  -sr:<rate>                     Set output sample rate (resample from native rate).\n");
+                printf("  -rq:<low|medium|high>          Set resampler quality.\n");
+                printf("  -lat:<ms>                      Set target latency (adaptive rate control).\n");
+                printf("  -pull                          Run emulator from the audio callback (low latency).\n");
+                printf("  -ao:<output>[:<path>]          Set audio output: sdl, wav, raw or null (path \"-\" is stdout).\n");
                 printf("\n");
                 printf("  -mk2                           Use SC-55mk2 ROM set.\n");
                 printf("  -st                            Use SC-55st ROM set.\n");
@@ -1474,6 +3855,26 @@ int main(int argc, char *argv[])
                 printf("\n");
                 printf("  -gs                            Reset system in GS mode.\n");
                 printf("  -gm                            Reset system in GM mode.\n");
+                printf("  -fastuart                      Speed up MIDI input while no notes are playing (SysEx dumps).\n");
+                printf("  -jit                           Translate firmware ROM code to x86-64 code (experimental).\n");
+                printf("  -stats:<seconds>               Print underrun, buffer and MIDI latency stats periodically.\n");
+                printf("  -statsfile:<path>              Write the stats to a file instead (every 5 seconds by default).\n");
+                printf("\n");
+                printf("  -nogui                         Run without a window (implies -lcdtext).\n");
+                printf("  -lcdtext[:<path>]              Print display contents to the terminal or a status file.\n");
+                printf("\n");
+                printf("  --bench <seconds>              Run headless and unthrottled, print performance as JSON.\n");
+                printf("  --bench-midi                   Play a synthetic MIDI stream during --bench or --lockstep.\n");
+                printf("  --record <file>                Log MIDI input with the cycle it reached the firmware at.\n");
+                printf("  --replay <file>                Play a --record log headless, to -ao or into --bench/--lockstep.\n");
+                printf("  --batch <list>                 Render the MIDI files listed in a file to WAV, in parallel.\n");
+                printf("  --batch-out <dir>              Directory for the --batch WAV files and summary.csv (default .).\n");
+                printf("  --batch-jobs <n>               Songs rendered at once (default one per CPU).\n");
+                printf("  --trace <file>                 Write a Chrome trace (JSON) of host activity.\n");
+                printf("  --profile <file>               Sample the firmware program counters, write a hot spot report.\n");
+                printf("  --profile-interval <steps>     Steps between --profile samples (default 101).\n");
+                printf("  --lockstep <instructions>      Run reference and optimized cores side by side, compare state.\n");
+                printf("  --lockstep-time <seconds>      Emulated time to run --lockstep for (default 60).\n");
                 return 0;
             }
             else if (!strcmp(argv[i], "-sc155"))
@@ -1533,225 +3934,143 @@ int main(int argc, char *argv[])
         printf("ROM set autodetect: %s\n", rs_name[romset]);
     }
 
-    mcu_mk1 = false;
-    mcu_cm300 = false;
-    mcu_st = false;
-    mcu_jv880 = false;
-    mcu_scb55 = false;
-    mcu_sc155 = false;
-    switch (romset)
-    {
-        case ROM_SET_MK2:
-        case ROM_SET_SC155MK2:
-            if (romset == ROM_SET_SC155MK2)
-                mcu_sc155 = true;
-            break;
-        case ROM_SET_ST:
-            mcu_st = true;
-            break;
-        case ROM_SET_MK1:
-        case ROM_SET_SC155:
-            mcu_mk1 = true;
-            mcu_st = false;
-            if (romset == ROM_SET_SC155)
-                mcu_sc155 = true;
-            break;
-        case ROM_SET_CM300:
-            mcu_mk1 = true;
-            mcu_cm300 = true;
-            break;
-        case ROM_SET_JV880:
-            mcu_jv880 = true;
-            rom2_mask /= 2; // rom is half the size
-            lcd_width = 820;
-            lcd_height = 100;
-            lcd_col1 = 0x000000;
-            lcd_col2 = 0x78b500;
-            break;
-        case ROM_SET_SCB55:
-        case ROM_SET_RLP3237:
-            mcu_scb55 = true;
-            break;
-    }
+    MCU_SetRomset(romset);
 
-    std::string rpaths[ROM_SET_N_FILES];
+    if (!MCU_LoadRoms(basePath))
+        return 1;
 
-    bool r_ok = true;
-    std::string errors_list;
+#ifdef USE_INSTRUCTION_TRACE
+    signal(SIGSEGV, MCU_ITraceCrash);
+    signal(SIGILL, MCU_ITraceCrash);
+    signal(SIGFPE, MCU_ITraceCrash);
+#ifdef SIGBUS
+    signal(SIGBUS, MCU_ITraceCrash);
+#endif
+#endif
 
-    for(size_t i = 0; i < ROM_SET_N_FILES; ++i)
+    if (!recordPath.empty() && lockstepInterval)
     {
-        if (roms[romset][i][0] == '\0')
-        {
-            rpaths[i] = "";
-            continue;
-        }
-        rpaths[i] = basePath + "/" + roms[romset][i];
-        s_rf[i] = Files::utf8_fopen(rpaths[i].c_str(), "rb");
-        bool optional = mcu_jv880 && i >= 4;
-        r_ok &= optional || (s_rf[i] != nullptr);
-        if(!s_rf[i])
-        {
-            if(!errors_list.empty())
-                errors_list.append(", ");
-
-            errors_list.append(rpaths[i]);
-        }
+        fprintf(stderr, "ERROR: --record can't be combined with --lockstep.\n");
+        return 1;
     }
-
-    if (!r_ok)
+    if (!batchPath.empty() && (benchSeconds > 0.0 || lockstepInterval || !replayPath.empty()
+        || !recordPath.empty() || !profilePath.empty()))
     {
-        fprintf(stderr, "FATAL ERROR: One of required data ROM files is missing: %s.\n", errors_list.c_str());
-        fflush(stderr);
-        closeAllR();
+        fprintf(stderr, "ERROR: --batch can't be combined with --bench, --lockstep, --replay, --record or --profile.\n");
         return 1;
     }
+    if (!replayPath.empty() && !MCU_ReplayOpen(replayPath.c_str()))
+        return 1;
 
     LCD_SetBackPath(basePath + "/back.data");
+    if (benchSeconds > 0.0 || lockstepInterval || !replayPath.empty() || !batchPath.empty())
+    {
+        // nothing but the emulator itself; a plain replay may still render
+        // to a file sink
+        lcd_nogui = 1;
+        lcdTextPath.clear();
+        if (benchSeconds > 0.0 || lockstepInterval || !batchPath.empty() || audio_sink == &audio_sink_sdl)
+            AUDIO_SelectSink("null");
+    }
+    else if (lcd_nogui && lcdTextPath.empty())
+        lcdTextPath = "-";
+    LCD_SetTextPath(lcdTextPath);
 
     memset(&mcu, 0, sizeof(mcu_t));
 
+    Uint32 sdl_flags = SDL_INIT_TIMER;
+    if (!lcd_nogui)
+        sdl_flags |= SDL_INIT_VIDEO;
+    if (audio_sink == &audio_sink_sdl)
+        sdl_flags |= SDL_INIT_AUDIO;
 
-    if (fread(rom1, 1, ROM1_SIZE, s_rf[0]) != ROM1_SIZE)
+    if (SDL_Init(sdl_flags) < 0)
     {
-        fprintf(stderr, "FATAL ERROR: Failed to read the mcu ROM1.\n");
+        fprintf(stderr, "FATAL ERROR: Failed to initialize the SDL2: %s.\n", SDL_GetError());
         fflush(stderr);
-        closeAllR();
-        return 1;
+        return 2;
     }
 
-    size_t rom2_read = fread(rom2, 1, ROM2_SIZE, s_rf[1]);
+    // before the audio device starts calling back
+    if (!tracePath.empty() && benchSeconds == 0.0 && !lockstepInterval && replayPath.empty() && batchPath.empty())
+        TRACE_Open(tracePath.c_str());
 
-    if (rom2_read == ROM2_SIZE || rom2_read == ROM2_SIZE / 2)
-    {
-        rom2_mask = rom2_read - 1;
-    }
-    else
+    if (!MCU_OpenAudio(audioDeviceIndex, pageSize, pageNum, audioRate, resampleQuality, audioLatency, audioPull))
     {
-        fprintf(stderr, "FATAL ERROR: Failed to read the mcu ROM2.\n");
+        fprintf(stderr, "FATAL ERROR: Failed to open the audio stream.\n");
         fflush(stderr);
-        closeAllR();
-        return 1;
+        return 2;
     }
 
-    if (mcu_mk1)
+    if (benchSeconds > 0.0 || lockstepInterval || !replayPath.empty() || !batchPath.empty())
     {
-        if (fread(tempbuf, 1, 0x100000, s_rf[2]) != 0x100000)
-        {
-            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom1.\n");
-            fflush(stderr);
-            closeAllR();
-            return 1;
-        }
-
-        unscramble(tempbuf, waverom1, 0x100000);
-
-        if (fread(tempbuf, 1, 0x100000, s_rf[3]) != 0x100000)
-        {
-            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom2.\n");
-            fflush(stderr);
-            closeAllR();
+        LCD_Init();
+        MCU_Init();
+        MCU_PatchROM();
+        MCU_Reset();
+        SM_Reset();
+        PCM_Reset();
+        if (mcu_jit && !MCU_JIT_Init())
             return 1;
-        }
 
-        unscramble(tempbuf, waverom2, 0x100000);
+        // a replayed log already holds the reset the recording was made with,
+        // a batch resets after booting
+        if (resetType != ResetType::NONE && replayPath.empty() && batchPath.empty()) MIDI_Reset(resetType);
 
-        if (fread(tempbuf, 1, 0x100000, s_rf[4]) != 0x100000)
-        {
-            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom3.\n");
-            fflush(stderr);
-            closeAllR();
-            return 1;
-        }
+        if (!profilePath.empty())
+            PROFILE_Init(profileInterval);
 
-        unscramble(tempbuf, waverom3, 0x100000);
-    }
-    else if (mcu_jv880)
-    {
-        if (fread(tempbuf, 1, 0x200000, s_rf[2]) != 0x200000)
-        {
-            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom1.\n");
-            fflush(stderr);
-            closeAllR();
+        if (!recordPath.empty() && !MCU_RecordOpen(recordPath.c_str()))
             return 1;
-        }
-
-        unscramble(tempbuf, waverom1, 0x200000);
 
-        if (fread(tempbuf, 1, 0x200000, s_rf[3]) != 0x200000)
+        int result = 0;
+        if (!batchPath.empty())
         {
-            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom2.\n");
-            fflush(stderr);
-            closeAllR();
-            return 1;
+            if (!batchJobs)
+                batchJobs = SDL_GetCPUCount();
+            result = MCU_Batch(batchPath.c_str(), batchOut, batchJobs,
+                               resetType == ResetType::GM_RESET ? ResetType::GM_RESET : ResetType::GS_RESET,
+                               pageSize, pageNum, audioRate, resampleQuality);
         }
-
-        unscramble(tempbuf, waverom2, 0x200000);
-        
-        if (s_rf[4] && fread(tempbuf, 1, 0x800000, s_rf[4]))
-            unscramble(tempbuf, waverom_exp, 0x800000);
-        else
-            printf("WaveRom EXP not found, skipping it.\n");
-        
-        if (s_rf[5] && fread(tempbuf, 1, 0x200000, s_rf[5]))
-            unscramble(tempbuf, waverom_card, 0x200000);
+        else if (lockstepInterval)
+            result = MCU_Lockstep(lockstepInterval, lockstepSeconds, benchMIDI);
+        else if (benchSeconds > 0.0)
+            MCU_Bench(benchSeconds, benchMIDI, benchOut);
         else
-            printf("WaveRom PCM not found, skipping it.\n");
-    }
-    else
-    {
-        if (fread(tempbuf, 1, 0x200000, s_rf[2]) != 0x200000)
-        {
-            fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom1.\n");
-            fflush(stderr);
-            closeAllR();
-            return 1;
-        }
+            MCU_Replay();
 
-        unscramble(tempbuf, waverom1, 0x200000);
+        MCU_RecordClose();
 
-        if (s_rf[3])
-        {
-            if (fread(tempbuf, 1, 0x100000, s_rf[3]) != 0x100000)
-            {
-                fprintf(stderr, "FATAL ERROR: Failed to read the WaveRom2.\n");
-                fflush(stderr);
-                closeAllR();
-                return 1;
-            }
+        if (!profilePath.empty())
+            PROFILE_Write(profilePath.c_str());
 
-            unscramble(tempbuf, mcu_scb55 ? waverom3 : waverom2, 0x100000);
-        }
+        MCU_CloseAudio();
+        LCD_UnInit();
+        SDL_Quit();
 
-        if (s_rf[4] && fread(sm_rom, 1, ROMSM_SIZE, s_rf[4]) != ROMSM_SIZE)
-        {
-            fprintf(stderr, "FATAL ERROR: Failed to read the sub mcu ROM.\n");
-            fflush(stderr);
-            closeAllR();
-            return 1;
-        }
+        return result;
     }
 
-    // Close all files as they no longer needed being open
-    closeAllR();
-
-    if (SDL_Init(SDL_INIT_AUDIO | SDL_INIT_VIDEO | SDL_INIT_TIMER) < 0)
+#ifdef USE_ALSA_SEQ
+    if (alsaSeq)
     {
-        fprintf(stderr, "FATAL ERROR: Failed to initialize the SDL2: %s.\n", SDL_GetError());
-        fflush(stderr);
-        return 2;
+        if (!MIDI_ALSA_Init(alsaName.c_str()))
+        {
+            fprintf(stderr, "ERROR: Failed to create the ALSA sequencer client.\nWARNING: Continuing without MIDI Input...\n");
+            fflush(stderr);
+        }
     }
-
-    if (!MCU_OpenAudio(audioDeviceIndex, pageSize, pageNum))
+    else
+#endif
+    if(!MIDI_Init(port))
     {
-        fprintf(stderr, "FATAL ERROR: Failed to open the audio stream.\n");
+        fprintf(stderr, "ERROR: Failed to initialize the MIDI Input.\nWARNING: Continuing without MIDI Input...\n");
         fflush(stderr);
-        return 2;
     }
 
-    if(!MIDI_Init(port))
+    if (!MIDITX_Init(outPort, txPath.empty() ? NULL : txPath.c_str(), alsaSeq))
     {
-        fprintf(stderr, "ERROR: Failed to initialize the MIDI Input.\nWARNING: Continuing without MIDI Input...\n");
+        fprintf(stderr, "ERROR: Failed to initialize the MIDI Output.\nWARNING: Continuing without MIDI Output...\n");
         fflush(stderr);
     }
 
@@ -1761,15 +4080,37 @@ int main(int argc, char *argv[])
     MCU_Reset();
     SM_Reset();
     PCM_Reset();
+    if (mcu_jit && !MCU_JIT_Init())
+        return 1;
+
+    // before the reset sysex, so the log replays from power on
+    if (!recordPath.empty() && !MCU_RecordOpen(recordPath.c_str()))
+        return 1;
 
     if (resetType != ResetType::NONE) MIDI_Reset(resetType);
+
+    if (!profilePath.empty())
+        PROFILE_Init(profileInterval);
     
     MCU_Run();
 
+    MCU_RecordClose();
+
+    if (!profilePath.empty())
+        PROFILE_Write(profilePath.c_str());
+
     MCU_CloseAudio();
+    MIDITX_Quit();
+#ifdef USE_ALSA_SEQ
+    if (alsaSeq)
+        MIDI_ALSA_Quit();
+    else
+#endif
     MIDI_Quit();
+    TRACE_Close();
     LCD_UnInit();
     SDL_Quit();
 
     return 0;
 }
+#endif
@@ -34,6 +34,8 @@
 #pragma once
 
 #include <stdint.h>
+#include <stdio.h>
+#include <string>
 #include "mcu_interrupt.h"
 #include "SDL_atomic.h"
 
@@ -191,24 +193,56 @@ struct mcu_t {
 extern mcu_t mcu;
 
 void MCU_ErrorTrap(void);
-
-uint8_t MCU_Read(uint32_t address);
-uint16_t MCU_Read16(uint32_t address);
+void MCU_ITraceDump(FILE *f, const char *reason);
+void MCU_ITraceFault(const char *reason); // dumps on the first fault only
+
+// Memory access per model, instantiated for MCU_MODEL_INSTANTIATE. The
+// step loop and the instruction handlers call these directly.
+template<class model>
+uint8_t MCU_ReadImpl(uint32_t address);
+template<class model>
+uint16_t MCU_Read16Impl(uint32_t address);
+template<class model>
+void MCU_WriteImpl(uint32_t address, uint8_t value);
+template<class model>
+void MCU_Write16Impl(uint32_t address, uint16_t value);
+
+// memory access for the selected model, see MCU_SelectModel
+extern uint8_t (*MCU_Read)(uint32_t address);
+extern uint16_t (*MCU_Read16)(uint32_t address);
 uint32_t MCU_Read32(uint32_t address);
-void MCU_Write(uint32_t address, uint8_t value);
-void MCU_Write16(uint32_t address, uint16_t value);
+extern void (*MCU_Write)(uint32_t address, uint8_t value);
+extern void (*MCU_Write16)(uint32_t address, uint16_t value);
 
 inline uint32_t MCU_GetAddress(uint8_t page, uint16_t address) {
     return (page << 16) + address;
 }
 
+template<class model>
 inline uint8_t MCU_ReadCode(void) {
-    return MCU_Read(MCU_GetAddress(mcu.cp, mcu.pc));
+    return MCU_ReadImpl<model>(MCU_GetAddress(mcu.cp, mcu.pc));
 }
 
+#ifdef USE_INSTRUCTION_TRACE
+// code bytes of the traced instruction as they are fetched, so a dump never
+// has to read memory again. MCU_ReadInstruction points this at the trace
+// entry and away from it (at a full record) once the instruction is done.
+struct mcu_itrace_code_t {
+    uint8_t bytes[4];
+    uint8_t length;
+};
+
+extern mcu_itrace_code_t *mcu_itrace_code;
+#endif
+
+template<class model>
 inline uint8_t MCU_ReadCodeAdvance(void) {
-    uint8_t ret = MCU_ReadCode();
+    uint8_t ret = MCU_ReadCode<model>();
     mcu.pc++;
+#ifdef USE_INSTRUCTION_TRACE
+    if (mcu_itrace_code->length < sizeof(mcu_itrace_code->bytes))
+        mcu_itrace_code->bytes[mcu_itrace_code->length++] = ret;
+#endif
     return ret;
 }
 
@@ -354,6 +388,16 @@ inline void MCU_SetStatus(uint32_t condition, uint32_t mask)
         mcu.sr &= ~mask;
 }
 
+template<class model>
+inline void MCU_PushStack(uint16_t data)
+{
+    if (mcu.r[7] & 1)
+        MCU_Interrupt_Exception(EXCEPTION_SOURCE_ADDRESS_ERROR);
+    mcu.r[7] -= 2;
+    MCU_Write16Impl<model>(mcu.r[7], data);
+}
+
+// for interrupt entry, off the per-instruction path
 inline void MCU_PushStack(uint16_t data)
 {
     if (mcu.r[7] & 1)
@@ -362,12 +406,13 @@ inline void MCU_PushStack(uint16_t data)
     MCU_Write16(mcu.r[7], data);
 }
 
+template<class model>
 inline uint16_t MCU_PopStack(void)
 {
     uint16_t ret;
     if (mcu.r[7] & 1)
         MCU_Interrupt_Exception(EXCEPTION_SOURCE_ADDRESS_ERROR);
-    ret = MCU_Read16(mcu.r[7]);
+    ret = MCU_Read16Impl<model>(mcu.r[7]);
     mcu.r[7] += 2;
     return ret;
 }
@@ -446,19 +491,63 @@ extern const char* rs_name[ROM_SET_COUNT];
 
 extern int romset;
 
+void MCU_SetRomset(int rs);
+int MCU_RomsPresent(int rs, const std::string &basePath); // all required files exist
+int MCU_LoadRoms(const std::string &basePath);
+
 extern int mcu_mk1;
 extern int mcu_cm300;
 extern int mcu_st;
 extern int mcu_jv880;
 extern int mcu_scb55;
 extern int mcu_sc155;
+extern int mcu_fast_uart;
+extern int mcu_reference; // checked by optimized paths, --lockstep runs both
+
+// Hardware families as far as the hot paths (memory map, PCM, timers,
+// step loop) are concerned. Those are templates on a model traits type:
+// mcu_model_t<family> answers at compile time, mcu_model_any_t reads the
+// flags above and is the reference for --lockstep.
+enum {
+    MCU_MODEL_MK2 = 0, // SC-55mk2, SC-55st, SC-155mk2
+    MCU_MODEL_MK1, // SC-55, SC-155
+    MCU_MODEL_CM300,
+    MCU_MODEL_JV880,
+    MCU_MODEL_SCB55, // SCB-55, RLP-3237
+    MCU_MODEL_COUNT
+};
+
+template<int family>
+struct mcu_model_t {
+    static bool mk1(void) { return family == MCU_MODEL_MK1 || family == MCU_MODEL_CM300; }
+    static bool cm300(void) { return family == MCU_MODEL_CM300; }
+    static bool jv880(void) { return family == MCU_MODEL_JV880; }
+    static bool scb55(void) { return family == MCU_MODEL_SCB55; }
+    static bool any(void) { return false; }
+};
+
+struct mcu_model_any_t {
+    static bool mk1(void) { return mcu_mk1 != 0; }
+    static bool cm300(void) { return mcu_cm300 != 0; }
+    static bool jv880(void) { return mcu_jv880 != 0; }
+    static bool scb55(void) { return mcu_scb55 != 0; }
+    static bool any(void) { return true; } // the reference decoder
+};
+
+// explicit instantiation list for templates defined in a .cpp file
+#define MCU_MODEL_INSTANTIATE(X) \
+    X(mcu_model_t<MCU_MODEL_MK2>) \
+    X(mcu_model_t<MCU_MODEL_MK1>) \
+    X(mcu_model_t<MCU_MODEL_CM300>) \
+    X(mcu_model_t<MCU_MODEL_JV880>) \
+    X(mcu_model_t<MCU_MODEL_SCB55>) \
+    X(mcu_model_any_t)
+
+void MCU_SelectModel(void); // after MCU_SetRomset and mcu_reference changes
 
 extern SDL_atomic_t mcu_button_pressed;
 
-static const uint32_t uart_buffer_size = 8192;
-extern uint32_t uart_write_ptr;
-extern uint32_t uart_read_ptr;
-extern uint8_t uart_buffer[uart_buffer_size];
+static const uint32_t uart_buffer_size = 8192; // power of 2
 
 uint8_t MCU_ReadP0(void);
 uint8_t MCU_ReadP1(void);
@@ -469,7 +558,24 @@ void MCU_GA_SetGAInt(int line, int value);
 void MCU_EncoderTrigger(int dir);
 
 void MCU_PostSample(int *sample);
-void MCU_PostUART(uint8_t data);
+// MIDI input, each producer thread has its own ring
+void MCU_PostUART(uint8_t data); // main thread
+void MCU_PostUARTTimed(uint8_t data, uint64_t time); // MIDI driver thread; time: host performance counter
+void MCU_PostUARTCycles(uint8_t data, uint64_t cycles); // emulator thread; cycles: mcu cycle to deliver byte at
+// MIDI input ring, consumer side (emulator thread)
+// ring stamps are in sub mcu clocks, fine enough for both consumers to be exact
+static const uint64_t uart_ticks_per_cycle = 5;
+bool MCU_UART_Peek(uint64_t *ticks); // ticks: earliest time to deliver byte at
+uint8_t MCU_UART_Pop(uint64_t ticks); // ticks: consumer clock now, for the MIDI recorder
+int MCU_UART_RXGap(void); // mcu cycles between received bytes
+void MCU_UART_GetStats(uint32_t *overflow, uint32_t *max_fill);
+// MIDI output ring (SCI TX), consumer side
+extern int mcu_uart_tx_capture;
+void MCU_UART_TXPush(uint8_t data);
+int MCU_UART_TXRead(uint8_t *data, int max);
+uint32_t MCU_UART_TXGetOverflow(void);
+
+void MCU_Step(void);
 
 void MCU_WorkThread_Lock(void);
 void MCU_WorkThread_Unlock(void);
@@ -34,6 +34,7 @@
 #include <stdio.h>
 #include "mcu.h"
 #include "mcu_interrupt.h"
+#include "trace.h"
 
 void MCU_Interrupt_Start(int32_t mask)
 {
@@ -73,11 +74,99 @@ void MCU_Interrupt_TRAPA(uint32_t vector)
 void MCU_Interrupt_StartVector(uint32_t vector, int32_t mask)
 {
     uint32_t address = MCU_GetVectorAddress(vector);
+    if (trace_enabled)
+        TRACE_Instant("interrupt", "vector", vector);
     MCU_Interrupt_Start(mask);
     mcu.cp = address >> 16;
     mcu.pc = address;
 }
 
+// Vector and priority level of a pending interrupt source, -1 if it is
+// disabled
+static int32_t MCU_Interrupt_Source(uint32_t source, int32_t *vector)
+{
+    int32_t level = 0;
+    *vector = -1;
+    switch (source)
+    {
+        case INTERRUPT_SOURCE_IRQ0:
+            if ((dev_register[DEV_P1CR] & 0x20) == 0)
+                return -1;
+            *vector = VECTOR_IRQ0;
+            level = (dev_register[DEV_IPRA] >> 4) & 7;
+            break;
+        case INTERRUPT_SOURCE_IRQ1:
+            if ((dev_register[DEV_P1CR] & 0x40) == 0)
+                return -1;
+            *vector = VECTOR_IRQ1;
+            level = (dev_register[DEV_IPRA] >> 0) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT0_OCIA:
+            *vector = VECTOR_INTERNAL_INTERRUPT_94;
+            level = (dev_register[DEV_IPRB] >> 4) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT0_OCIB:
+            *vector = VECTOR_INTERNAL_INTERRUPT_98;
+            level = (dev_register[DEV_IPRB] >> 4) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT0_FOVI:
+            *vector = VECTOR_INTERNAL_INTERRUPT_9C;
+            level = (dev_register[DEV_IPRB] >> 4) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT1_OCIA:
+            *vector = VECTOR_INTERNAL_INTERRUPT_A4;
+            level = (dev_register[DEV_IPRB] >> 0) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT1_OCIB:
+            *vector = VECTOR_INTERNAL_INTERRUPT_A8;
+            level = (dev_register[DEV_IPRB] >> 0) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT1_FOVI:
+            *vector = VECTOR_INTERNAL_INTERRUPT_AC;
+            level = (dev_register[DEV_IPRB] >> 0) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT2_OCIA:
+            *vector = VECTOR_INTERNAL_INTERRUPT_B4;
+            level = (dev_register[DEV_IPRC] >> 4) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT2_OCIB:
+            *vector = VECTOR_INTERNAL_INTERRUPT_B8;
+            level = (dev_register[DEV_IPRC] >> 4) & 7;
+            break;
+        case INTERRUPT_SOURCE_FRT2_FOVI:
+            *vector = VECTOR_INTERNAL_INTERRUPT_BC;
+            level = (dev_register[DEV_IPRC] >> 4) & 7;
+            break;
+        case INTERRUPT_SOURCE_TIMER_CMIA:
+            *vector = VECTOR_INTERNAL_INTERRUPT_C0;
+            level = (dev_register[DEV_IPRC] >> 0) & 7;
+            break;
+        case INTERRUPT_SOURCE_TIMER_CMIB:
+            *vector = VECTOR_INTERNAL_INTERRUPT_C4;
+            level = (dev_register[DEV_IPRC] >> 0) & 7;
+            break;
+        case INTERRUPT_SOURCE_TIMER_OVI:
+            *vector = VECTOR_INTERNAL_INTERRUPT_C8;
+            level = (dev_register[DEV_IPRC] >> 0) & 7;
+            break;
+        case INTERRUPT_SOURCE_ANALOG:
+            *vector = VECTOR_INTERNAL_INTERRUPT_E0;
+            level = (dev_register[DEV_IPRD] >> 0) & 7;
+            break;
+        case INTERRUPT_SOURCE_UART_RX:
+            *vector = VECTOR_INTERNAL_INTERRUPT_D4;
+            level = (dev_register[DEV_IPRD] >> 4) & 7;
+            break;
+        case INTERRUPT_SOURCE_UART_TX:
+            *vector = VECTOR_INTERNAL_INTERRUPT_D8;
+            level = (dev_register[DEV_IPRD] >> 4) & 7;
+            break;
+        default:
+            break;
+    }
+    return level;
+}
+
 void MCU_Interrupt_Handle(void)
 {
 #if 0
@@ -112,9 +201,11 @@ void MCU_Interrupt_Handle(void)
         switch (mcu.exception_pending)
         {
             case EXCEPTION_SOURCE_ADDRESS_ERROR:
+                MCU_ITraceFault("address error");
                 MCU_Interrupt_StartVector(VECTOR_ADDRESS_ERROR, -1);
                 break;
             case EXCEPTION_SOURCE_INVALID_INSTRUCTION:
+                MCU_ITraceFault("invalid instruction");
                 MCU_Interrupt_StartVector(VECTOR_INVALID_INSTRUCTION, -1);
                 break;
             case EXCEPTION_SOURCE_TRACE:
@@ -134,87 +225,10 @@ void MCU_Interrupt_Handle(void)
     uint32_t mask = (mcu.sr >> 8) & 7;
     for (i = INTERRUPT_SOURCE_NMI + 1; i < INTERRUPT_SOURCE_MAX; i++)
     {
-        int32_t vector = -1;
-        int32_t level = 0;
+        int32_t vector;
         if (!mcu.interrupt_pending[i])
             continue;
-        switch (i)
-        {
-            case INTERRUPT_SOURCE_IRQ0:
-                if ((dev_register[DEV_P1CR] & 0x20) == 0)
-                    continue;
-                vector = VECTOR_IRQ0;
-                level = (dev_register[DEV_IPRA] >> 4) & 7;
-                break;
-            case INTERRUPT_SOURCE_IRQ1:
-                if ((dev_register[DEV_P1CR] & 0x40) == 0)
-                    continue;
-                vector = VECTOR_IRQ1;
-                level = (dev_register[DEV_IPRA] >> 0) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT0_OCIA:
-                vector = VECTOR_INTERNAL_INTERRUPT_94;
-                level = (dev_register[DEV_IPRB] >> 4) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT0_OCIB:
-                vector = VECTOR_INTERNAL_INTERRUPT_98;
-                level = (dev_register[DEV_IPRB] >> 4) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT0_FOVI:
-                vector = VECTOR_INTERNAL_INTERRUPT_9C;
-                level = (dev_register[DEV_IPRB] >> 4) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT1_OCIA:
-                vector = VECTOR_INTERNAL_INTERRUPT_A4;
-                level = (dev_register[DEV_IPRB] >> 0) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT1_OCIB:
-                vector = VECTOR_INTERNAL_INTERRUPT_A8;
-                level = (dev_register[DEV_IPRB] >> 0) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT1_FOVI:
-                vector = VECTOR_INTERNAL_INTERRUPT_AC;
-                level = (dev_register[DEV_IPRB] >> 0) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT2_OCIA:
-                vector = VECTOR_INTERNAL_INTERRUPT_B4;
-                level = (dev_register[DEV_IPRC] >> 4) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT2_OCIB:
-                vector = VECTOR_INTERNAL_INTERRUPT_B8;
-                level = (dev_register[DEV_IPRC] >> 4) & 7;
-                break;
-            case INTERRUPT_SOURCE_FRT2_FOVI:
-                vector = VECTOR_INTERNAL_INTERRUPT_BC;
-                level = (dev_register[DEV_IPRC] >> 4) & 7;
-                break;
-            case INTERRUPT_SOURCE_TIMER_CMIA:
-                vector = VECTOR_INTERNAL_INTERRUPT_C0;
-                level = (dev_register[DEV_IPRC] >> 0) & 7;
-                break;
-            case INTERRUPT_SOURCE_TIMER_CMIB:
-                vector = VECTOR_INTERNAL_INTERRUPT_C4;
-                level = (dev_register[DEV_IPRC] >> 0) & 7;
-                break;
-            case INTERRUPT_SOURCE_TIMER_OVI:
-                vector = VECTOR_INTERNAL_INTERRUPT_C8;
-                level = (dev_register[DEV_IPRC] >> 0) & 7;
-                break;
-            case INTERRUPT_SOURCE_ANALOG:
-                vector = VECTOR_INTERNAL_INTERRUPT_E0;
-                level = (dev_register[DEV_IPRD] >> 0) & 7;
-                break;
-            case INTERRUPT_SOURCE_UART_RX:
-                vector = VECTOR_INTERNAL_INTERRUPT_D4;
-                level = (dev_register[DEV_IPRD] >> 4) & 7;
-                break;
-            case INTERRUPT_SOURCE_UART_TX:
-                vector = VECTOR_INTERNAL_INTERRUPT_D8;
-                level = (dev_register[DEV_IPRD] >> 4) & 7;
-                break;
-            default:
-                break;
-        }
+        int32_t level = MCU_Interrupt_Source(i, &vector);
 
         if ((int32_t)mask < level)
         {
@@ -224,3 +238,29 @@ void MCU_Interrupt_Handle(void)
         }
     }
 }
+
+// Whether MCU_Interrupt_Handle would start an exception or interrupt now,
+// without taking it
+int MCU_Interrupt_Taken(void)
+{
+    uint32_t i;
+    for (i = 0; i < 16; i++)
+    {
+        if (mcu.trapa_pending[i])
+            return 1;
+    }
+    if (mcu.exception_pending >= 0)
+        return 1;
+    if (mcu.interrupt_pending[INTERRUPT_SOURCE_NMI])
+        return 1;
+    uint32_t mask = (mcu.sr >> 8) & 7;
+    for (i = INTERRUPT_SOURCE_NMI + 1; i < INTERRUPT_SOURCE_MAX; i++)
+    {
+        int32_t vector;
+        if (!mcu.interrupt_pending[i])
+            continue;
+        if ((int32_t)mask < MCU_Interrupt_Source(i, &vector))
+            return 1;
+    }
+    return 0;
+}
@@ -39,6 +39,7 @@ void MCU_Interrupt_SetRequest(uint32_t interrupt, uint32_t value);
 void MCU_Interrupt_Exception(uint32_t exception);
 void MCU_Interrupt_TRAPA(uint32_t vector);
 void MCU_Interrupt_Handle(void);
+int MCU_Interrupt_Taken(void); // Handle would start a vector
 
 enum {
     INTERRUPT_SOURCE_NMI = 0,
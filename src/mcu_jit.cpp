@@ -0,0 +1,635 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <stddef.h>
+#include <unordered_map>
+#include "mcu.h"
+#include "mcu_opcodes.h"
+#include "mcu_jit.h"
+
+int mcu_jit = 0;
+int (*mcu_jit_tail)(void);
+
+#ifdef MCU_JIT_SUPPORTED
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+static const uint32_t jit_code_size = 16 * 1024 * 1024;
+static const uint32_t jit_data_size = 4 * 1024 * 1024;
+static const uint32_t jit_block_max = 32; // instructions
+static const uint32_t jit_block_code = 4096; // worst case code of a block
+static const uint32_t jit_block_data = 2048;
+
+enum {
+    JIT_EA_STATIC = 0, // direct and immediate, the operand is fixed
+    JIT_EA_INDIRECT,
+    JIT_EA_ABS8,
+    JIT_EA_ABS16
+};
+
+// general format instruction with its effective address decoded as far as
+// it doesn't depend on registers
+struct jit_general_t {
+    mcu_opcode_handler_t handler;
+    mcu_operand_t op;
+    uint8_t opcode;
+    uint8_t opcode_reg;
+    uint8_t mode;
+    uint8_t increase;
+    uint16_t disp; // or the absolute address
+};
+
+static uint8_t *jit_code;
+static uint32_t jit_code_used;
+static uint32_t jit_code_start; // past the trampolines
+static uint8_t *jit_data;
+static uint32_t jit_data_used;
+static bool jit_flush_pending;
+static std::unordered_map<uint32_t, uint8_t *> jit_blocks; // cp << 16 | pc
+
+static uint8_t *jit_ptr;
+static uint8_t *jit_exit;
+static uint8_t *jit_lookup;
+static void (*jit_entry)(uint8_t *code);
+
+static uint8_t jit_cp;
+static uint32_t jit_limit; // end of the ROM window the block is in
+static bool jit_outside;
+
+// x86-64 encoding. rbx holds &mcu in translated code.
+
+static void JIT_Byte(uint8_t b)
+{
+    *jit_ptr++ = b;
+}
+
+static void JIT_U16(uint16_t v)
+{
+    memcpy(jit_ptr, &v, 2);
+    jit_ptr += 2;
+}
+
+static void JIT_U32(uint32_t v)
+{
+    memcpy(jit_ptr, &v, 4);
+    jit_ptr += 4;
+}
+
+static void JIT_U64(uint64_t v)
+{
+    memcpy(jit_ptr, &v, 8);
+    jit_ptr += 8;
+}
+
+template<class T>
+static uint64_t JIT_Address(T p)
+{
+    return (uint64_t)reinterpret_cast<uintptr_t>(p);
+}
+
+// mov r64, imm64
+static void JIT_MovAbs(uint8_t reg, uint64_t v)
+{
+    JIT_Byte(0x48);
+    JIT_Byte(0xb8 + reg);
+    JIT_U64(v);
+}
+
+// mov r32, imm32
+static void JIT_MovImm(uint8_t reg, uint32_t v)
+{
+    JIT_Byte(0xb8 + reg);
+    JIT_U32(v);
+}
+
+enum {
+    JIT_RAX = 0,
+    JIT_RDX = 2,
+    JIT_RSI = 6,
+    JIT_RDI = 7
+};
+
+static void JIT_Call(uint64_t f)
+{
+    JIT_MovAbs(JIT_RAX, f);
+    JIT_Byte(0xff); // call rax
+    JIT_Byte(0xd0);
+}
+
+static void JIT_Patch(uint8_t *rel, uint8_t *target)
+{
+    int32_t disp = (int32_t)(target - (rel + 4));
+    memcpy(rel, &disp, 4);
+}
+
+// jmp/jcc rel32, returns the displacement to patch
+static uint8_t *JIT_Jump(uint8_t cc, uint8_t *target)
+{
+    if (cc)
+    {
+        JIT_Byte(0x0f);
+        JIT_Byte(cc);
+    }
+    else
+        JIT_Byte(0xe9);
+    uint8_t *rel = jit_ptr;
+    JIT_U32(0);
+    if (target)
+        JIT_Patch(rel, target);
+    return rel;
+}
+
+static const uint8_t JIT_JE = 0x84;
+static const uint8_t JIT_JNE = 0x85;
+
+// mov word [rbx + pc], imm16
+static void JIT_SetPC(uint16_t pc)
+{
+    JIT_Byte(0x66);
+    JIT_Byte(0xc7);
+    JIT_Byte(0x83);
+    JIT_U32(offsetof(mcu_t, pc));
+    JIT_U16(pc);
+}
+
+// cmp word [rbx + pc], imm16
+static void JIT_CmpPC(uint16_t pc)
+{
+    JIT_Byte(0x66);
+    JIT_Byte(0x81);
+    JIT_Byte(0xbb);
+    JIT_U32(offsetof(mcu_t, pc));
+    JIT_U16(pc);
+}
+
+// rest of the step, leaves when the tail says so
+static void JIT_Tail(void)
+{
+    JIT_MovAbs(JIT_RAX, JIT_Address(&mcu_jit_tail));
+    JIT_Byte(0xff); // call [rax]
+    JIT_Byte(0x10);
+    JIT_Byte(0x85); // test eax, eax
+    JIT_Byte(0xc0);
+    JIT_Jump(JIT_JNE, jit_exit);
+}
+
+static void *JIT_Alloc(uint32_t size)
+{
+    void *p = jit_data + jit_data_used;
+    jit_data_used += (size + 15) & ~15u;
+    return p;
+}
+
+static bool MCU_JIT_IsROM(uint8_t cp, uint16_t pc)
+{
+    switch (cp & 0xf)
+    {
+    case 0:
+        return pc < 0x8000;
+    case 1:
+    case 2:
+    case 3:
+    case 4:
+        return true;
+    case 8:
+    case 9:
+    case 14:
+    case 15:
+        return !mcu_jv880;
+    }
+    return false;
+}
+
+static uint8_t JIT_Code(uint32_t pc)
+{
+    if (pc >= jit_limit)
+    {
+        jit_outside = true;
+        return 0;
+    }
+    return MCU_Read(MCU_GetAddress(jit_cp, (uint16_t)pc));
+}
+
+// Mirrors MCU_Operand_Decode, returns the instruction length
+static uint32_t MCU_JIT_Decode(uint32_t pc, uint8_t operand, jit_general_t *g)
+{
+    uint32_t p = pc + 1;
+    uint32_t siz = (operand & 0x08) != 0;
+    uint32_t reg = operand & 0x07;
+
+    memset(g, 0, sizeof(*g));
+    g->op.type = GENERAL_DIRECT;
+    g->mode = JIT_EA_STATIC;
+    switch (operand & 0xf0)
+    {
+    case 0xa0:
+        break;
+    case 0xd0:
+        g->mode = JIT_EA_INDIRECT;
+        break;
+    case 0xe0:
+        g->mode = JIT_EA_INDIRECT;
+        g->disp = (uint16_t)(int8_t)JIT_Code(p++);
+        break;
+    case 0xf0:
+        g->mode = JIT_EA_INDIRECT;
+        g->disp = JIT_Code(p++) << 8;
+        g->disp |= JIT_Code(p++);
+        break;
+    case 0xb0:
+        g->mode = JIT_EA_INDIRECT;
+        g->increase = INCREASE_DECREASE;
+        break;
+    case 0xc0:
+        g->mode = JIT_EA_INDIRECT;
+        g->increase = INCREASE_INCREASE;
+        break;
+    case 0x00:
+        if (reg == 5)
+        {
+            g->mode = JIT_EA_ABS8;
+            g->disp = JIT_Code(p++);
+        }
+        else if (reg == 4)
+        {
+            g->op.type = GENERAL_IMMEDIATE;
+            g->op.data = JIT_Code(p++);
+            if (siz)
+            {
+                g->op.data <<= 8;
+                g->op.data |= JIT_Code(p++);
+            }
+        }
+        break;
+    case 0x10:
+        if (reg == 5)
+        {
+            g->mode = JIT_EA_ABS16;
+            g->disp = JIT_Code(p++) << 8;
+            g->disp |= JIT_Code(p++);
+        }
+        break;
+    }
+    if (g->mode == JIT_EA_INDIRECT)
+        g->op.type = GENERAL_INDIRECT;
+    else if (g->mode != JIT_EA_STATIC)
+        g->op.type = GENERAL_ABSOLUTE;
+
+    uint8_t opcode = JIT_Code(p++);
+    g->op.extended = opcode == 0x00;
+    if (g->op.extended)
+        opcode = JIT_Code(p++);
+    g->op.size = siz;
+    g->op.reg = reg;
+
+    g->opcode = opcode >> 3;
+    g->opcode_reg = opcode & 0x07;
+#ifdef MCU_THREADED_DISPATCH
+    g->handler = mcu_opcode_specialized(g->opcode, g->op.type, g->op.size);
+#else
+    g->handler = MCU_Opcode_Table[g->opcode];
+#endif
+
+    return p - pc + MCU_Opcode_Length(g->opcode, g->opcode_reg, &g->op);
+}
+
+// effective address part that depends on registers, then the handler
+static void MCU_JIT_General(const jit_general_t *g)
+{
+    mcu_operand_t op = g->op;
+    uint32_t reg = op.reg;
+    switch (g->mode)
+    {
+    case JIT_EA_INDIRECT:
+        if (g->increase == INCREASE_DECREASE)
+            mcu.r[reg] -= (op.size || reg == 7) ? 2 : 1;
+        op.ea = mcu.r[reg] + g->disp;
+        if (g->increase == INCREASE_INCREASE)
+            mcu.r[reg] += (op.size || reg == 7) ? 2 : 1;
+        op.ep = MCU_GetPageForRegister(reg) & 0xff;
+        break;
+    case JIT_EA_ABS8:
+        op.ea = (mcu.br << 8) | g->disp;
+        break;
+    case JIT_EA_ABS16:
+        op.ea = g->disp;
+        op.ep = mcu.dp;
+        break;
+    }
+    g->handler(g->opcode, g->opcode_reg, &op);
+}
+
+// Jump to the block at pc through a slot, which first points at a stub
+// that looks the block up and patches the slot.
+static void JIT_Chain(uint8_t **slot)
+{
+    JIT_MovAbs(JIT_RAX, JIT_Address(slot));
+    JIT_Byte(0xff); // jmp [rax]
+    JIT_Byte(0x20);
+}
+
+static uint8_t *MCU_JIT_Find(uint8_t cp, uint16_t pc);
+
+static uint8_t *MCU_JIT_Lookup(void)
+{
+    return MCU_JIT_Find(mcu.cp, mcu.pc);
+}
+
+static uint8_t *MCU_JIT_Link(uint8_t **slot)
+{
+    uint8_t *code = MCU_JIT_Find(mcu.cp, mcu.pc);
+    if (code)
+        *slot = code;
+    return code;
+}
+
+static void JIT_LinkStub(uint8_t **slot)
+{
+    *slot = jit_ptr;
+    JIT_MovAbs(JIT_RDI, JIT_Address(slot));
+    JIT_Call(JIT_Address(MCU_JIT_Link));
+    JIT_Byte(0x48); // test rax, rax
+    JIT_Byte(0x85);
+    JIT_Byte(0xc0);
+    JIT_Jump(JIT_JE, jit_exit);
+    JIT_Byte(0xff); // jmp rax
+    JIT_Byte(0xe0);
+}
+
+// The code cache is never writable and executable at once (W^X): the pages
+// a block goes to are made writable while it's emitted and executable again
+// before anything runs. Chain slots live in jit_data, linking doesn't write
+// code.
+static bool JIT_Protect(uint32_t start, uint32_t end, int prot)
+{
+    static uint32_t page;
+    if (!page)
+        page = (uint32_t)sysconf(_SC_PAGESIZE);
+    start &= ~(page - 1);
+    end = (end + page - 1) & ~(page - 1);
+    if (end > jit_code_size)
+        end = jit_code_size;
+    return mprotect(jit_code + start, end - start, prot) == 0;
+}
+
+static uint8_t *MCU_JIT_Emit(uint8_t cp, uint16_t pc)
+{
+    jit_cp = cp;
+    jit_limit = (cp & 0xf) == 0 ? 0x8000 : 0x10000;
+    jit_ptr = jit_code + jit_code_used;
+    uint8_t *block = jit_ptr;
+
+    uint32_t ipc = pc;
+    uint32_t count;
+    bool fallthrough = true;
+    for (count = 0; count < jit_block_max; count++)
+    {
+        jit_outside = false;
+        uint8_t operand = JIT_Code(ipc);
+        if (jit_outside)
+            break;
+
+        int length;
+        int cls = MCU_Operand_Class(operand, &length);
+        jit_general_t g;
+        if (cls == MCU_OPERAND_CLASS_GENERAL)
+            length = MCU_JIT_Decode(ipc, operand, &g);
+        if (cls != MCU_OPERAND_CLASS_OTHER && ipc + length > jit_limit)
+            jit_outside = true;
+        if (jit_outside)
+            break;
+
+        if (cls == MCU_OPERAND_CLASS_GENERAL)
+        {
+            // pc after the operand and opcode bytes, MOVG reads the rest
+            uint32_t fetched = length - MCU_Opcode_Length(g.opcode, g.opcode_reg, &g.op);
+            JIT_SetPC((uint16_t)(ipc + fetched));
+            jit_general_t *gp = (jit_general_t*)JIT_Alloc(sizeof(jit_general_t));
+            *gp = g;
+            if (g.mode == JIT_EA_STATIC)
+            {
+                JIT_MovImm(JIT_RDI, g.opcode);
+                JIT_MovImm(JIT_RSI, g.opcode_reg);
+                JIT_MovAbs(JIT_RDX, JIT_Address(&gp->op));
+                JIT_Call(JIT_Address(g.handler));
+            }
+            else
+            {
+                JIT_MovAbs(JIT_RDI, JIT_Address(gp));
+                JIT_Call(JIT_Address(MCU_JIT_General));
+            }
+        }
+        else
+        {
+            JIT_SetPC((uint16_t)(ipc + 1));
+            JIT_MovImm(JIT_RDI, operand);
+            JIT_Call(JIT_Address(MCU_Operand_Table[operand]));
+        }
+        JIT_Tail();
+
+        if (cls == MCU_OPERAND_CLASS_OTHER)
+        {
+            JIT_Jump(0, jit_lookup);
+            count++;
+            fallthrough = false;
+            break;
+        }
+
+        uint16_t next = (uint16_t)(ipc + length);
+        if (cls == MCU_OPERAND_CLASS_BRANCH)
+        {
+            uint16_t disp;
+            if (operand & 0x10)
+                disp = (JIT_Code(ipc + 1) << 8) | JIT_Code(ipc + 2);
+            else
+                disp = (uint16_t)(int8_t)JIT_Code(ipc + 1);
+            uint16_t target = next + disp;
+
+            uint8_t **slots = (uint8_t**)JIT_Alloc(2 * sizeof(uint8_t*));
+            JIT_CmpPC(target);
+            uint8_t *not_taken = JIT_Jump(JIT_JNE, NULL);
+            JIT_Chain(&slots[0]);
+            JIT_Patch(not_taken, jit_ptr);
+            JIT_CmpPC(next);
+            JIT_Jump(JIT_JNE, jit_lookup);
+            JIT_Chain(&slots[1]);
+            JIT_LinkStub(&slots[0]);
+            JIT_LinkStub(&slots[1]);
+            count++;
+            fallthrough = false;
+            break;
+        }
+
+        JIT_CmpPC(next);
+        JIT_Jump(JIT_JNE, jit_lookup);
+        ipc = ipc + length;
+    }
+
+    if (count == 0)
+        return NULL;
+
+    if (fallthrough)
+    {
+        // block ended early, continue with the next one
+        uint8_t **slot = (uint8_t**)JIT_Alloc(sizeof(uint8_t*));
+        JIT_Chain(slot);
+        JIT_LinkStub(slot);
+    }
+
+    jit_code_used = (uint32_t)(jit_ptr - jit_code + 15) & ~15u;
+    jit_blocks[((uint32_t)cp << 16) | pc] = block;
+    return block;
+}
+
+static uint8_t *MCU_JIT_Compile(uint8_t cp, uint16_t pc)
+{
+    if (jit_code_used + jit_block_code > jit_code_size
+        || jit_data_used + jit_block_data > jit_data_size)
+    {
+        jit_flush_pending = true;
+        return NULL;
+    }
+
+    uint32_t start = jit_code_used;
+    if (!JIT_Protect(start, start + jit_block_code, PROT_READ | PROT_WRITE))
+        return NULL;
+    uint8_t *block = MCU_JIT_Emit(cp, pc);
+    if (!JIT_Protect(start, start + jit_block_code, PROT_READ | PROT_EXEC))
+    {
+        fprintf(stderr, "FATAL: can't make -jit code executable\n");
+        exit(1);
+    }
+    return block;
+}
+
+static uint8_t *MCU_JIT_Find(uint8_t cp, uint16_t pc)
+{
+    if (!MCU_JIT_IsROM(cp, pc))
+        return NULL;
+    std::unordered_map<uint32_t, uint8_t *>::iterator it = jit_blocks.find(((uint32_t)cp << 16) | pc);
+    if (it != jit_blocks.end())
+        return it->second;
+    return MCU_JIT_Compile(cp, pc);
+}
+
+int MCU_JIT_Init(void)
+{
+    if (jit_code)
+    {
+        MCU_JIT_Flush();
+        return 1;
+    }
+    void *code = mmap(NULL, jit_code_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (code == MAP_FAILED)
+    {
+        fprintf(stderr, "FATAL: can't allocate executable memory for -jit\n");
+        return 0;
+    }
+    jit_code = (uint8_t*)code;
+    jit_data = new uint8_t[jit_data_size];
+
+    // entry: push rbx; mov rbx, &mcu; jmp rdi
+    jit_ptr = jit_code;
+    jit_entry = reinterpret_cast<void (*)(uint8_t *)>(jit_ptr);
+    JIT_Byte(0x53);
+    JIT_MovAbs(3, JIT_Address(&mcu));
+    JIT_Byte(0xff);
+    JIT_Byte(0xe7);
+
+    // exit: pop rbx; ret
+    jit_exit = jit_ptr;
+    JIT_Byte(0x5b);
+    JIT_Byte(0xc3);
+
+    // lookup: continue at mcu.pc or leave
+    jit_lookup = jit_ptr;
+    JIT_Call(JIT_Address(MCU_JIT_Lookup));
+    JIT_Byte(0x48); // test rax, rax
+    JIT_Byte(0x85);
+    JIT_Byte(0xc0);
+    JIT_Jump(JIT_JE, jit_exit);
+    JIT_Byte(0xff); // jmp rax
+    JIT_Byte(0xe0);
+
+    jit_code_start = (uint32_t)(jit_ptr - jit_code + 15) & ~15u;
+    if (!JIT_Protect(0, jit_code_size, PROT_READ | PROT_EXEC))
+    {
+        fprintf(stderr, "FATAL: can't make -jit code executable\n");
+        return 0;
+    }
+    MCU_JIT_Flush();
+    return 1;
+}
+
+void MCU_JIT_Flush(void)
+{
+    jit_blocks.clear();
+    jit_code_used = jit_code_start;
+    jit_data_used = 0;
+    jit_flush_pending = false;
+}
+
+int MCU_JIT_Run(void)
+{
+    if (!jit_code)
+        return 0;
+    if (jit_flush_pending)
+        MCU_JIT_Flush();
+    uint8_t *code = MCU_JIT_Find(mcu.cp, mcu.pc);
+    if (!code)
+        return 0;
+    jit_entry(code);
+    return 1;
+}
+
+#else
+
+int MCU_JIT_Init(void)
+{
+    fprintf(stderr, "FATAL: -jit isn't supported on this platform\n");
+    return 0;
+}
+
+void MCU_JIT_Flush(void)
+{
+}
+
+int MCU_JIT_Run(void)
+{
+    return 0;
+}
+
+#endif
@@ -136,56 +136,43 @@ int32_t MCU_ADD_Common(int32_t t1, int32_t t2, int32_t c_bit, uint32_t siz)
     return t1;
 }
 
+template<class model>
 void MCU_Operand_Nop(uint8_t operand)
 {
 }
 
+template<class model>
 void MCU_Operand_Sleep(uint8_t operand)
 {
     mcu.sleep = 1;
 }
 
+template<class model>
 void MCU_Operand_NotImplemented(uint8_t operand)
 {
     MCU_ErrorTrap();
 }
 
-enum {
-    GENERAL_DIRECT = 0,
-    GENERAL_INDIRECT,
-    GENERAL_ABSOLUTE,
-    GENERAL_IMMEDIATE
-};
-
-enum {
-    OPERAND_BYTE = 0,
-    OPERAND_WORD
-};
-
-enum {
-    INCREASE_NONE = 0,
-    INCREASE_DECREASE,
-    INCREASE_INCREASE
-};
-
+template<class model>
 void MCU_LDM(uint8_t operand)
 {
-    uint8_t rlist = MCU_ReadCodeAdvance();
+    uint8_t rlist = MCU_ReadCodeAdvance<model>();
     int32_t i;
     for (i = 0; i < 8; i++)
     {
         if (rlist & (1 << i))
         {
-            uint16_t data = MCU_PopStack();
+            uint16_t data = MCU_PopStack<model>();
             if (i != 7)
                 mcu.r[i] = data;
         }
     }
 }
 
+template<class model>
 void MCU_STM(uint8_t operand)
 {
-    uint8_t rlist = MCU_ReadCodeAdvance();
+    uint8_t rlist = MCU_ReadCodeAdvance<model>();
     int32_t i;
     for (i = 7; i >= 0; i--)
     {
@@ -194,14 +181,15 @@ void MCU_STM(uint8_t operand)
             uint16_t data = mcu.r[i];
             if (i == 7)
                 data -= 2;
-            MCU_PushStack(data);
+            MCU_PushStack<model>(data);
         }
     }
 }
 
+template<class model>
 void MCU_TRAPA(uint8_t operand)
 {
-    uint32_t opcode = MCU_ReadCodeAdvance();
+    uint32_t opcode = MCU_ReadCodeAdvance<model>();
     if ((opcode & 0xf0) == 0x10)
     {
         MCU_Interrupt_TRAPA(opcode & 0x0f);
@@ -212,39 +200,43 @@ void MCU_TRAPA(uint8_t operand)
     }
 }
 
+template<class model>
 void MCU_Jump_PJSR(uint8_t operand)
 {
     uint32_t ocp = mcu.cp;
     uint32_t opc = mcu.pc;
-    uint8_t page = MCU_ReadCodeAdvance();
+    uint8_t page = MCU_ReadCodeAdvance<model>();
     uint16_t address;
-    address = MCU_ReadCodeAdvance() << 8;
-    address |= MCU_ReadCodeAdvance();
-    MCU_PushStack(mcu.pc);
-    MCU_PushStack(mcu.cp);
+    address = MCU_ReadCodeAdvance<model>() << 8;
+    address |= MCU_ReadCodeAdvance<model>();
+    MCU_PushStack<model>(mcu.pc);
+    MCU_PushStack<model>(mcu.cp);
     mcu.cp = page;
     if (mcu.cp == 0x27)
         mcu.cp += 0;
     mcu.pc = address;
 }
 
+template<class model>
 void MCU_Jump_JSR(uint8_t operand)
 {
     uint16_t address;
-    address = MCU_ReadCodeAdvance() << 8;
-    address |= MCU_ReadCodeAdvance();
-    MCU_PushStack(mcu.pc);
+    address = MCU_ReadCodeAdvance<model>() << 8;
+    address |= MCU_ReadCodeAdvance<model>();
+    MCU_PushStack<model>(mcu.pc);
     mcu.pc = address;
 }
 
+template<class model>
 void MCU_Jump_RTE(uint8_t operand)
 {
-    mcu.sr = MCU_PopStack();
-    mcu.cp = (uint8_t)MCU_PopStack();
-    mcu.pc = MCU_PopStack();
+    mcu.sr = MCU_PopStack<model>();
+    mcu.cp = (uint8_t)MCU_PopStack<model>();
+    mcu.pc = MCU_PopStack<model>();
     mcu.ex_ignore = 1;
 }   
 
+template<class model>
 void MCU_Jump_Bcc(uint8_t operand)
 {
     uint16_t disp;
@@ -253,12 +245,12 @@ void MCU_Jump_Bcc(uint8_t operand)
     uint32_t N, C, Z, V;
     if (operand & 0x10)
     {
-        disp = MCU_ReadCodeAdvance() << 8;
-        disp |= MCU_ReadCodeAdvance();
+        disp = MCU_ReadCodeAdvance<model>() << 8;
+        disp |= MCU_ReadCodeAdvance<model>();
     }
     else
     {
-        disp = (int8_t)MCU_ReadCodeAdvance();
+        disp = (int8_t)MCU_ReadCodeAdvance<model>();
     }
     cond = operand & 0x0f;
 
@@ -325,15 +317,17 @@ void MCU_Jump_Bcc(uint8_t operand)
     }
 }
 
+template<class model>
 void MCU_Jump_RTS(uint8_t operand)
 {
-    mcu.pc = MCU_PopStack();
+    mcu.pc = MCU_PopStack<model>();
 }
 
+template<class model>
 void MCU_Jump_RTD(uint8_t operand)
 {
-    int16_t imm = (int8_t)MCU_ReadCodeAdvance();
-    mcu.pc = MCU_PopStack();
+    int16_t imm = (int8_t)MCU_ReadCodeAdvance<model>();
+    mcu.pc = MCU_PopStack<model>();
 
     if (operand == 0x14)
     {
@@ -352,22 +346,23 @@ void MCU_Jump_RTD(uint8_t operand)
     }
 }
 
+template<class model>
 void MCU_Jump_JMP(uint8_t operand)
 {
     if (operand == 0x11)
     {
-        uint8_t opcode = MCU_ReadCodeAdvance();
+        uint8_t opcode = MCU_ReadCodeAdvance<model>();
         uint8_t opcode_h = opcode >> 3;
         uint8_t opcode_l = opcode & 0x07;
         if (opcode == 0x19)
         {
-            mcu.cp = (uint8_t)MCU_PopStack();
-            mcu.pc = MCU_PopStack();
+            mcu.cp = (uint8_t)MCU_PopStack<model>();
+            mcu.pc = MCU_PopStack<model>();
         }
         else if (opcode_h == 0x19)
         {
-            MCU_PushStack(mcu.pc);
-            MCU_PushStack(mcu.cp);
+            MCU_PushStack<model>(mcu.pc);
+            MCU_PushStack<model>(mcu.cp);
             opcode_l &= ~1;
             mcu.cp = mcu.r[opcode_l] & 0xff;
             mcu.pc = mcu.r[opcode_l + 1];
@@ -378,7 +373,7 @@ void MCU_Jump_JMP(uint8_t operand)
         }
         else if (opcode_h == 0x1b)
         {
-            MCU_PushStack(mcu.pc);
+            MCU_PushStack<model>(mcu.pc);
             mcu.pc = mcu.r[opcode_l];
         }
         else
@@ -388,12 +383,12 @@ void MCU_Jump_JMP(uint8_t operand)
     }
     else if (operand == 0x01)
     {
-        uint8_t opcode = MCU_ReadCodeAdvance();
+        uint8_t opcode = MCU_ReadCodeAdvance<model>();
         uint8_t reg = opcode & 0x07;
         opcode >>= 3;
         if (opcode == 0x17)
         {
-            uint16_t disp = (int8_t)MCU_ReadCodeAdvance();
+            uint16_t disp = (int8_t)MCU_ReadCodeAdvance<model>();
             mcu.r[reg]--;
             if (mcu.r[reg] != 0xffff)
             {
@@ -408,18 +403,18 @@ void MCU_Jump_JMP(uint8_t operand)
     else if (operand == 0x10)
     {
         uint32_t addr;
-        addr = MCU_ReadCodeAdvance() << 8;
-        addr |= MCU_ReadCodeAdvance();
+        addr = MCU_ReadCodeAdvance<model>() << 8;
+        addr |= MCU_ReadCodeAdvance<model>();
         mcu.pc = addr;
     }
     else if (operand == 0x06)
     {
-        uint8_t opcode = MCU_ReadCodeAdvance();
+        uint8_t opcode = MCU_ReadCodeAdvance<model>();
         uint8_t reg = opcode & 0x07;
         opcode >>= 3;
         if (opcode == 0x17)
         {
-            uint16_t disp = (int8_t)MCU_ReadCodeAdvance();
+            uint16_t disp = (int8_t)MCU_ReadCodeAdvance<model>();
             uint32_t Z = (mcu.sr & STATUS_Z) != 0;
             if (Z)
             {
@@ -437,12 +432,12 @@ void MCU_Jump_JMP(uint8_t operand)
     }
     else if (operand == 0x07)
     {
-        uint8_t opcode = MCU_ReadCodeAdvance();
+        uint8_t opcode = MCU_ReadCodeAdvance<model>();
         uint8_t reg = opcode & 0x07;
         opcode >>= 3;
         if (opcode == 0x17)
         {
-            uint16_t disp = (int8_t)MCU_ReadCodeAdvance();
+            uint16_t disp = (int8_t)MCU_ReadCodeAdvance<model>();
             uint32_t Z = (mcu.sr & STATUS_Z) != 0;
             if (!Z)
             {
@@ -464,92 +459,87 @@ void MCU_Jump_JMP(uint8_t operand)
     }
 }
 
+template<class model>
 void MCU_Jump_BSR(uint8_t operand)
 {
     uint16_t disp;
     if (operand == 0x0e)
     {
-        disp = (int8_t)MCU_ReadCodeAdvance();
+        disp = (int8_t)MCU_ReadCodeAdvance<model>();
     }
     else
     {
-        disp = MCU_ReadCodeAdvance() << 8;
-        disp |= MCU_ReadCodeAdvance();
+        disp = MCU_ReadCodeAdvance<model>() << 8;
+        disp |= MCU_ReadCodeAdvance<model>();
     }
-    MCU_PushStack(mcu.pc);
+    MCU_PushStack<model>(mcu.pc);
     mcu.pc += disp;
 }
 
+template<class model>
 void MCU_Jump_PJMP(uint8_t operand)
 {
     uint8_t page;
     uint16_t address;
-    page = MCU_ReadCodeAdvance();
-    address = MCU_ReadCodeAdvance() << 8;
-    address |= MCU_ReadCodeAdvance();
+    page = MCU_ReadCodeAdvance<model>();
+    address = MCU_ReadCodeAdvance<model>() << 8;
+    address |= MCU_ReadCodeAdvance<model>();
     mcu.cp = page;
     mcu.pc = address;
 }
 
-uint32_t operand_type;
-uint16_t operand_ea;
-uint8_t operand_ep;
-uint8_t operand_size;
-uint8_t operand_reg;
-uint8_t operand_status;
-uint16_t operand_data;
-uint8_t opcode_extended;
-
-uint32_t MCU_Operand_Read(void)
+template<class model>
+inline uint32_t MCU_Operand_Read(const mcu_operand_t *op)
 {
-    switch (operand_type)
+    switch (op->type)
     {
     case GENERAL_DIRECT:
-        if (operand_size)
-            return mcu.r[operand_reg];
-        return mcu.r[operand_reg] & 0xff;
+        if (op->size)
+            return mcu.r[op->reg];
+        return mcu.r[op->reg] & 0xff;
     case GENERAL_INDIRECT:
     case GENERAL_ABSOLUTE:
-        if (operand_size)
+        if (op->size)
         {
-            if (operand_ea & 1)
+            if (op->ea & 1)
             {
                 MCU_Interrupt_Exception(EXCEPTION_SOURCE_ADDRESS_ERROR);
             }
-            return MCU_Read16(MCU_GetAddress(operand_ep, operand_ea));
+            return MCU_Read16Impl<model>(MCU_GetAddress(op->ep, op->ea));
         }
-        return MCU_Read(MCU_GetAddress(operand_ep, operand_ea));
+        return MCU_ReadImpl<model>(MCU_GetAddress(op->ep, op->ea));
     case GENERAL_IMMEDIATE:
-        return operand_data;
+        return op->data;
     }
     return 0;
 }
 
-void MCU_Operand_Write(uint32_t data)
+template<class model>
+inline void MCU_Operand_Write(const mcu_operand_t *op, uint32_t data)
 {
-    switch (operand_type)
+    switch (op->type)
     {
     case GENERAL_DIRECT:
-        if (operand_size)
-            mcu.r[operand_reg] = data;
+        if (op->size)
+            mcu.r[op->reg] = data;
         else
         {
-            mcu.r[operand_reg] &= ~0xff;
-            mcu.r[operand_reg] |= data & 0xff;
+            mcu.r[op->reg] &= ~0xff;
+            mcu.r[op->reg] |= data & 0xff;
         }
         break;
     case GENERAL_INDIRECT:
     case GENERAL_ABSOLUTE:
-        if (operand_size)
+        if (op->size)
         {
-            if (operand_ea & 1)
+            if (op->ea & 1)
             {
                 MCU_Interrupt_Exception(EXCEPTION_SOURCE_ADDRESS_ERROR);
             }
-            MCU_Write16(MCU_GetAddress(operand_ep, operand_ea), data);
+            MCU_Write16Impl<model>(MCU_GetAddress(op->ep, op->ea), data);
         }
         else
-            MCU_Write(MCU_GetAddress(operand_ep, operand_ea), data);
+            MCU_WriteImpl<model>(MCU_GetAddress(op->ep, op->ea), data);
         break;
     case GENERAL_IMMEDIATE:
         MCU_Interrupt_Exception(EXCEPTION_SOURCE_INVALID_INSTRUCTION);
@@ -557,138 +547,6 @@ void MCU_Operand_Write(uint32_t data)
     }
 }
 
-void MCU_Operand_General(uint8_t operand)
-{
-    uint32_t type = GENERAL_DIRECT;
-    uint32_t disp = 0;
-    uint32_t increase = INCREASE_NONE;
-    uint32_t absolute = 0;
-    uint32_t reg = 0;
-    uint32_t siz = OPERAND_BYTE;
-    uint32_t data = 0;
-    uint32_t addr = 0;
-    uint32_t addrpage = 0;
-    uint32_t ea = 0;
-    uint32_t ep = 0;
-    uint8_t opcode;
-    uint8_t opcode_reg;
-    if (operand & 0x08)
-        siz = OPERAND_WORD;
-    else
-        siz = OPERAND_BYTE;
-    reg = operand & 0x07;
-    switch (operand & 0xf0)
-    {
-    case 0xa0:
-        type = GENERAL_DIRECT;
-        break;
-    case 0xd0:
-        type = GENERAL_INDIRECT;
-        break;
-    case 0xe0:
-        type = GENERAL_INDIRECT;
-        disp = (int8_t)MCU_ReadCodeAdvance();
-        break;
-    case 0xf0:
-        type = GENERAL_INDIRECT;
-        disp = MCU_ReadCodeAdvance();
-        disp <<= 8;
-        disp |= MCU_ReadCodeAdvance();
-        break;
-    case 0xb0:
-        type = GENERAL_INDIRECT;
-        increase = INCREASE_DECREASE;
-        break;
-    case 0xc0:
-        type = GENERAL_INDIRECT;
-        increase = INCREASE_INCREASE;
-        break;
-    case 0x00:
-        if (reg == 5)
-        {
-            type = GENERAL_ABSOLUTE;
-            addr = mcu.br << 8;
-            addr |= MCU_ReadCodeAdvance();
-            addrpage = 0;
-        }
-        else if (reg == 4)
-        {
-            type = GENERAL_IMMEDIATE;
-            data = MCU_ReadCodeAdvance();
-            if (siz)
-            {
-                data <<= 8;
-                data |= MCU_ReadCodeAdvance();
-            }
-        }
-        break;
-    case 0x10:
-        if (reg == 5)
-        {
-            type = GENERAL_ABSOLUTE;
-            addr = MCU_ReadCodeAdvance() << 8;
-            addr |= MCU_ReadCodeAdvance();
-            addrpage = mcu.dp;
-        }
-        break;
-    }
-    if (type == GENERAL_INDIRECT)
-    {
-        if (increase == INCREASE_DECREASE)
-        {
-            if (siz || reg == 7)
-            {
-                mcu.r[reg] -= 2;
-            }
-            else
-            {
-                mcu.r[reg] -= 1;
-            }
-        }
-        ea = mcu.r[reg] + disp;
-        if (increase == INCREASE_INCREASE)
-        {
-            if (siz || reg == 7)
-            {
-                mcu.r[reg] += 2;
-            }
-            else
-            {
-                mcu.r[reg] += 1;
-            }
-        }
-
-        ea &= 0xffff;
-
-        ep = MCU_GetPageForRegister(reg) & 0xff;
-    }
-    else if (type == GENERAL_ABSOLUTE)
-    {
-        ea = addr & 0xffff;
-
-        ep = addrpage & 0xff;
-    }
-
-    opcode = MCU_ReadCodeAdvance();
-    opcode_extended = opcode == 0x00;
-    if (opcode_extended)
-    {
-        opcode = MCU_ReadCodeAdvance();
-    }
-    opcode_reg = opcode & 0x07;
-    opcode >>= 3;
-
-    operand_type = type;
-    operand_ea = ea;
-    operand_ep = ep;
-    operand_size = siz;
-    operand_reg = reg;
-    operand_data = data;
-    operand_status = 0;
-
-    MCU_Opcode_Table[opcode](opcode, opcode_reg);
-}
-
 void MCU_SetStatusCommon(uint32_t val, uint32_t siz)
 {
     if (siz)
@@ -703,35 +561,39 @@ void MCU_SetStatusCommon(uint32_t val, uint32_t siz)
     MCU_SetStatus(0, STATUS_V);
 }
 
+template<class model>
 void MCU_Opcode_Short_NotImplemented(uint8_t opcode)
 {
     MCU_ErrorTrap();
 }
 
+template<class model>
 void MCU_Opcode_Short_MOVE(uint8_t opcode)
 {
     uint32_t reg = opcode & 0x07;
-    uint8_t data = MCU_ReadCodeAdvance();
+    uint8_t data = MCU_ReadCodeAdvance<model>();
     mcu.r[reg] &= ~0xff;
     mcu.r[reg] |= data;
     MCU_SetStatusCommon(data, 0);
 }
 
+template<class model>
 void MCU_Opcode_Short_MOVI(uint8_t opcode)
 {
     uint32_t reg = opcode & 0x07;
     uint16_t data;
-    data = MCU_ReadCodeAdvance() << 8;
-    data |= MCU_ReadCodeAdvance();
+    data = MCU_ReadCodeAdvance<model>() << 8;
+    data |= MCU_ReadCodeAdvance<model>();
     mcu.r[reg] = data;
     MCU_SetStatusCommon(data, 1);
 }
 
+template<class model>
 void MCU_Opcode_Short_MOVF(uint8_t opcode)
 {
     uint32_t reg = opcode & 0x07;
     uint32_t siz = (opcode & 0x08) != 0;
-    int8_t disp = MCU_ReadCodeAdvance();
+    int8_t disp = MCU_ReadCodeAdvance<model>();
     uint32_t addr = (mcu.r[6] + disp) & 0xffff;
     addr |= mcu.tp << 16;
     if ((opcode & 0x10) == 0)
@@ -739,14 +601,14 @@ void MCU_Opcode_Short_MOVF(uint8_t opcode)
         uint16_t data;
         if (siz)
         {
-            data = MCU_Read16(addr);
+            data = MCU_Read16Impl<model>(addr);
             mcu.r[reg] &= ~0xff;
             mcu.r[reg] |= data;
             MCU_SetStatusCommon(data, 0);
         }
         else
         {
-            data = MCU_Read(addr);
+            data = MCU_ReadImpl<model>(addr);
             mcu.r[reg] = data;
             MCU_SetStatusCommon(data, 1);
         }
@@ -757,65 +619,68 @@ void MCU_Opcode_Short_MOVF(uint8_t opcode)
         if (siz)
         {
             data = mcu.r[reg] & 0xff;
-            MCU_Write(addr, data);
+            MCU_WriteImpl<model>(addr, data);
             MCU_SetStatusCommon(data, 0);
         }
         else
         {
             data = mcu.r[reg];
-            MCU_Write16(addr, data);
+            MCU_Write16Impl<model>(addr, data);
             MCU_SetStatusCommon(data, 1);
         }
     }
 }
 
+template<class model>
 void MCU_Opcode_Short_MOVL(uint8_t opcode)
 {
     uint32_t reg = opcode & 0x07;
     uint32_t siz = (opcode & 0x08) != 0;
     uint16_t addr = mcu.br << 8;
     uint32_t data;
-    addr |= MCU_ReadCodeAdvance();
+    addr |= MCU_ReadCodeAdvance<model>();
     if (siz)
     {
         if (addr & 1)
             MCU_Interrupt_Exception(EXCEPTION_SOURCE_ADDRESS_ERROR);
-        data = MCU_Read16(addr);
+        data = MCU_Read16Impl<model>(addr);
         mcu.r[reg] = data;
         MCU_SetStatusCommon(data, 1);
     }
     else
     {
-        data = MCU_Read(addr);
+        data = MCU_ReadImpl<model>(addr);
         mcu.r[reg] &= ~0xff;
         mcu.r[reg] |= data;
         MCU_SetStatusCommon(data, 0);
     }
 }
 
+template<class model>
 void MCU_Opcode_Short_MOVS(uint8_t opcode)
 {
     uint32_t reg = opcode & 0x07;
     uint32_t siz = (opcode & 0x08) != 0;
     uint16_t addr = mcu.br << 8;
     uint32_t data;
-    addr |= MCU_ReadCodeAdvance();
+    addr |= MCU_ReadCodeAdvance<model>();
     if (siz)
     {
         if (addr & 1)
             MCU_Interrupt_Exception(EXCEPTION_SOURCE_ADDRESS_ERROR);
         data = mcu.r[reg];
-        MCU_Write16(addr, data);
+        MCU_Write16Impl<model>(addr, data);
         MCU_SetStatusCommon(data, 1);
     }
     else
     {
         data = mcu.r[reg] & 0xff;
-        MCU_Write(addr, data);
+        MCU_WriteImpl<model>(addr, data);
         MCU_SetStatusCommon(data, 0);
     }
 }
 
+template<class model>
 void MCU_Opcode_Short_CMP(uint8_t opcode)
 {
     uint32_t reg = opcode & 0x07;
@@ -823,64 +688,66 @@ void MCU_Opcode_Short_CMP(uint8_t opcode)
     int32_t t1, t2;
     if (siz)
     {
-        t2 = MCU_ReadCodeAdvance() << 8;
-        t2 |= MCU_ReadCodeAdvance();
+        t2 = MCU_ReadCodeAdvance<model>() << 8;
+        t2 |= MCU_ReadCodeAdvance<model>();
     }
     else
     {
-        t2 = MCU_ReadCodeAdvance();
+        t2 = MCU_ReadCodeAdvance<model>();
     }
     t1 = mcu.r[reg];
     MCU_SUB_Common(t1, t2, 0, siz);
 }
 
-void MCU_Opcode_NotImplemented(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_NotImplemented(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *)
 {
     MCU_ErrorTrap();
 }
 
-void MCU_Opcode_MOVG_Immediate(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_MOVG_Immediate(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
     uint32_t data;
-    if (opcode_reg == 6 && (operand_type == GENERAL_INDIRECT || operand_type == GENERAL_ABSOLUTE))
+    if (opcode_reg == 6 && (op->type == GENERAL_INDIRECT || op->type == GENERAL_ABSOLUTE))
     {
-        data = (int8_t)MCU_ReadCodeAdvance();
-        MCU_Operand_Write(data);
-        MCU_SetStatusCommon(data, operand_size);
+        data = (int8_t)MCU_ReadCodeAdvance<model>();
+        MCU_Operand_Write<model>(op, data);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 7 && (operand_type == GENERAL_INDIRECT || operand_type == GENERAL_ABSOLUTE))
+    else if (opcode_reg == 7 && (op->type == GENERAL_INDIRECT || op->type == GENERAL_ABSOLUTE))
     {
-        data = MCU_ReadCodeAdvance() << 8;
-        data |= MCU_ReadCodeAdvance();
-        MCU_Operand_Write(data);
-        MCU_SetStatusCommon(data, operand_size);
+        data = MCU_ReadCodeAdvance<model>() << 8;
+        data |= MCU_ReadCodeAdvance<model>();
+        MCU_Operand_Write<model>(op, data);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 4 && (operand_type == GENERAL_INDIRECT || operand_type == GENERAL_ABSOLUTE) && operand_size == OPERAND_BYTE)
+    else if (opcode_reg == 4 && (op->type == GENERAL_INDIRECT || op->type == GENERAL_ABSOLUTE) && op->size == OPERAND_BYTE)
     {
-        uint32_t t1 = MCU_Operand_Read();
-        uint32_t t2 = MCU_ReadCodeAdvance();
+        uint32_t t1 = MCU_Operand_Read<model>(op);
+        uint32_t t2 = MCU_ReadCodeAdvance<model>();
         MCU_SUB_Common(t1, t2, 0, OPERAND_BYTE);
     }
-    else if (opcode_reg == 4 && (operand_type == GENERAL_INDIRECT || operand_type == GENERAL_ABSOLUTE) && operand_size == OPERAND_WORD) // FIXME
+    else if (opcode_reg == 4 && (op->type == GENERAL_INDIRECT || op->type == GENERAL_ABSOLUTE) && op->size == OPERAND_WORD) // FIXME
     {
-        uint32_t t1 = MCU_Operand_Read();
-        uint32_t t2 = (uint16_t)((int8_t)MCU_ReadCodeAdvance());
+        uint32_t t1 = MCU_Operand_Read<model>(op);
+        uint32_t t2 = (uint16_t)((int8_t)MCU_ReadCodeAdvance<model>());
         MCU_SUB_Common(t1, t2, 0, OPERAND_WORD);
     }
-    else if (opcode_reg == 5 && (operand_type == GENERAL_INDIRECT || operand_type == GENERAL_ABSOLUTE) && operand_size == OPERAND_WORD)
+    else if (opcode_reg == 5 && (op->type == GENERAL_INDIRECT || op->type == GENERAL_ABSOLUTE) && op->size == OPERAND_WORD)
     {
         uint32_t t1, t2;
-        t1 = MCU_Operand_Read();
-        t2 = MCU_ReadCodeAdvance() << 8;
-        t2 |= MCU_ReadCodeAdvance();
+        t1 = MCU_Operand_Read<model>(op);
+        t2 = MCU_ReadCodeAdvance<model>() << 8;
+        t2 |= MCU_ReadCodeAdvance<model>();
         MCU_SUB_Common(t1, t2, 0, OPERAND_WORD);
     }
-    else if (opcode_reg == 5 && (operand_type == GENERAL_INDIRECT || operand_type == GENERAL_ABSOLUTE) && operand_size == OPERAND_BYTE) // FIXME
+    else if (opcode_reg == 5 && (op->type == GENERAL_INDIRECT || op->type == GENERAL_ABSOLUTE) && op->size == OPERAND_BYTE) // FIXME
     {
         uint32_t t1, t2;
-        t1 = MCU_Operand_Read();
-        t2 = MCU_ReadCodeAdvance() << 8;
-        t2 |= MCU_ReadCodeAdvance();
+        t1 = MCU_Operand_Read<model>(op);
+        t2 = MCU_ReadCodeAdvance<model>() << 8;
+        t2 |= MCU_ReadCodeAdvance<model>();
         MCU_SUB_Common(t1, t2, 0, OPERAND_BYTE);
     }
     else
@@ -889,59 +756,62 @@ void MCU_Opcode_MOVG_Immediate(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_BSET_ORC(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_BSET_ORC(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (operand_type == GENERAL_IMMEDIATE) // ORC
+    if (op->type == GENERAL_IMMEDIATE) // ORC
     {
-        uint32_t data = MCU_Operand_Read();
-        uint32_t val = MCU_ControlRegisterRead(opcode_reg, operand_size);
+        uint32_t data = MCU_Operand_Read<model>(op);
+        uint32_t val = MCU_ControlRegisterRead(opcode_reg, op->size);
         val |= data;
-        MCU_ControlRegisterWrite(opcode_reg, operand_size, val);
+        MCU_ControlRegisterWrite(opcode_reg, op->size, val);
         if (opcode_reg >= 2)
         {
-            MCU_SetStatusCommon(val, operand_size);
+            MCU_SetStatusCommon(val, op->size);
         }
         mcu.ex_ignore = 1;
     }
     else // BSET
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t bit = mcu.r[opcode_reg] & 0x0f;
         MCU_SetStatus((data & (1 << bit)) == 0, STATUS_Z);
         data |= 1 << bit;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
     }
 }
 
-void MCU_Opcode_BCLR_ANDC(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_BCLR_ANDC(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (operand_type == GENERAL_IMMEDIATE) // ANDC
+    if (op->type == GENERAL_IMMEDIATE) // ANDC
     {
-        uint32_t data = MCU_Operand_Read();
-        uint32_t val = MCU_ControlRegisterRead(opcode_reg, operand_size);
+        uint32_t data = MCU_Operand_Read<model>(op);
+        uint32_t val = MCU_ControlRegisterRead(opcode_reg, op->size);
         val &= data;
-        MCU_ControlRegisterWrite(opcode_reg, operand_size, val);
+        MCU_ControlRegisterWrite(opcode_reg, op->size, val);
         if (opcode_reg >= 2)
         {
-            MCU_SetStatusCommon(val, operand_size);
+            MCU_SetStatusCommon(val, op->size);
         }
         mcu.ex_ignore = 1;
     }
     else // BCLR
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t bit = mcu.r[opcode_reg] & 0x0f;
         MCU_SetStatus((data & (1 << bit)) == 0, STATUS_Z);
         data &= ~(1 << bit);
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
     }
 }
 
-void MCU_Opcode_BTST(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_BTST(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (operand_type != GENERAL_IMMEDIATE)
+    if (op->type != GENERAL_IMMEDIATE)
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t bit = mcu.r[opcode_reg] & 0x0f;
         MCU_SetStatus((data & (1 << bit)) == 0, STATUS_Z);
     }
@@ -951,57 +821,58 @@ void MCU_Opcode_BTST(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_CLR(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_CLR(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (opcode_reg == 3 && operand_type != GENERAL_IMMEDIATE) // CLR
+    if (opcode_reg == 3 && op->type != GENERAL_IMMEDIATE) // CLR
     {
-        MCU_Operand_Write(0);
+        MCU_Operand_Write<model>(op, 0);
         MCU_SetStatus(0, STATUS_N);
         MCU_SetStatus(1, STATUS_Z);
         MCU_SetStatus(0, STATUS_V);
         MCU_SetStatus(0, STATUS_C);
     }
-    else if (opcode_reg == 6 && operand_type != GENERAL_IMMEDIATE) // TST
+    else if (opcode_reg == 6 && op->type != GENERAL_IMMEDIATE) // TST
     {
-        uint32_t data = MCU_Operand_Read();
-        MCU_SetStatusCommon(data, operand_size);
+        uint32_t data = MCU_Operand_Read<model>(op);
+        MCU_SetStatusCommon(data, op->size);
         MCU_SetStatus(0, STATUS_C);
     }
-    else if (opcode_reg == 2 && operand_type == GENERAL_DIRECT && operand_size == 0) // EXTU
+    else if (opcode_reg == 2 && op->type == GENERAL_DIRECT && op->size == 0) // EXTU
     {
-        uint32_t data = (uint8_t)mcu.r[operand_reg];
-        mcu.r[operand_reg] = data;
+        uint32_t data = (uint8_t)mcu.r[op->reg];
+        mcu.r[op->reg] = data;
         MCU_SetStatus(0, STATUS_N);
         MCU_SetStatus(data == 0, STATUS_Z);
         MCU_SetStatus(0, STATUS_V);
         MCU_SetStatus(0, STATUS_C);
     }
-    else if (opcode_reg == 0 && operand_type == GENERAL_DIRECT && operand_size == 0) // SWAP
+    else if (opcode_reg == 0 && op->type == GENERAL_DIRECT && op->size == 0) // SWAP
     {
-        uint32_t data = mcu.r[operand_reg];
+        uint32_t data = mcu.r[op->reg];
         uint32_t data_h = data >> 8;
         uint32_t data_l = data & 0xff;
         data = (data_l << 8) | data_h;
-        mcu.r[operand_reg] = data;
+        mcu.r[op->reg] = data;
         MCU_SetStatusCommon(data, OPERAND_WORD);
     }
-    else if (opcode_reg == 5 && operand_type != GENERAL_IMMEDIATE) // NOT
+    else if (opcode_reg == 5 && op->type != GENERAL_IMMEDIATE) // NOT
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         data = ~data;
-        MCU_Operand_Write(data);
-        MCU_SetStatusCommon(data, operand_size);
+        MCU_Operand_Write<model>(op, data);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 4 && operand_type != GENERAL_IMMEDIATE) // NEG
+    else if (opcode_reg == 4 && op->type != GENERAL_IMMEDIATE) // NEG
     {
-        uint32_t data = MCU_Operand_Read();
-        data = MCU_SUB_Common(0, data, 0, operand_size);
-        MCU_Operand_Write(data);
+        uint32_t data = MCU_Operand_Read<model>(op);
+        data = MCU_SUB_Common(0, data, 0, op->size);
+        MCU_Operand_Write<model>(op, data);
     }
-    else if (opcode_reg == 1 && operand_type == GENERAL_DIRECT && operand_size == 0) // EXTS
+    else if (opcode_reg == 1 && op->type == GENERAL_DIRECT && op->size == 0) // EXTS
     {
-        uint32_t data = mcu.r[operand_reg];
-        mcu.r[operand_reg] = (int8_t)data;
+        uint32_t data = mcu.r[op->reg];
+        mcu.r[op->reg] = (int8_t)data;
         MCU_SetStatusCommon(data, OPERAND_WORD);
     }
     else
@@ -1010,28 +881,31 @@ void MCU_Opcode_CLR(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_LDC(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_LDC(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    uint32_t data = MCU_Operand_Read();
-    MCU_ControlRegisterWrite(opcode_reg, operand_size, data);
+    uint32_t data = MCU_Operand_Read<model>(op);
+    MCU_ControlRegisterWrite(opcode_reg, op->size, data);
     mcu.ex_ignore = 1;
 }
 
-void MCU_Opcode_STC(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_STC(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    uint32_t data = MCU_ControlRegisterRead(opcode_reg, operand_size);
-    MCU_Operand_Write(data);
+    uint32_t data = MCU_ControlRegisterRead(opcode_reg, op->size);
+    MCU_Operand_Write<model>(op, data);
 }
 
-void MCU_Opcode_BSET(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_BSET(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (operand_type != GENERAL_IMMEDIATE)
+    if (op->type != GENERAL_IMMEDIATE)
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t bit = opcode_reg | ((opcode & 1) << 3);
         MCU_SetStatus((data & (1 << bit)) == 0, STATUS_Z);
         data |= 1 << bit;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
     }
     else
     {
@@ -1039,15 +913,16 @@ void MCU_Opcode_BSET(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_BCLR(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_BCLR(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (operand_type != GENERAL_IMMEDIATE)
+    if (op->type != GENERAL_IMMEDIATE)
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t bit = opcode_reg | ((opcode & 1) << 3);
         MCU_SetStatus((data & (1 << bit)) == 0, STATUS_Z);
         data &= ~(1 << bit);
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
     }
     else
     {
@@ -1055,9 +930,10 @@ void MCU_Opcode_BCLR(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_MOVG(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_MOVG(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (opcode_extended)
+    if (op->extended)
     {
         if (opcode == 0x12)
         {
@@ -1075,14 +951,14 @@ void MCU_Opcode_MOVG(uint8_t opcode, uint8_t opcode_reg)
         uint32_t data;
         if (d)
         {
-            if (operand_type == GENERAL_DIRECT) // XCH
+            if (op->type == GENERAL_DIRECT) // XCH
             {
-                if (operand_size)
+                if (op->size)
                 {
                     uint32_t r1 = mcu.r[opcode_reg];
-                    uint32_t r2 = mcu.r[operand_reg];
+                    uint32_t r2 = mcu.r[op->reg];
                     mcu.r[opcode_reg] = r2;
-                    mcu.r[operand_reg] = r1;
+                    mcu.r[op->reg] = r1;
                 }
                 else
                 {
@@ -1092,30 +968,31 @@ void MCU_Opcode_MOVG(uint8_t opcode, uint8_t opcode_reg)
             else
             {
                 data = mcu.r[opcode_reg];
-                MCU_Operand_Write(data);
-                MCU_SetStatusCommon(data, operand_size);
+                MCU_Operand_Write<model>(op, data);
+                MCU_SetStatusCommon(data, op->size);
             }
         }
         else
         {
-            data = MCU_Operand_Read();
-            if (operand_size)
+            data = MCU_Operand_Read<model>(op);
+            if (op->size)
                 mcu.r[opcode_reg] = data;
             else
             {
                 mcu.r[opcode_reg] &= ~0xff;
                 mcu.r[opcode_reg] |= data & 0xff;
             }
-            MCU_SetStatusCommon(data, operand_size);
+            MCU_SetStatusCommon(data, op->size);
         }
     }
 }
 
-void MCU_Opcode_BTSTI(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_BTSTI(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (operand_type != GENERAL_IMMEDIATE)
+    if (op->type != GENERAL_IMMEDIATE)
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t bit = opcode_reg | ((opcode & 1) << 3);
         MCU_SetStatus((data & (1 << bit)) == 0, STATUS_Z);
     }
@@ -1125,15 +1002,16 @@ void MCU_Opcode_BTSTI(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_BNOTI(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_BNOTI(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (operand_type != GENERAL_IMMEDIATE)
+    if (op->type != GENERAL_IMMEDIATE)
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t bit = opcode_reg | ((opcode & 1) << 3);
         MCU_SetStatus((data & (1 << bit)) == 0, STATUS_Z);
         data ^= (1 << bit);
-        MCU_Operand_Write(data); 
+        MCU_Operand_Write<model>(op, data); 
     }
     else
     {
@@ -1141,23 +1019,26 @@ void MCU_Opcode_BNOTI(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_OR(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_OR(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    uint32_t data = MCU_Operand_Read();
+    uint32_t data = MCU_Operand_Read<model>(op);
     mcu.r[opcode_reg] |= data;
-    MCU_SetStatusCommon(mcu.r[opcode_reg], operand_size);
+    MCU_SetStatusCommon(mcu.r[opcode_reg], op->size);
 }
 
-void MCU_Opcode_CMP(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_CMP(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
     int32_t t1 = mcu.r[opcode_reg];
-    int32_t t2 = MCU_Operand_Read();
-    MCU_SUB_Common(t1, t2, 0, operand_size);
+    int32_t t2 = MCU_Operand_Read<model>(op);
+    MCU_SUB_Common(t1, t2, 0, op->size);
 }
 
-void MCU_Opcode_ADDQ(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_ADDQ(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    int32_t t1 = MCU_Operand_Read();
+    int32_t t1 = MCU_Operand_Read<model>(op);
     int32_t t2 = 0;
     switch (opcode_reg)
     {
@@ -1177,16 +1058,17 @@ void MCU_Opcode_ADDQ(uint8_t opcode, uint8_t opcode_reg)
         MCU_ErrorTrap();
         break;
     }
-    t1 = MCU_ADD_Common(t1, t2, 0, operand_size);
-    MCU_Operand_Write(t1);
+    t1 = MCU_ADD_Common(t1, t2, 0, op->size);
+    MCU_Operand_Write<model>(op, t1);
 }
 
-void MCU_Opcode_ADD(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_ADD(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
     int32_t t1 = mcu.r[opcode_reg];
-    int32_t t2 = MCU_Operand_Read();
-    t1 = MCU_ADD_Common(t1, t2, 0, operand_size);
-    if (operand_size)
+    int32_t t2 = MCU_Operand_Read<model>(op);
+    t1 = MCU_ADD_Common(t1, t2, 0, op->size);
+    if (op->size)
         mcu.r[opcode_reg] = t1;
     else
     {
@@ -1195,12 +1077,13 @@ void MCU_Opcode_ADD(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_SUB(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_SUB(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
     int32_t t1 = mcu.r[opcode_reg];
-    int32_t t2 = MCU_Operand_Read();
-    t1 = MCU_SUB_Common(t1, t2, 0, operand_size);
-    if (operand_size)
+    int32_t t2 = MCU_Operand_Read<model>(op);
+    t1 = MCU_SUB_Common(t1, t2, 0, op->size);
+    if (op->size)
         mcu.r[opcode_reg] = t1;
     else
     {
@@ -1209,102 +1092,105 @@ void MCU_Opcode_SUB(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_SUBS(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_SUBS(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
     int32_t t1 = mcu.r[opcode_reg];
-    int32_t t2 = MCU_Operand_Read();
-    if (operand_size)
+    int32_t t2 = MCU_Operand_Read<model>(op);
+    if (op->size)
         mcu.r[opcode_reg] = t1 - t2;
     else
         mcu.r[opcode_reg] = t1 - (int8_t)t2;
 }
 
-void MCU_Opcode_AND(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_AND(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
     uint32_t data = mcu.r[opcode_reg];
-    data &= MCU_Operand_Read();
-    if (operand_size)
+    data &= MCU_Operand_Read<model>(op);
+    if (op->size)
         mcu.r[opcode_reg] = data;
     else
     {
         mcu.r[opcode_reg] &= ~0xff;
         mcu.r[opcode_reg] |= data & 0xff;
     }
-    MCU_SetStatusCommon(mcu.r[opcode_reg], operand_size);
+    MCU_SetStatusCommon(mcu.r[opcode_reg], op->size);
 }
 
-void MCU_Opcode_SHLR(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_SHLR(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    if (opcode_reg == 0x03 && operand_type != GENERAL_IMMEDIATE) // SHLR
+    if (opcode_reg == 0x03 && op->type != GENERAL_IMMEDIATE) // SHLR
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t C = data & 1;
         data >>= 1;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
         MCU_SetStatus(C, STATUS_C);
-        MCU_SetStatusCommon(data, operand_size);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 0x02 && operand_type != GENERAL_IMMEDIATE) // SHLL
+    else if (opcode_reg == 0x02 && op->type != GENERAL_IMMEDIATE) // SHLL
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t C;
-        if (operand_size)
+        if (op->size)
             C = (data & 0x8000) != 0;
         else
             C = (data & 0x80) != 0;
         data <<= 1;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
         MCU_SetStatus(C, STATUS_C);
-        MCU_SetStatusCommon(data, operand_size);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 0x06 && operand_type != GENERAL_IMMEDIATE) // ROTXL
+    else if (opcode_reg == 0x06 && op->type != GENERAL_IMMEDIATE) // ROTXL
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t bit = (mcu.sr & STATUS_C) != 0;
         uint32_t C;
-        if (operand_size)
+        if (op->size)
             C = (data & 0x8000) != 0;
         else
             C = (data & 0x80) != 0;
         data <<= 1;
         data |= bit;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
         MCU_SetStatus(C, STATUS_C);
-        MCU_SetStatusCommon(data, operand_size);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 0x04 && operand_type != GENERAL_IMMEDIATE) // ROTL
+    else if (opcode_reg == 0x04 && op->type != GENERAL_IMMEDIATE) // ROTL
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t C;
-        if (operand_size)
+        if (op->size)
             C = (data & 0x8000) != 0;
         else
             C = (data & 0x80) != 0;
         data <<= 1;
         data |= C;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
         MCU_SetStatus(C, STATUS_C);
-        MCU_SetStatusCommon(data, operand_size);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 0x00 && operand_type != GENERAL_IMMEDIATE) // SHAL
+    else if (opcode_reg == 0x00 && op->type != GENERAL_IMMEDIATE) // SHAL
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t C;
-        if (operand_size)
+        if (op->size)
             C = (data & 0x8000) != 0;
         else
             C = (data & 0x80) != 0;
         data <<= 1;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
         MCU_SetStatus(C, STATUS_C);
-        MCU_SetStatusCommon(data, operand_size);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 0x01 && operand_type != GENERAL_IMMEDIATE) // SHAR
+    else if (opcode_reg == 0x01 && op->type != GENERAL_IMMEDIATE) // SHAR
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t C = data & 0x1;
         uint32_t msb;
-        if (operand_size)
+        if (op->size)
         {
             msb = data & 0x8000;
             data &= 0x7fff;
@@ -1316,22 +1202,22 @@ void MCU_Opcode_SHLR(uint8_t opcode, uint8_t opcode_reg)
         }
         data >>= 1;
         data |= msb;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
         MCU_SetStatus(C, STATUS_C);
-        MCU_SetStatusCommon(data, operand_size);
+        MCU_SetStatusCommon(data, op->size);
     }
-    else if (opcode_reg == 0x05 && operand_type != GENERAL_IMMEDIATE) // ROTR
+    else if (opcode_reg == 0x05 && op->type != GENERAL_IMMEDIATE) // ROTR
     {
-        uint32_t data = MCU_Operand_Read();
+        uint32_t data = MCU_Operand_Read<model>(op);
         uint32_t C = (data & 0x1) != 0;
         data >>= 1;
-        if (operand_size)
+        if (op->size)
             data |= C << 15;
         else
             data |= C << 7;
-        MCU_Operand_Write(data);
+        MCU_Operand_Write<model>(op, data);
         MCU_SetStatus(C, STATUS_C);
-        MCU_SetStatusCommon(data, operand_size);
+        MCU_SetStatusCommon(data, op->size);
     }
     else
     {
@@ -1339,16 +1225,17 @@ void MCU_Opcode_SHLR(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_MULXU(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_MULXU(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    uint32_t t1 = MCU_Operand_Read();
+    uint32_t t1 = MCU_Operand_Read<model>(op);
     uint32_t t2 = mcu.r[opcode_reg];
     uint32_t N, Z;
-    if (!operand_size)
+    if (!op->size)
         t2 &= 0xff;
     t1 *= t2;
 
-    if (operand_size)
+    if (op->size)
     {
         opcode_reg &= ~1;
         mcu.r[opcode_reg | 0] = t1 >> 16;
@@ -1368,9 +1255,10 @@ void MCU_Opcode_MULXU(uint8_t opcode, uint8_t opcode_reg)
     MCU_SetStatus(0, STATUS_C);
 }
 
-void MCU_Opcode_DIVXU(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_DIVXU(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    uint32_t t1 = MCU_Operand_Read();
+    uint32_t t1 = MCU_Operand_Read<model>(op);
     uint32_t t2;
     uint32_t R, Q;
 
@@ -1384,7 +1272,7 @@ void MCU_Opcode_DIVXU(uint8_t opcode, uint8_t opcode_reg)
         return;
     }
 
-    if (operand_size)
+    if (op->size)
     {
         opcode_reg &= ~1;
         t2 = mcu.r[opcode_reg | 0] << 16;
@@ -1433,32 +1321,35 @@ void MCU_Opcode_DIVXU(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_ADDS(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_ADDS(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    uint32_t data = MCU_Operand_Read();
-    if (!operand_size)
+    uint32_t data = MCU_Operand_Read<model>(op);
+    if (!op->size)
         data = (int8_t)data;
     mcu.r[opcode_reg] += data;
 }
 
-void MCU_Opcode_XOR(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_XOR(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
-    uint32_t data = MCU_Operand_Read();
+    uint32_t data = MCU_Operand_Read<model>(op);
     mcu.r[opcode_reg] ^= data;
-    MCU_SetStatusCommon(mcu.r[opcode_reg], operand_size);
+    MCU_SetStatusCommon(mcu.r[opcode_reg], op->size);
 }
 
-void MCU_Opcode_ADDX(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_ADDX(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
     int32_t t1 = mcu.r[opcode_reg];
-    int32_t t2 = MCU_Operand_Read();
+    int32_t t2 = MCU_Operand_Read<model>(op);
     int32_t C = (mcu.sr & STATUS_C) != 0;
     int32_t Z = (mcu.sr & STATUS_Z) != 0;
-    t1 = MCU_ADD_Common(t1, t2, C, operand_size);
+    t1 = MCU_ADD_Common(t1, t2, C, op->size);
     if (!Z)
         MCU_SetStatus(0, STATUS_Z);
         
-    if (operand_size)
+    if (op->size)
         mcu.r[opcode_reg] = t1;
     else
     {
@@ -1467,13 +1358,14 @@ void MCU_Opcode_ADDX(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void MCU_Opcode_SUBX(uint8_t opcode, uint8_t opcode_reg)
+template<class model>
+inline void MCU_Opcode_SUBX(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
 {
     int32_t t1 = mcu.r[opcode_reg];
-    int32_t t2 = MCU_Operand_Read();
+    int32_t t2 = MCU_Operand_Read<model>(op);
     int32_t C = (mcu.sr & STATUS_C) != 0;
-    t1 = MCU_SUB_Common(t1, t2, C, operand_size);
-    if (operand_size)
+    t1 = MCU_SUB_Common(t1, t2, C, op->size);
+    if (op->size)
         mcu.r[opcode_reg] = t1;
     else
     {
@@ -1482,297 +1374,648 @@ void MCU_Opcode_SUBX(uint8_t opcode, uint8_t opcode_reg)
     }
 }
 
-void (*MCU_Operand_Table[256])(uint8_t operand) = {
-    MCU_Operand_Nop, // 00
-    MCU_Jump_JMP, // 01
-    MCU_LDM, // 02
-    MCU_Jump_PJSR, // 03
-    MCU_Operand_General, // 04
-    MCU_Operand_General, // 05
-    MCU_Jump_JMP, // 06
-    MCU_Jump_JMP, // 07
-    MCU_TRAPA, // 08
-    MCU_Operand_NotImplemented, // 09
-    MCU_Jump_RTE, // 0A
-    MCU_Operand_NotImplemented, // 0B
-    MCU_Operand_General, // 0C
-    MCU_Operand_General, // 0D
-    MCU_Jump_BSR, // 0E
-    MCU_Operand_NotImplemented, // 0F
-    MCU_Jump_JMP, // 10
-    MCU_Jump_JMP, // 11
-    MCU_STM, // 12
-    MCU_Jump_PJMP, // 13
-    MCU_Jump_RTD, // 14
-    MCU_Operand_General, // 15
-    MCU_Operand_NotImplemented, // 16
-    MCU_Operand_NotImplemented, // 17
-    MCU_Jump_JSR, // 18
-    MCU_Jump_RTS, // 19
-    MCU_Operand_Sleep, // 1A
-    MCU_Operand_NotImplemented, // 1B
-    MCU_Jump_RTD, // 1C
-    MCU_Operand_General, // 1D
-    MCU_Jump_BSR, // 1E
-    MCU_Operand_NotImplemented, // 1F
-    MCU_Jump_Bcc, // 20
-    MCU_Jump_Bcc, // 21
-    MCU_Jump_Bcc, // 22
-    MCU_Jump_Bcc, // 23
-    MCU_Jump_Bcc, // 24
-    MCU_Jump_Bcc, // 25
-    MCU_Jump_Bcc, // 26
-    MCU_Jump_Bcc, // 27
-    MCU_Jump_Bcc, // 28
-    MCU_Jump_Bcc, // 29
-    MCU_Jump_Bcc, // 2A
-    MCU_Jump_Bcc, // 2B
-    MCU_Jump_Bcc, // 2C
-    MCU_Jump_Bcc, // 2D
-    MCU_Jump_Bcc, // 2E
-    MCU_Jump_Bcc, // 2F
-    MCU_Jump_Bcc, // 30
-    MCU_Jump_Bcc, // 31
-    MCU_Jump_Bcc, // 32
-    MCU_Jump_Bcc, // 33
-    MCU_Jump_Bcc, // 34
-    MCU_Jump_Bcc, // 35
-    MCU_Jump_Bcc, // 36
-    MCU_Jump_Bcc, // 37
-    MCU_Jump_Bcc, // 38
-    MCU_Jump_Bcc, // 39
-    MCU_Jump_Bcc, // 3A
-    MCU_Jump_Bcc, // 3B
-    MCU_Jump_Bcc, // 3C
-    MCU_Jump_Bcc, // 3D
-    MCU_Jump_Bcc, // 3E
-    MCU_Jump_Bcc, // 3F
-    MCU_Opcode_Short_CMP, // 40
-    MCU_Opcode_Short_CMP, // 41
-    MCU_Opcode_Short_CMP, // 42
-    MCU_Opcode_Short_CMP, // 43
-    MCU_Opcode_Short_CMP, // 44
-    MCU_Opcode_Short_CMP, // 45
-    MCU_Opcode_Short_CMP, // 46
-    MCU_Opcode_Short_CMP, // 47
-    MCU_Opcode_Short_CMP, // 48
-    MCU_Opcode_Short_CMP, // 49
-    MCU_Opcode_Short_CMP, // 4A
-    MCU_Opcode_Short_CMP, // 4B
-    MCU_Opcode_Short_CMP, // 4C
-    MCU_Opcode_Short_CMP, // 4D
-    MCU_Opcode_Short_CMP, // 4E
-    MCU_Opcode_Short_CMP, // 4F
-    MCU_Opcode_Short_MOVE, // 50
-    MCU_Opcode_Short_MOVE, // 51
-    MCU_Opcode_Short_MOVE, // 52
-    MCU_Opcode_Short_MOVE, // 53
-    MCU_Opcode_Short_MOVE, // 54
-    MCU_Opcode_Short_MOVE, // 55
-    MCU_Opcode_Short_MOVE, // 56
-    MCU_Opcode_Short_MOVE, // 57
-    MCU_Opcode_Short_MOVI, // 58
-    MCU_Opcode_Short_MOVI, // 59
-    MCU_Opcode_Short_MOVI, // 5A
-    MCU_Opcode_Short_MOVI, // 5B
-    MCU_Opcode_Short_MOVI, // 5C
-    MCU_Opcode_Short_MOVI, // 5D
-    MCU_Opcode_Short_MOVI, // 5E
-    MCU_Opcode_Short_MOVI, // 5F
-    MCU_Opcode_Short_MOVL, // 60
-    MCU_Opcode_Short_MOVL, // 61
-    MCU_Opcode_Short_MOVL, // 62
-    MCU_Opcode_Short_MOVL, // 63
-    MCU_Opcode_Short_MOVL, // 64
-    MCU_Opcode_Short_MOVL, // 65
-    MCU_Opcode_Short_MOVL, // 66
-    MCU_Opcode_Short_MOVL, // 67
-    MCU_Opcode_Short_MOVL, // 68
-    MCU_Opcode_Short_MOVL, // 69
-    MCU_Opcode_Short_MOVL, // 6A
-    MCU_Opcode_Short_MOVL, // 6B
-    MCU_Opcode_Short_MOVL, // 6C
-    MCU_Opcode_Short_MOVL, // 6D
-    MCU_Opcode_Short_MOVL, // 6E
-    MCU_Opcode_Short_MOVL, // 6F
-    MCU_Opcode_Short_MOVS, // 70
-    MCU_Opcode_Short_MOVS, // 71
-    MCU_Opcode_Short_MOVS, // 72
-    MCU_Opcode_Short_MOVS, // 73
-    MCU_Opcode_Short_MOVS, // 74
-    MCU_Opcode_Short_MOVS, // 75
-    MCU_Opcode_Short_MOVS, // 76
-    MCU_Opcode_Short_MOVS, // 77
-    MCU_Opcode_Short_MOVS, // 78
-    MCU_Opcode_Short_MOVS, // 79
-    MCU_Opcode_Short_MOVS, // 7A
-    MCU_Opcode_Short_MOVS, // 7B
-    MCU_Opcode_Short_MOVS, // 7C
-    MCU_Opcode_Short_MOVS, // 7D
-    MCU_Opcode_Short_MOVS, // 7E
-    MCU_Opcode_Short_MOVS, // 7F
-    MCU_Opcode_Short_MOVF, // 80
-    MCU_Opcode_Short_MOVF, // 81
-    MCU_Opcode_Short_MOVF, // 82
-    MCU_Opcode_Short_MOVF, // 83
-    MCU_Opcode_Short_MOVF, // 84
-    MCU_Opcode_Short_MOVF, // 85
-    MCU_Opcode_Short_MOVF, // 86
-    MCU_Opcode_Short_MOVF, // 87
-    MCU_Opcode_Short_MOVF, // 88
-    MCU_Opcode_Short_MOVF, // 89
-    MCU_Opcode_Short_MOVF, // 8A
-    MCU_Opcode_Short_MOVF, // 8B
-    MCU_Opcode_Short_MOVF, // 8C
-    MCU_Opcode_Short_MOVF, // 8D
-    MCU_Opcode_Short_MOVF, // 8E
-    MCU_Opcode_Short_MOVF, // 8F
-    MCU_Opcode_Short_MOVF, // 90
-    MCU_Opcode_Short_MOVF, // 91
-    MCU_Opcode_Short_MOVF, // 92
-    MCU_Opcode_Short_MOVF, // 93
-    MCU_Opcode_Short_MOVF, // 94
-    MCU_Opcode_Short_MOVF, // 95
-    MCU_Opcode_Short_MOVF, // 96
-    MCU_Opcode_Short_MOVF, // 97
-    MCU_Opcode_Short_MOVF, // 98
-    MCU_Opcode_Short_MOVF, // 99
-    MCU_Opcode_Short_MOVF, // 9A
-    MCU_Opcode_Short_MOVF, // 9B
-    MCU_Opcode_Short_MOVF, // 9C
-    MCU_Opcode_Short_MOVF, // 9D
-    MCU_Opcode_Short_MOVF, // 9E
-    MCU_Opcode_Short_MOVF, // 9F
-    MCU_Operand_General, // A0
-    MCU_Operand_General, // A1
-    MCU_Operand_General, // A2
-    MCU_Operand_General, // A3
-    MCU_Operand_General, // A4
-    MCU_Operand_General, // A5
-    MCU_Operand_General, // A6
-    MCU_Operand_General, // A7
-    MCU_Operand_General, // A8
-    MCU_Operand_General, // A9
-    MCU_Operand_General, // AA
-    MCU_Operand_General, // AB
-    MCU_Operand_General, // AC
-    MCU_Operand_General, // AD
-    MCU_Operand_General, // AE
-    MCU_Operand_General, // AF
-    MCU_Operand_General, // B0
-    MCU_Operand_General, // B1
-    MCU_Operand_General, // B2
-    MCU_Operand_General, // B3
-    MCU_Operand_General, // B4
-    MCU_Operand_General, // B5
-    MCU_Operand_General, // B6
-    MCU_Operand_General, // B7
-    MCU_Operand_General, // B8
-    MCU_Operand_General, // B9
-    MCU_Operand_General, // BA
-    MCU_Operand_General, // BB
-    MCU_Operand_General, // BC
-    MCU_Operand_General, // BD
-    MCU_Operand_General, // BE
-    MCU_Operand_General, // BF
-    MCU_Operand_General, // C0
-    MCU_Operand_General, // C1
-    MCU_Operand_General, // C2
-    MCU_Operand_General, // C3
-    MCU_Operand_General, // C4
-    MCU_Operand_General, // C5
-    MCU_Operand_General, // C6
-    MCU_Operand_General, // C7
-    MCU_Operand_General, // C8
-    MCU_Operand_General, // C9
-    MCU_Operand_General, // CA
-    MCU_Operand_General, // CB
-    MCU_Operand_General, // CC
-    MCU_Operand_General, // CD
-    MCU_Operand_General, // CE
-    MCU_Operand_General, // CF
-    MCU_Operand_General, // D0
-    MCU_Operand_General, // D1
-    MCU_Operand_General, // D2
-    MCU_Operand_General, // D3
-    MCU_Operand_General, // D4
-    MCU_Operand_General, // D5
-    MCU_Operand_General, // D6
-    MCU_Operand_General, // D7
-    MCU_Operand_General, // D8
-    MCU_Operand_General, // D9
-    MCU_Operand_General, // DA
-    MCU_Operand_General, // DB
-    MCU_Operand_General, // DC
-    MCU_Operand_General, // DD
-    MCU_Operand_General, // DE
-    MCU_Operand_General, // DF
-    MCU_Operand_General, // E0
-    MCU_Operand_General, // E1
-    MCU_Operand_General, // E2
-    MCU_Operand_General, // E3
-    MCU_Operand_General, // E4
-    MCU_Operand_General, // E5
-    MCU_Operand_General, // E6
-    MCU_Operand_General, // E7
-    MCU_Operand_General, // E8
-    MCU_Operand_General, // E9
-    MCU_Operand_General, // EA
-    MCU_Operand_General, // EB
-    MCU_Operand_General, // EC
-    MCU_Operand_General, // ED
-    MCU_Operand_General, // EE
-    MCU_Operand_General, // EF
-    MCU_Operand_General, // F0
-    MCU_Operand_General, // F1
-    MCU_Operand_General, // F2
-    MCU_Operand_General, // F3
-    MCU_Operand_General, // F4
-    MCU_Operand_General, // F5
-    MCU_Operand_General, // F6
-    MCU_Operand_General, // F7
-    MCU_Operand_General, // F8
-    MCU_Operand_General, // F9
-    MCU_Operand_General, // FA
-    MCU_Operand_General, // FB
-    MCU_Operand_General, // FC
-    MCU_Operand_General, // FD
-    MCU_Operand_General, // FE
-    MCU_Operand_General, // FF
-};
+// Decodes the effective address of a general format instruction into op
+// and returns the opcode byte that follows it. Instantiated per operand
+// size so the byte and word paths fold their size checks.
+template<class model, uint32_t siz>
+inline uint8_t MCU_Operand_Decode(uint8_t operand, mcu_operand_t *op)
+{
+    uint32_t type = GENERAL_DIRECT;
+    uint32_t disp = 0;
+    uint32_t increase = INCREASE_NONE;
+    uint32_t reg = 0;
+    uint32_t data = 0;
+    uint32_t addr = 0;
+    uint32_t addrpage = 0;
+    uint32_t ea = 0;
+    uint32_t ep = 0;
+    uint8_t opcode;
+    reg = operand & 0x07;
+    switch (operand & 0xf0)
+    {
+    case 0xa0:
+        type = GENERAL_DIRECT;
+        break;
+    case 0xd0:
+        type = GENERAL_INDIRECT;
+        break;
+    case 0xe0:
+        type = GENERAL_INDIRECT;
+        disp = (int8_t)MCU_ReadCodeAdvance<model>();
+        break;
+    case 0xf0:
+        type = GENERAL_INDIRECT;
+        disp = MCU_ReadCodeAdvance<model>();
+        disp <<= 8;
+        disp |= MCU_ReadCodeAdvance<model>();
+        break;
+    case 0xb0:
+        type = GENERAL_INDIRECT;
+        increase = INCREASE_DECREASE;
+        break;
+    case 0xc0:
+        type = GENERAL_INDIRECT;
+        increase = INCREASE_INCREASE;
+        break;
+    case 0x00:
+        if (reg == 5)
+        {
+            type = GENERAL_ABSOLUTE;
+            addr = mcu.br << 8;
+            addr |= MCU_ReadCodeAdvance<model>();
+            addrpage = 0;
+        }
+        else if (reg == 4)
+        {
+            type = GENERAL_IMMEDIATE;
+            data = MCU_ReadCodeAdvance<model>();
+            if (siz)
+            {
+                data <<= 8;
+                data |= MCU_ReadCodeAdvance<model>();
+            }
+        }
+        break;
+    case 0x10:
+        if (reg == 5)
+        {
+            type = GENERAL_ABSOLUTE;
+            addr = MCU_ReadCodeAdvance<model>() << 8;
+            addr |= MCU_ReadCodeAdvance<model>();
+            addrpage = mcu.dp;
+        }
+        break;
+    }
+    if (type == GENERAL_INDIRECT)
+    {
+        if (increase == INCREASE_DECREASE)
+        {
+            if (siz || reg == 7)
+            {
+                mcu.r[reg] -= 2;
+            }
+            else
+            {
+                mcu.r[reg] -= 1;
+            }
+        }
+        ea = mcu.r[reg] + disp;
+        if (increase == INCREASE_INCREASE)
+        {
+            if (siz || reg == 7)
+            {
+                mcu.r[reg] += 2;
+            }
+            else
+            {
+                mcu.r[reg] += 1;
+            }
+        }
+
+        ea &= 0xffff;
+
+        ep = MCU_GetPageForRegister(reg) & 0xff;
+    }
+    else if (type == GENERAL_ABSOLUTE)
+    {
+        ea = addr & 0xffff;
+
+        ep = addrpage & 0xff;
+    }
+
+    opcode = MCU_ReadCodeAdvance<model>();
+    op->extended = opcode == 0x00;
+    if (op->extended)
+    {
+        opcode = MCU_ReadCodeAdvance<model>();
+    }
+
+    op->type = type;
+    op->ea = ea;
+    op->ep = ep;
+    op->size = siz;
+    op->reg = reg;
+    op->data = data;
+
+    return opcode;
+}
+
+template<class model>
+void MCU_Operand_General(uint8_t operand)
+{
+    mcu_operand_t op;
+    uint8_t opcode;
+    if (operand & 0x08)
+        opcode = MCU_Operand_Decode<model, OPERAND_WORD>(operand, &op);
+    else
+        opcode = MCU_Operand_Decode<model, OPERAND_BYTE>(operand, &op);
+
+    MCU_Opcode_Table[opcode >> 3](opcode >> 3, opcode & 0x07, &op);
+}
 
-void (*MCU_Opcode_Table[32])(uint8_t opcode, uint8_t opcode_reg) = {
-    MCU_Opcode_MOVG_Immediate, // 00
-    MCU_Opcode_ADDQ, // 01
-    MCU_Opcode_CLR, // 02
-    MCU_Opcode_SHLR, // 03
-    MCU_Opcode_ADD, // 04
-    MCU_Opcode_ADDS, // 05
-    MCU_Opcode_SUB, // 06
-    MCU_Opcode_SUBS, // 07
-    MCU_Opcode_OR, // 08
-    MCU_Opcode_BSET_ORC, // 09
-    MCU_Opcode_AND, // 0A
-    MCU_Opcode_BCLR_ANDC, // 0B
-    MCU_Opcode_XOR, // 0C
-    MCU_Opcode_NotImplemented, // 0D
-    MCU_Opcode_CMP, // 0E
-    MCU_Opcode_BTST, // 0F
-    MCU_Opcode_MOVG, // 10
-    MCU_Opcode_LDC, // 11
-    MCU_Opcode_MOVG, // 12
-    MCU_Opcode_STC, // 13
-    MCU_Opcode_ADDX, // 14
-    MCU_Opcode_MULXU, // 15
-    MCU_Opcode_SUBX, // 16
-    MCU_Opcode_DIVXU, // 17
-    MCU_Opcode_BSET, // 18
-    MCU_Opcode_BSET, // 19
-    MCU_Opcode_BCLR, // 1A
-    MCU_Opcode_BCLR, // 1B
-    MCU_Opcode_BNOTI, // 1C
-    MCU_Opcode_BNOTI, // 1D
-    MCU_Opcode_BTSTI, // 1E
-    MCU_Opcode_BTSTI, // 1F
+// The instruction set, one entry per operand byte. It expands into the
+// function table below and, with MCU_THREADED_DISPATCH, into the label table
+// of MCU_Operand_Threaded, so the two can't disagree. G(byte)/G(word) are
+// general format operands, decoded with that size.
+#define MCU_OPERAND_TABLE(X, G) \
+    X(MCU_Operand_Nop) /* 00 */ \
+    X(MCU_Jump_JMP) /* 01 */ \
+    X(MCU_LDM) /* 02 */ \
+    X(MCU_Jump_PJSR) /* 03 */ \
+    G(byte) /* 04 */ \
+    G(byte) /* 05 */ \
+    X(MCU_Jump_JMP) /* 06 */ \
+    X(MCU_Jump_JMP) /* 07 */ \
+    X(MCU_TRAPA) /* 08 */ \
+    X(MCU_Operand_NotImplemented) /* 09 */ \
+    X(MCU_Jump_RTE) /* 0A */ \
+    X(MCU_Operand_NotImplemented) /* 0B */ \
+    G(word) /* 0C */ \
+    G(word) /* 0D */ \
+    X(MCU_Jump_BSR) /* 0E */ \
+    X(MCU_Operand_NotImplemented) /* 0F */ \
+    X(MCU_Jump_JMP) /* 10 */ \
+    X(MCU_Jump_JMP) /* 11 */ \
+    X(MCU_STM) /* 12 */ \
+    X(MCU_Jump_PJMP) /* 13 */ \
+    X(MCU_Jump_RTD) /* 14 */ \
+    G(byte) /* 15 */ \
+    X(MCU_Operand_NotImplemented) /* 16 */ \
+    X(MCU_Operand_NotImplemented) /* 17 */ \
+    X(MCU_Jump_JSR) /* 18 */ \
+    X(MCU_Jump_RTS) /* 19 */ \
+    X(MCU_Operand_Sleep) /* 1A */ \
+    X(MCU_Operand_NotImplemented) /* 1B */ \
+    X(MCU_Jump_RTD) /* 1C */ \
+    G(word) /* 1D */ \
+    X(MCU_Jump_BSR) /* 1E */ \
+    X(MCU_Operand_NotImplemented) /* 1F */ \
+    X(MCU_Jump_Bcc) /* 20 */ \
+    X(MCU_Jump_Bcc) /* 21 */ \
+    X(MCU_Jump_Bcc) /* 22 */ \
+    X(MCU_Jump_Bcc) /* 23 */ \
+    X(MCU_Jump_Bcc) /* 24 */ \
+    X(MCU_Jump_Bcc) /* 25 */ \
+    X(MCU_Jump_Bcc) /* 26 */ \
+    X(MCU_Jump_Bcc) /* 27 */ \
+    X(MCU_Jump_Bcc) /* 28 */ \
+    X(MCU_Jump_Bcc) /* 29 */ \
+    X(MCU_Jump_Bcc) /* 2A */ \
+    X(MCU_Jump_Bcc) /* 2B */ \
+    X(MCU_Jump_Bcc) /* 2C */ \
+    X(MCU_Jump_Bcc) /* 2D */ \
+    X(MCU_Jump_Bcc) /* 2E */ \
+    X(MCU_Jump_Bcc) /* 2F */ \
+    X(MCU_Jump_Bcc) /* 30 */ \
+    X(MCU_Jump_Bcc) /* 31 */ \
+    X(MCU_Jump_Bcc) /* 32 */ \
+    X(MCU_Jump_Bcc) /* 33 */ \
+    X(MCU_Jump_Bcc) /* 34 */ \
+    X(MCU_Jump_Bcc) /* 35 */ \
+    X(MCU_Jump_Bcc) /* 36 */ \
+    X(MCU_Jump_Bcc) /* 37 */ \
+    X(MCU_Jump_Bcc) /* 38 */ \
+    X(MCU_Jump_Bcc) /* 39 */ \
+    X(MCU_Jump_Bcc) /* 3A */ \
+    X(MCU_Jump_Bcc) /* 3B */ \
+    X(MCU_Jump_Bcc) /* 3C */ \
+    X(MCU_Jump_Bcc) /* 3D */ \
+    X(MCU_Jump_Bcc) /* 3E */ \
+    X(MCU_Jump_Bcc) /* 3F */ \
+    X(MCU_Opcode_Short_CMP) /* 40 */ \
+    X(MCU_Opcode_Short_CMP) /* 41 */ \
+    X(MCU_Opcode_Short_CMP) /* 42 */ \
+    X(MCU_Opcode_Short_CMP) /* 43 */ \
+    X(MCU_Opcode_Short_CMP) /* 44 */ \
+    X(MCU_Opcode_Short_CMP) /* 45 */ \
+    X(MCU_Opcode_Short_CMP) /* 46 */ \
+    X(MCU_Opcode_Short_CMP) /* 47 */ \
+    X(MCU_Opcode_Short_CMP) /* 48 */ \
+    X(MCU_Opcode_Short_CMP) /* 49 */ \
+    X(MCU_Opcode_Short_CMP) /* 4A */ \
+    X(MCU_Opcode_Short_CMP) /* 4B */ \
+    X(MCU_Opcode_Short_CMP) /* 4C */ \
+    X(MCU_Opcode_Short_CMP) /* 4D */ \
+    X(MCU_Opcode_Short_CMP) /* 4E */ \
+    X(MCU_Opcode_Short_CMP) /* 4F */ \
+    X(MCU_Opcode_Short_MOVE) /* 50 */ \
+    X(MCU_Opcode_Short_MOVE) /* 51 */ \
+    X(MCU_Opcode_Short_MOVE) /* 52 */ \
+    X(MCU_Opcode_Short_MOVE) /* 53 */ \
+    X(MCU_Opcode_Short_MOVE) /* 54 */ \
+    X(MCU_Opcode_Short_MOVE) /* 55 */ \
+    X(MCU_Opcode_Short_MOVE) /* 56 */ \
+    X(MCU_Opcode_Short_MOVE) /* 57 */ \
+    X(MCU_Opcode_Short_MOVI) /* 58 */ \
+    X(MCU_Opcode_Short_MOVI) /* 59 */ \
+    X(MCU_Opcode_Short_MOVI) /* 5A */ \
+    X(MCU_Opcode_Short_MOVI) /* 5B */ \
+    X(MCU_Opcode_Short_MOVI) /* 5C */ \
+    X(MCU_Opcode_Short_MOVI) /* 5D */ \
+    X(MCU_Opcode_Short_MOVI) /* 5E */ \
+    X(MCU_Opcode_Short_MOVI) /* 5F */ \
+    X(MCU_Opcode_Short_MOVL) /* 60 */ \
+    X(MCU_Opcode_Short_MOVL) /* 61 */ \
+    X(MCU_Opcode_Short_MOVL) /* 62 */ \
+    X(MCU_Opcode_Short_MOVL) /* 63 */ \
+    X(MCU_Opcode_Short_MOVL) /* 64 */ \
+    X(MCU_Opcode_Short_MOVL) /* 65 */ \
+    X(MCU_Opcode_Short_MOVL) /* 66 */ \
+    X(MCU_Opcode_Short_MOVL) /* 67 */ \
+    X(MCU_Opcode_Short_MOVL) /* 68 */ \
+    X(MCU_Opcode_Short_MOVL) /* 69 */ \
+    X(MCU_Opcode_Short_MOVL) /* 6A */ \
+    X(MCU_Opcode_Short_MOVL) /* 6B */ \
+    X(MCU_Opcode_Short_MOVL) /* 6C */ \
+    X(MCU_Opcode_Short_MOVL) /* 6D */ \
+    X(MCU_Opcode_Short_MOVL) /* 6E */ \
+    X(MCU_Opcode_Short_MOVL) /* 6F */ \
+    X(MCU_Opcode_Short_MOVS) /* 70 */ \
+    X(MCU_Opcode_Short_MOVS) /* 71 */ \
+    X(MCU_Opcode_Short_MOVS) /* 72 */ \
+    X(MCU_Opcode_Short_MOVS) /* 73 */ \
+    X(MCU_Opcode_Short_MOVS) /* 74 */ \
+    X(MCU_Opcode_Short_MOVS) /* 75 */ \
+    X(MCU_Opcode_Short_MOVS) /* 76 */ \
+    X(MCU_Opcode_Short_MOVS) /* 77 */ \
+    X(MCU_Opcode_Short_MOVS) /* 78 */ \
+    X(MCU_Opcode_Short_MOVS) /* 79 */ \
+    X(MCU_Opcode_Short_MOVS) /* 7A */ \
+    X(MCU_Opcode_Short_MOVS) /* 7B */ \
+    X(MCU_Opcode_Short_MOVS) /* 7C */ \
+    X(MCU_Opcode_Short_MOVS) /* 7D */ \
+    X(MCU_Opcode_Short_MOVS) /* 7E */ \
+    X(MCU_Opcode_Short_MOVS) /* 7F */ \
+    X(MCU_Opcode_Short_MOVF) /* 80 */ \
+    X(MCU_Opcode_Short_MOVF) /* 81 */ \
+    X(MCU_Opcode_Short_MOVF) /* 82 */ \
+    X(MCU_Opcode_Short_MOVF) /* 83 */ \
+    X(MCU_Opcode_Short_MOVF) /* 84 */ \
+    X(MCU_Opcode_Short_MOVF) /* 85 */ \
+    X(MCU_Opcode_Short_MOVF) /* 86 */ \
+    X(MCU_Opcode_Short_MOVF) /* 87 */ \
+    X(MCU_Opcode_Short_MOVF) /* 88 */ \
+    X(MCU_Opcode_Short_MOVF) /* 89 */ \
+    X(MCU_Opcode_Short_MOVF) /* 8A */ \
+    X(MCU_Opcode_Short_MOVF) /* 8B */ \
+    X(MCU_Opcode_Short_MOVF) /* 8C */ \
+    X(MCU_Opcode_Short_MOVF) /* 8D */ \
+    X(MCU_Opcode_Short_MOVF) /* 8E */ \
+    X(MCU_Opcode_Short_MOVF) /* 8F */ \
+    X(MCU_Opcode_Short_MOVF) /* 90 */ \
+    X(MCU_Opcode_Short_MOVF) /* 91 */ \
+    X(MCU_Opcode_Short_MOVF) /* 92 */ \
+    X(MCU_Opcode_Short_MOVF) /* 93 */ \
+    X(MCU_Opcode_Short_MOVF) /* 94 */ \
+    X(MCU_Opcode_Short_MOVF) /* 95 */ \
+    X(MCU_Opcode_Short_MOVF) /* 96 */ \
+    X(MCU_Opcode_Short_MOVF) /* 97 */ \
+    X(MCU_Opcode_Short_MOVF) /* 98 */ \
+    X(MCU_Opcode_Short_MOVF) /* 99 */ \
+    X(MCU_Opcode_Short_MOVF) /* 9A */ \
+    X(MCU_Opcode_Short_MOVF) /* 9B */ \
+    X(MCU_Opcode_Short_MOVF) /* 9C */ \
+    X(MCU_Opcode_Short_MOVF) /* 9D */ \
+    X(MCU_Opcode_Short_MOVF) /* 9E */ \
+    X(MCU_Opcode_Short_MOVF) /* 9F */ \
+    G(byte) /* A0 */ \
+    G(byte) /* A1 */ \
+    G(byte) /* A2 */ \
+    G(byte) /* A3 */ \
+    G(byte) /* A4 */ \
+    G(byte) /* A5 */ \
+    G(byte) /* A6 */ \
+    G(byte) /* A7 */ \
+    G(word) /* A8 */ \
+    G(word) /* A9 */ \
+    G(word) /* AA */ \
+    G(word) /* AB */ \
+    G(word) /* AC */ \
+    G(word) /* AD */ \
+    G(word) /* AE */ \
+    G(word) /* AF */ \
+    G(byte) /* B0 */ \
+    G(byte) /* B1 */ \
+    G(byte) /* B2 */ \
+    G(byte) /* B3 */ \
+    G(byte) /* B4 */ \
+    G(byte) /* B5 */ \
+    G(byte) /* B6 */ \
+    G(byte) /* B7 */ \
+    G(word) /* B8 */ \
+    G(word) /* B9 */ \
+    G(word) /* BA */ \
+    G(word) /* BB */ \
+    G(word) /* BC */ \
+    G(word) /* BD */ \
+    G(word) /* BE */ \
+    G(word) /* BF */ \
+    G(byte) /* C0 */ \
+    G(byte) /* C1 */ \
+    G(byte) /* C2 */ \
+    G(byte) /* C3 */ \
+    G(byte) /* C4 */ \
+    G(byte) /* C5 */ \
+    G(byte) /* C6 */ \
+    G(byte) /* C7 */ \
+    G(word) /* C8 */ \
+    G(word) /* C9 */ \
+    G(word) /* CA */ \
+    G(word) /* CB */ \
+    G(word) /* CC */ \
+    G(word) /* CD */ \
+    G(word) /* CE */ \
+    G(word) /* CF */ \
+    G(byte) /* D0 */ \
+    G(byte) /* D1 */ \
+    G(byte) /* D2 */ \
+    G(byte) /* D3 */ \
+    G(byte) /* D4 */ \
+    G(byte) /* D5 */ \
+    G(byte) /* D6 */ \
+    G(byte) /* D7 */ \
+    G(word) /* D8 */ \
+    G(word) /* D9 */ \
+    G(word) /* DA */ \
+    G(word) /* DB */ \
+    G(word) /* DC */ \
+    G(word) /* DD */ \
+    G(word) /* DE */ \
+    G(word) /* DF */ \
+    G(byte) /* E0 */ \
+    G(byte) /* E1 */ \
+    G(byte) /* E2 */ \
+    G(byte) /* E3 */ \
+    G(byte) /* E4 */ \
+    G(byte) /* E5 */ \
+    G(byte) /* E6 */ \
+    G(byte) /* E7 */ \
+    G(word) /* E8 */ \
+    G(word) /* E9 */ \
+    G(word) /* EA */ \
+    G(word) /* EB */ \
+    G(word) /* EC */ \
+    G(word) /* ED */ \
+    G(word) /* EE */ \
+    G(word) /* EF */ \
+    G(byte) /* F0 */ \
+    G(byte) /* F1 */ \
+    G(byte) /* F2 */ \
+    G(byte) /* F3 */ \
+    G(byte) /* F4 */ \
+    G(byte) /* F5 */ \
+    G(byte) /* F6 */ \
+    G(byte) /* F7 */ \
+    G(word) /* F8 */ \
+    G(word) /* F9 */ \
+    G(word) /* FA */ \
+    G(word) /* FB */ \
+    G(word) /* FC */ \
+    G(word) /* FD */ \
+    G(word) /* FE */ \
+    G(word) /* FF */
+
+#define OPERAND_ENTRY(name) name<model>,
+#define OPERAND_GENERAL(size) MCU_Operand_General<model>,
+template<class model>
+const mcu_operand_handler_t mcu_opcode_tables_t<model>::operand[256] = {
+    MCU_OPERAND_TABLE(OPERAND_ENTRY, OPERAND_GENERAL)
+};
+#undef OPERAND_GENERAL
+#undef OPERAND_ENTRY
+
+// general format opcodes, opcode byte >> 3
+#define MCU_OPCODE_TABLE(X) \
+    X(MCU_Opcode_MOVG_Immediate) /* 00 */ \
+    X(MCU_Opcode_ADDQ) /* 01 */ \
+    X(MCU_Opcode_CLR) /* 02 */ \
+    X(MCU_Opcode_SHLR) /* 03 */ \
+    X(MCU_Opcode_ADD) /* 04 */ \
+    X(MCU_Opcode_ADDS) /* 05 */ \
+    X(MCU_Opcode_SUB) /* 06 */ \
+    X(MCU_Opcode_SUBS) /* 07 */ \
+    X(MCU_Opcode_OR) /* 08 */ \
+    X(MCU_Opcode_BSET_ORC) /* 09 */ \
+    X(MCU_Opcode_AND) /* 0A */ \
+    X(MCU_Opcode_BCLR_ANDC) /* 0B */ \
+    X(MCU_Opcode_XOR) /* 0C */ \
+    X(MCU_Opcode_NotImplemented) /* 0D */ \
+    X(MCU_Opcode_CMP) /* 0E */ \
+    X(MCU_Opcode_BTST) /* 0F */ \
+    X(MCU_Opcode_MOVG) /* 10 */ \
+    X(MCU_Opcode_LDC) /* 11 */ \
+    X(MCU_Opcode_MOVG) /* 12 */ \
+    X(MCU_Opcode_STC) /* 13 */ \
+    X(MCU_Opcode_ADDX) /* 14 */ \
+    X(MCU_Opcode_MULXU) /* 15 */ \
+    X(MCU_Opcode_SUBX) /* 16 */ \
+    X(MCU_Opcode_DIVXU) /* 17 */ \
+    X(MCU_Opcode_BSET) /* 18 */ \
+    X(MCU_Opcode_BSET) /* 19 */ \
+    X(MCU_Opcode_BCLR) /* 1A */ \
+    X(MCU_Opcode_BCLR) /* 1B */ \
+    X(MCU_Opcode_BNOTI) /* 1C */ \
+    X(MCU_Opcode_BNOTI) /* 1D */ \
+    X(MCU_Opcode_BTSTI) /* 1E */ \
+    X(MCU_Opcode_BTSTI) /* 1F */
+
+#define OPCODE_ENTRY(name) name<model>,
+template<class model>
+const mcu_opcode_handler_t mcu_opcode_tables_t<model>::opcode[32] = {
+    MCU_OPCODE_TABLE(OPCODE_ENTRY)
 };
+#undef OPCODE_ENTRY
+
+const mcu_operand_handler_t *MCU_Operand_Table = mcu_opcode_tables_t<mcu_model_any_t>::operand;
+const mcu_opcode_handler_t *MCU_Opcode_Table = mcu_opcode_tables_t<mcu_model_any_t>::opcode;
+
+
+// the instruction set is the same for every model
+typedef mcu_model_any_t class_model;
+
+// Lengths for translators: fixed length instructions that continue with
+// the next one, conditional branches and everything else (the handler
+// decides where execution goes).
+int MCU_Operand_Class(uint8_t operand, int *length)
+{
+    mcu_operand_handler_t f = mcu_opcode_tables_t<class_model>::operand[operand];
+    *length = 1;
+    if (f == MCU_Operand_General<class_model>)
+        return MCU_OPERAND_CLASS_GENERAL;
+    if (f == MCU_Operand_Nop<class_model>)
+        return MCU_OPERAND_CLASS_LINEAR;
+    if (f == MCU_Opcode_Short_MOVE<class_model> || f == MCU_Opcode_Short_MOVF<class_model>
+        || f == MCU_Opcode_Short_MOVL<class_model> || f == MCU_Opcode_Short_MOVS<class_model>)
+    {
+        *length = 2;
+        return MCU_OPERAND_CLASS_LINEAR;
+    }
+    if (f == MCU_Opcode_Short_MOVI<class_model>)
+    {
+        *length = 3;
+        return MCU_OPERAND_CLASS_LINEAR;
+    }
+    if (f == MCU_Opcode_Short_CMP<class_model>)
+    {
+        *length = (operand & 0x08) ? 3 : 2;
+        return MCU_OPERAND_CLASS_LINEAR;
+    }
+    if (f == MCU_Jump_Bcc<class_model>)
+    {
+        *length = (operand & 0x10) ? 3 : 2;
+        return MCU_OPERAND_CLASS_BRANCH;
+    }
+    return MCU_OPERAND_CLASS_OTHER;
+}
+
+// code bytes a general format opcode reads after the opcode byte
+int MCU_Opcode_Length(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
+{
+    if (mcu_opcode_tables_t<class_model>::opcode[opcode] != MCU_Opcode_MOVG_Immediate<class_model>)
+        return 0;
+    if (op->type != GENERAL_INDIRECT && op->type != GENERAL_ABSOLUTE)
+        return 0;
+    switch (opcode_reg)
+    {
+    case 4:
+    case 6:
+        return 1;
+    case 5:
+    case 7:
+        return 2;
+    }
+    return 0;
+}
+
+#ifdef MCU_THREADED_DISPATCH
+#define MCU_OPERAND_HANDLERS(X) \
+    X(MCU_Operand_Nop) X(MCU_Operand_Sleep) X(MCU_Operand_NotImplemented) \
+    X(MCU_LDM) X(MCU_STM) X(MCU_TRAPA) \
+    X(MCU_Jump_PJSR) X(MCU_Jump_JSR) X(MCU_Jump_RTE) X(MCU_Jump_Bcc) \
+    X(MCU_Jump_RTS) X(MCU_Jump_RTD) X(MCU_Jump_JMP) X(MCU_Jump_BSR) \
+    X(MCU_Jump_PJMP) \
+    X(MCU_Opcode_Short_MOVE) X(MCU_Opcode_Short_MOVI) X(MCU_Opcode_Short_MOVF) \
+    X(MCU_Opcode_Short_MOVL) X(MCU_Opcode_Short_MOVS) X(MCU_Opcode_Short_CMP)
+
+#define MCU_OPCODE_HANDLERS(X) \
+    X(MCU_Opcode_NotImplemented) X(MCU_Opcode_MOVG_Immediate) X(MCU_Opcode_BSET_ORC) \
+    X(MCU_Opcode_BCLR_ANDC) X(MCU_Opcode_BTST) X(MCU_Opcode_CLR) X(MCU_Opcode_LDC) \
+    X(MCU_Opcode_STC) X(MCU_Opcode_BSET) X(MCU_Opcode_BCLR) X(MCU_Opcode_MOVG) \
+    X(MCU_Opcode_BTSTI) X(MCU_Opcode_BNOTI) X(MCU_Opcode_OR) X(MCU_Opcode_CMP) \
+    X(MCU_Opcode_ADDQ) X(MCU_Opcode_ADD) X(MCU_Opcode_SUB) X(MCU_Opcode_SUBS) \
+    X(MCU_Opcode_AND) X(MCU_Opcode_SHLR) X(MCU_Opcode_MULXU) X(MCU_Opcode_DIVXU) \
+    X(MCU_Opcode_ADDS) X(MCU_Opcode_XOR) X(MCU_Opcode_ADDX) X(MCU_Opcode_SUBX)
+
+// Same instruction set as MCU_Operand_Table/MCU_Opcode_Table, dispatched
+// with computed gotos. Everything is inlined at its label (flatten), the
+// operand stays in locals, and general format instructions get a byte and
+// a word copy of the decoder and of every opcode handler. Each copy has
+// its own indirect jump, which the branch predictor tracks separately.
+//
+// The label tables expand from the same lists as the function tables. A
+// handler missing from MCU_OPERAND_HANDLERS/MCU_OPCODE_HANDLERS is a
+// compile error (undefined label), it can't fall out of sync silently.
+template<class model>
+__attribute__((flatten))
+void MCU_Operand_Threaded(uint8_t operand)
+{
+#define OPERAND_LABEL_ENTRY(name) &&L_##name,
+#define OPERAND_LABEL_GENERAL(size) &&general_##size,
+    static void *const operand_labels[256] = {
+        MCU_OPERAND_TABLE(OPERAND_LABEL_ENTRY, OPERAND_LABEL_GENERAL)
+    };
+#undef OPERAND_LABEL_GENERAL
+#undef OPERAND_LABEL_ENTRY
+#define BYTE_LABEL_ENTRY(name) &&B_##name,
+#define WORD_LABEL_ENTRY(name) &&W_##name,
+    static void *const opcode_labels[2][32] = {
+        { MCU_OPCODE_TABLE(BYTE_LABEL_ENTRY) },
+        { MCU_OPCODE_TABLE(WORD_LABEL_ENTRY) }
+    };
+#undef WORD_LABEL_ENTRY
+#undef BYTE_LABEL_ENTRY
+
+    mcu_operand_t op;
+    uint8_t opcode;
+
+    goto *operand_labels[operand];
+
+#define OPERAND_LABEL(name) \
+L_##name: \
+    name<model>(operand); \
+    return;
+    MCU_OPERAND_HANDLERS(OPERAND_LABEL)
+#undef OPERAND_LABEL
+
+general_byte:
+    opcode = MCU_Operand_Decode<model, OPERAND_BYTE>(operand, &op);
+    goto *opcode_labels[OPERAND_BYTE][opcode >> 3];
+
+general_word:
+    opcode = MCU_Operand_Decode<model, OPERAND_WORD>(operand, &op);
+    goto *opcode_labels[OPERAND_WORD][opcode >> 3];
+
+    // the size is restated at each label, the compiler can't see which
+    // computed goto leads where
+#define OPCODE_LABEL(name) \
+B_##name: \
+    op.size = OPERAND_BYTE; \
+    name<model>(opcode >> 3, opcode & 0x07, &op); \
+    return; \
+W_##name: \
+    op.size = OPERAND_WORD; \
+    name<model>(opcode >> 3, opcode & 0x07, &op); \
+    return;
+    MCU_OPCODE_HANDLERS(OPCODE_LABEL)
+#undef OPCODE_LABEL
+}
+
+// Copy of a general format handler for one operand type and size
+template<mcu_opcode_handler_t handler, uint32_t type, uint32_t siz>
+__attribute__((flatten))
+static void MCU_Opcode_Fixed(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op)
+{
+    mcu_operand_t fixed = *op;
+    fixed.type = type;
+    fixed.size = siz;
+    handler(opcode, opcode_reg, &fixed);
+}
+
+template<class model>
+mcu_opcode_handler_t MCU_Opcode_Specialized(uint8_t opcode, uint32_t type, uint32_t siz)
+{
+    mcu_opcode_handler_t f = mcu_opcode_tables_t<model>::opcode[opcode];
+#define FIXED_TYPE(name, type) \
+    { MCU_Opcode_Fixed<name<model>, type, OPERAND_BYTE>, MCU_Opcode_Fixed<name<model>, type, OPERAND_WORD> }
+#define FIXED_OPCODE(name) \
+    if (f == name<model>) \
+    { \
+        static const mcu_opcode_handler_t fixed[4][2] = { \
+            FIXED_TYPE(name, GENERAL_DIRECT), FIXED_TYPE(name, GENERAL_INDIRECT), \
+            FIXED_TYPE(name, GENERAL_ABSOLUTE), FIXED_TYPE(name, GENERAL_IMMEDIATE) \
+        }; \
+        return fixed[type][siz]; \
+    }
+    MCU_OPCODE_HANDLERS(FIXED_OPCODE)
+#undef FIXED_OPCODE
+#undef FIXED_TYPE
+    return f;
+}
 
+mcu_opcode_handler_t (*mcu_opcode_specialized)(uint8_t opcode, uint32_t type, uint32_t siz) =
+    MCU_Opcode_Specialized<mcu_model_any_t>;
+#endif
+
+#ifdef MCU_THREADED_DISPATCH
+#define OPCODES_INSTANTIATE_THREADED(model) \
+    template void MCU_Operand_Threaded<model>(uint8_t operand); \
+    template mcu_opcode_handler_t MCU_Opcode_Specialized<model>(uint8_t opcode, uint32_t type, uint32_t siz);
+#else
+#define OPCODES_INSTANTIATE_THREADED(model)
+#endif
+#define OPCODES_INSTANTIATE(model) \
+    template struct mcu_opcode_tables_t<model>; \
+    OPCODES_INSTANTIATE_THREADED(model)
+MCU_MODEL_INSTANTIATE(OPCODES_INSTANTIATE)
+#undef OPCODES_INSTANTIATE
+#undef OPCODES_INSTANTIATE_THREADED
@@ -35,5 +35,74 @@
 
 #include <stdint.h>
 
-extern void (*MCU_Operand_Table[256])(uint8_t operand);
-extern void (*MCU_Opcode_Table[32])(uint8_t opcode, uint8_t opcode_reg);
+// GCC and Clang get a computed goto dispatcher, other compilers use the
+// function tables only
+#if defined(__GNUC__) && !defined(MCU_NO_THREADED_DISPATCH)
+#define MCU_THREADED_DISPATCH
+#endif
+
+enum {
+    GENERAL_DIRECT = 0,
+    GENERAL_INDIRECT,
+    GENERAL_ABSOLUTE,
+    GENERAL_IMMEDIATE
+};
+
+enum {
+    OPERAND_BYTE = 0,
+    OPERAND_WORD
+};
+
+enum {
+    INCREASE_NONE = 0,
+    INCREASE_DECREASE,
+    INCREASE_INCREASE
+};
+
+// effective address of a general format instruction, as decoded
+struct mcu_operand_t {
+    uint32_t type;
+    uint16_t ea;
+    uint8_t ep;
+    uint8_t size;
+    uint8_t reg;
+    uint8_t extended; // opcode had the 0x00 prefix
+    uint16_t data; // immediate
+};
+
+typedef void (*mcu_operand_handler_t)(uint8_t operand);
+typedef void (*mcu_opcode_handler_t)(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op);
+
+// The handlers are templates on the model traits type (see mcu_model_t),
+// so their memory accesses are direct calls. Instantiated for
+// MCU_MODEL_INSTANTIATE.
+template<class model>
+struct mcu_opcode_tables_t {
+    static const mcu_operand_handler_t operand[256];
+    static const mcu_opcode_handler_t opcode[32];
+};
+
+#ifdef MCU_THREADED_DISPATCH
+template<class model>
+void MCU_Operand_Threaded(uint8_t operand);
+// handler for general format code with a known operand type and size
+template<class model>
+mcu_opcode_handler_t MCU_Opcode_Specialized(uint8_t opcode, uint32_t type, uint32_t siz);
+#endif
+
+// the selected model's, set by MCU_SelectModel, for the translator
+extern const mcu_operand_handler_t *MCU_Operand_Table;
+extern const mcu_opcode_handler_t *MCU_Opcode_Table;
+#ifdef MCU_THREADED_DISPATCH
+extern mcu_opcode_handler_t (*mcu_opcode_specialized)(uint8_t opcode, uint32_t type, uint32_t siz);
+#endif
+
+enum {
+    MCU_OPERAND_CLASS_GENERAL = 0, // length from the addressing mode
+    MCU_OPERAND_CLASS_LINEAR,
+    MCU_OPERAND_CLASS_BRANCH, // Bcc
+    MCU_OPERAND_CLASS_OTHER
+};
+
+int MCU_Operand_Class(uint8_t operand, int *length);
+int MCU_Opcode_Length(uint8_t opcode, uint8_t opcode_reg, const mcu_operand_t *op);
@@ -0,0 +1,198 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <algorithm>
+#include <unordered_map>
+#include <vector>
+#include "mcu.h"
+#include "mcu_profile.h"
+#include "submcu.h"
+#include "utils/files.h"
+
+uint32_t profile_interval;
+uint32_t profile_countdown;
+
+static std::unordered_map<uint32_t, uint64_t> profile_mcu; // cp:pc -> samples
+static std::unordered_map<uint32_t, uint64_t> profile_sm; // pc -> samples
+static uint64_t profile_samples;
+static uint64_t profile_mcu_sleep;
+static uint64_t profile_sm_sleep;
+
+// addresses this close together are reported as one range
+static const uint32_t profile_range_gap = 16;
+static const int profile_report_lines = 40;
+
+struct profile_range_t {
+    uint32_t start;
+    uint32_t end;
+    uint64_t samples;
+};
+
+void PROFILE_Init(uint32_t interval)
+{
+    profile_interval = interval;
+    profile_countdown = interval;
+    profile_mcu.clear();
+    profile_sm.clear();
+    profile_samples = 0;
+    profile_mcu_sleep = 0;
+    profile_sm_sleep = 0;
+}
+
+void PROFILE_Sample(void)
+{
+    profile_countdown = profile_interval;
+    profile_samples++;
+
+    // every step takes the same number of cycles, so sample counts are cycle counts
+    if (mcu.sleep)
+        profile_mcu_sleep++;
+    else
+        profile_mcu[MCU_GetAddress(mcu.cp, mcu.pc)]++;
+
+    if (!mcu_mk1 && !mcu_jv880 && !mcu_scb55)
+    {
+        if (sm.sleep)
+            profile_sm_sleep++;
+        else
+            profile_sm[sm.pc]++;
+    }
+}
+
+static bool PROFILE_ByAddress(const profile_range_t &a, const profile_range_t &b)
+{
+    return a.start < b.start;
+}
+
+static bool PROFILE_BySamples(const profile_range_t &a, const profile_range_t &b)
+{
+    if (a.samples != b.samples)
+        return a.samples > b.samples;
+    return a.start < b.start;
+}
+
+static void PROFILE_Line(FILE *f, const char *name, uint64_t samples, double total, bool main_mcu)
+{
+    fprintf(f, "  %-17s %12llu %7.2f%%", name, (unsigned long long)samples, samples * 100.0 / total);
+    if (main_mcu) // one sample per profile_interval steps, each step is one instruction
+        fprintf(f, " %14llu", (unsigned long long)samples * profile_interval);
+    fprintf(f, "\n");
+}
+
+static void PROFILE_Report(FILE *f, const char *title, const std::unordered_map<uint32_t, uint64_t> &hist, bool main_mcu)
+{
+    std::vector<profile_range_t> addresses;
+    addresses.reserve(hist.size());
+    for (auto it = hist.begin(); it != hist.end(); ++it)
+    {
+        profile_range_t r = { it->first, it->first, it->second };
+        addresses.push_back(r);
+    }
+    std::sort(addresses.begin(), addresses.end(), PROFILE_ByAddress);
+
+    std::vector<profile_range_t> ranges;
+    for (size_t i = 0; i < addresses.size(); i++)
+    {
+        if (!ranges.empty() && addresses[i].start - ranges.back().end <= profile_range_gap
+            && (addresses[i].start >> 16) == (ranges.back().end >> 16)) // same page
+        {
+            ranges.back().end = addresses[i].start;
+            ranges.back().samples += addresses[i].samples;
+        }
+        else
+            ranges.push_back(addresses[i]);
+    }
+
+    std::sort(ranges.begin(), ranges.end(), PROFILE_BySamples);
+    std::sort(addresses.begin(), addresses.end(), PROFILE_BySamples);
+
+    double total = profile_samples ? (double)profile_samples : 1.0;
+
+    fprintf(f, "\n%s ranges:\n", title);
+    if (main_mcu)
+        fprintf(f, "  %-17s %12s %8s %14s\n", "range", "samples", "cycles", "instructions");
+    else
+        fprintf(f, "  %-17s %12s %8s\n", "range", "samples", "cycles");
+    for (size_t i = 0; i < ranges.size() && i < (size_t)profile_report_lines; i++)
+    {
+        char range[32];
+        if (main_mcu)
+            snprintf(range, sizeof(range), "%02x:%04x-%02x:%04x", ranges[i].start >> 16, ranges[i].start & 0xffff,
+                     ranges[i].end >> 16, ranges[i].end & 0xffff);
+        else
+            snprintf(range, sizeof(range), "%04x-%04x", ranges[i].start, ranges[i].end);
+        PROFILE_Line(f, range, ranges[i].samples, total, main_mcu);
+    }
+
+    fprintf(f, "\n%s addresses:\n", title);
+    if (main_mcu)
+        fprintf(f, "  %-17s %12s %8s %14s\n", "pc", "samples", "cycles", "instructions");
+    else
+        fprintf(f, "  %-17s %12s %8s\n", "pc", "samples", "cycles");
+    for (size_t i = 0; i < addresses.size() && i < (size_t)profile_report_lines; i++)
+    {
+        char pc[32];
+        if (main_mcu)
+            snprintf(pc, sizeof(pc), "%02x:%04x", addresses[i].start >> 16, addresses[i].start & 0xffff);
+        else
+            snprintf(pc, sizeof(pc), "%04x", addresses[i].start);
+        PROFILE_Line(f, pc, addresses[i].samples, total, main_mcu);
+    }
+}
+
+int PROFILE_Write(const char *path)
+{
+    FILE *f = Files::utf8_fopen(path, "w");
+    if (!f)
+    {
+        fprintf(stderr, "Failed to write the profile to %s\n", path);
+        return 0;
+    }
+
+    bool has_sm = !mcu_mk1 && !mcu_jv880 && !mcu_scb55;
+    double total = profile_samples ? (double)profile_samples : 1.0;
+
+    fprintf(f, "Firmware profile: %s, %llu samples, one every %u steps\n", rs_name[romset],
+            (unsigned long long)profile_samples, profile_interval);
+    fprintf(f, "MCU sleeping: %.2f%% of cycles\n", profile_mcu_sleep * 100.0 / total);
+    if (has_sm)
+        fprintf(f, "Sub MCU sleeping: %.2f%% of cycles\n", profile_sm_sleep * 100.0 / total);
+
+    PROFILE_Report(f, "MCU", profile_mcu, true);
+    if (has_sm)
+        PROFILE_Report(f, "Sub MCU", profile_sm, false);
+
+    fclose(f);
+    return 1;
+}
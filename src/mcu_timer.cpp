@@ -219,6 +219,7 @@ uint8_t TIMER_Read2(uint32_t address)
     return 0xff;
 }
 
+template<class model>
 void TIMER_Clock(uint64_t cycles)
 {
     uint32_t i;
@@ -244,7 +245,7 @@ void TIMER_Clock(uint64_t cycles)
                     continue;
                 break;
             case 3: // ext (o / 2)
-                if (mcu_mk1)
+                if (model::mk1())
                 {
                     if (timer_cycles & 3)
                         continue;
@@ -305,7 +306,7 @@ void TIMER_Clock(uint64_t cycles)
         case 5:
         case 6:
         case 7: // ext (o / 2)
-            if (mcu_mk1)
+            if (model::mk1())
             {
                 if ((timer_cycles & 3) == 0)
                     timer_step = 1;
@@ -350,3 +351,7 @@ void TIMER_Clock(uint64_t cycles)
         timer_cycles++;
     }
 }
+
+#define TIMER_INSTANTIATE(model) template void TIMER_Clock<model>(uint64_t cycles);
+MCU_MODEL_INSTANTIATE(TIMER_INSTANTIATE)
+#undef TIMER_INSTANTIATE
@@ -55,7 +55,8 @@ struct mcu_timer_t {
 
 void TIMER_Write(uint32_t address, uint8_t data);
 uint8_t TIMER_Read(uint32_t address);
-void TIMER_Clock(uint64_t cycles);
+template<class model>
+void TIMER_Clock(uint64_t cycles); // instantiated for MCU_MODEL_INSTANTIATE
 
 void TIMER2_Write(uint32_t address, uint8_t data);
 uint8_t TIMER_Read2(uint32_t address);
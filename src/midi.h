@@ -33,6 +33,19 @@
  */
 #pragma once
 
+#include <stdint.h>
+
 int MIDI_Init(int port);
 void MIDI_Quit(void);
 
+int MIDI_OutInit(int port);
+void MIDI_OutSend(const uint8_t *data, int len); // one complete message
+void MIDI_OutQuit(void);
+
+
+#ifdef USE_ALSA_SEQ
+// virtual ALSA sequencer client (midi_alsa.cpp)
+int MIDI_ALSA_Init(const char *name);
+void MIDI_ALSA_Send(const uint8_t *data, int len);
+void MIDI_ALSA_Quit(void);
+#endif
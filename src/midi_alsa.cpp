@@ -0,0 +1,281 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <alsa/asoundlib.h>
+#include <errno.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "SDL.h"
+#include "mcu.h"
+#include "midi.h"
+
+// Virtual ALSA sequencer client. Other clients (or aconnect) subscribe to our
+// input port; events are stamped by the kernel on arrival with the real time
+// of our queue, which is then mapped to the performance counter so the
+// emulator can schedule every byte at the cycle it was received.
+
+static snd_seq_t *alsa_seq;
+static int alsa_port_in = -1;
+static int alsa_port_out = -1;
+static int alsa_queue = -1;
+static snd_midi_event_t *alsa_decoder;
+static snd_midi_event_t *alsa_encoder;
+static SDL_Thread *alsa_thread;
+static SDL_atomic_t alsa_run;
+static SDL_SpinLock alsa_out_lock;
+
+// queue real time <-> performance counter
+static uint64_t alsa_base_ns;
+static uint64_t alsa_base_perf;
+static uint64_t alsa_events;
+
+static const int alsa_sysex_max = 65536;
+
+static uint64_t MIDI_ALSA_Timestamp(const snd_seq_event_t *ev)
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+
+    if ((ev->flags & SND_SEQ_TIME_STAMP_MASK) != SND_SEQ_TIME_STAMP_REAL)
+        return now;
+
+    uint64_t ns = (uint64_t)ev->time.time.tv_sec * 1000000000ull + ev->time.time.tv_nsec;
+    uint64_t freq = SDL_GetPerformanceFrequency();
+
+    // the queue timer and the performance counter may drift apart slowly,
+    // resync whenever the mapping points into the future or looks stale
+    uint64_t time = alsa_base_perf + (uint64_t)((double)(ns - alsa_base_ns) * (double)freq / 1e9);
+    if (ns < alsa_base_ns || time > now || now - time > freq / 100)
+    {
+        alsa_base_ns = ns;
+        alsa_base_perf = now;
+        time = now;
+    }
+
+    return time;
+}
+
+static void MIDI_ALSA_Event(const snd_seq_event_t *ev)
+{
+    static uint8_t buffer[alsa_sysex_max];
+
+    if (ev->dest.port != alsa_port_in)
+        return;
+
+    switch (ev->type)
+    {
+        case SND_SEQ_EVENT_PORT_SUBSCRIBED:
+        case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
+            return;
+    }
+
+    long len = snd_midi_event_decode(alsa_decoder, buffer, sizeof(buffer), ev);
+    if (len <= 0)
+        return;
+
+    uint64_t time = MIDI_ALSA_Timestamp(ev);
+    for (long i = 0; i < len; i++)
+        MCU_PostUARTTimed(buffer[i], time);
+    alsa_events++;
+}
+
+static int SDLCALL MIDI_ALSA_Thread(void *)
+{
+    int count = snd_seq_poll_descriptors_count(alsa_seq, POLLIN);
+    struct pollfd *pfd = (struct pollfd *)calloc(count, sizeof(struct pollfd));
+    snd_seq_poll_descriptors(alsa_seq, pfd, count, POLLIN);
+
+    while (SDL_AtomicGet(&alsa_run))
+    {
+        if (poll(pfd, count, 100) <= 0)
+            continue;
+
+        for (;;)
+        {
+            snd_seq_event_t *ev = NULL;
+            int err = snd_seq_event_input(alsa_seq, &ev);
+            if (err == -EAGAIN)
+                break;
+            if (err == -ENOSPC)
+            {
+                fprintf(stderr, "ALSA: input queue overrun, events lost\n");
+                continue;
+            }
+            if (err < 0 || !ev)
+                break;
+            MIDI_ALSA_Event(ev);
+        }
+    }
+
+    free(pfd);
+    return 0;
+}
+
+int MIDI_ALSA_Init(const char *name)
+{
+    int err;
+
+    if (alsa_seq)
+    {
+        printf("ALSA sequencer client already running\n");
+        return 0;
+    }
+
+    err = snd_seq_open(&alsa_seq, "default", SND_SEQ_OPEN_DUPLEX, 0);
+    if (err < 0)
+    {
+        fprintf(stderr, "ALSA: cannot open sequencer: %s\n", snd_strerror(err));
+        alsa_seq = NULL;
+        return 0;
+    }
+    snd_seq_nonblock(alsa_seq, 1);
+    snd_seq_set_client_name(alsa_seq, name);
+
+    alsa_queue = snd_seq_alloc_named_queue(alsa_seq, name);
+    if (alsa_queue < 0)
+    {
+        fprintf(stderr, "ALSA: cannot allocate queue: %s\n", snd_strerror(alsa_queue));
+        MIDI_ALSA_Quit();
+        return 0;
+    }
+
+    // stamp incoming events with the queue's real time
+    snd_seq_port_info_t *pinfo;
+    snd_seq_port_info_malloc(&pinfo);
+    snd_seq_port_info_set_name(pinfo, "MIDI In");
+    snd_seq_port_info_set_capability(pinfo, SND_SEQ_PORT_CAP_WRITE | SND_SEQ_PORT_CAP_SUBS_WRITE);
+    snd_seq_port_info_set_type(pinfo, SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_SYNTHESIZER | SND_SEQ_PORT_TYPE_APPLICATION);
+    snd_seq_port_info_set_timestamping(pinfo, 1);
+    snd_seq_port_info_set_timestamp_real(pinfo, 1);
+    snd_seq_port_info_set_timestamp_queue(pinfo, alsa_queue);
+    err = snd_seq_create_port(alsa_seq, pinfo);
+    if (err >= 0)
+        alsa_port_in = snd_seq_port_info_get_port(pinfo);
+    snd_seq_port_info_free(pinfo);
+    if (err < 0)
+    {
+        fprintf(stderr, "ALSA: cannot create input port: %s\n", snd_strerror(err));
+        MIDI_ALSA_Quit();
+        return 0;
+    }
+
+    alsa_port_out = snd_seq_create_simple_port(alsa_seq, "MIDI Out",
+        SND_SEQ_PORT_CAP_READ | SND_SEQ_PORT_CAP_SUBS_READ,
+        SND_SEQ_PORT_TYPE_MIDI_GENERIC | SND_SEQ_PORT_TYPE_APPLICATION);
+    if (alsa_port_out < 0)
+        fprintf(stderr, "ALSA: cannot create output port: %s\n", snd_strerror(alsa_port_out));
+
+    if (snd_midi_event_new(alsa_sysex_max, &alsa_decoder) < 0
+        || snd_midi_event_new(alsa_sysex_max, &alsa_encoder) < 0)
+    {
+        fprintf(stderr, "ALSA: cannot create MIDI event parser\n");
+        MIDI_ALSA_Quit();
+        return 0;
+    }
+    snd_midi_event_no_status(alsa_decoder, 1); // several senders may be interleaved, no running status
+
+    snd_seq_start_queue(alsa_seq, alsa_queue, NULL);
+    snd_seq_drain_output(alsa_seq);
+
+    alsa_base_ns = 0;
+    alsa_base_perf = SDL_GetPerformanceCounter();
+    alsa_events = 0;
+
+    SDL_AtomicSet(&alsa_run, 1);
+    alsa_thread = SDL_CreateThread(MIDI_ALSA_Thread, "alsa midi thread", 0);
+
+    printf("ALSA sequencer client %d:%d \"%s\"\n", snd_seq_client_id(alsa_seq), alsa_port_in, name);
+
+    return 1;
+}
+
+void MIDI_ALSA_Send(const uint8_t *data, int len)
+{
+    if (!alsa_seq || alsa_port_out < 0)
+        return;
+
+    SDL_AtomicLock(&alsa_out_lock);
+    snd_midi_event_reset_encode(alsa_encoder);
+    while (len > 0)
+    {
+        snd_seq_event_t ev;
+        snd_seq_ev_clear(&ev);
+        long used = snd_midi_event_encode(alsa_encoder, data, len, &ev);
+        if (used <= 0)
+            break;
+        data += used;
+        len -= (int)used;
+        if (ev.type == SND_SEQ_EVENT_NONE)
+            continue;
+        snd_seq_ev_set_source(&ev, alsa_port_out);
+        snd_seq_ev_set_subs(&ev);
+        snd_seq_ev_set_direct(&ev);
+        snd_seq_event_output_direct(alsa_seq, &ev);
+    }
+    SDL_AtomicUnlock(&alsa_out_lock);
+}
+
+void MIDI_ALSA_Quit(void)
+{
+    if (alsa_thread)
+    {
+        SDL_AtomicSet(&alsa_run, 0);
+        SDL_WaitThread(alsa_thread, 0);
+        alsa_thread = NULL;
+        printf("ALSA sequencer: %llu events received\n", (unsigned long long)alsa_events);
+    }
+    if (alsa_decoder)
+    {
+        snd_midi_event_free(alsa_decoder);
+        alsa_decoder = NULL;
+    }
+    if (alsa_encoder)
+    {
+        snd_midi_event_free(alsa_encoder);
+        alsa_encoder = NULL;
+    }
+    if (alsa_seq)
+    {
+        if (alsa_queue >= 0)
+        {
+            snd_seq_stop_queue(alsa_seq, alsa_queue, NULL);
+            snd_seq_drain_output(alsa_seq);
+            snd_seq_free_queue(alsa_seq, alsa_queue);
+        }
+        snd_seq_close(alsa_seq);
+        alsa_seq = NULL;
+    }
+    alsa_port_in = -1;
+    alsa_port_out = -1;
+    alsa_queue = -1;
+}
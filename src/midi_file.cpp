@@ -0,0 +1,280 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include "midi_file.h"
+#include "midi_tx.h"
+#include "utils/files.h"
+
+struct midi_file_event_t {
+    uint64_t tick;
+    uint32_t offset; // into midi_file_data
+    uint32_t length;
+};
+
+struct midi_file_tempo_t {
+    uint64_t tick;
+    uint32_t usec; // per quarter note
+};
+
+static std::vector<uint8_t> midi_file_data; // event bytes, status included
+
+static bool MIDIFILE_EventBefore(const midi_file_event_t &a, const midi_file_event_t &b)
+{
+    return a.tick < b.tick;
+}
+
+static bool MIDIFILE_TempoBefore(const midi_file_tempo_t &a, const midi_file_tempo_t &b)
+{
+    return a.tick < b.tick;
+}
+
+static uint32_t MIDIFILE_Read32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | p[3];
+}
+
+// variable length quantity, false if it runs past end
+static bool MIDIFILE_ReadVLQ(const uint8_t *&p, const uint8_t *end, uint32_t *value)
+{
+    *value = 0;
+    for (int i = 0; i < 4; i++)
+    {
+        if (p >= end)
+            return false;
+        uint8_t b = *p++;
+        *value = (*value << 7) | (b & 0x7f);
+        if (!(b & 0x80))
+            return true;
+    }
+    return false;
+}
+
+static bool MIDIFILE_ParseTrack(const uint8_t *p, const uint8_t *end,
+                                std::vector<midi_file_event_t> &events, std::vector<midi_file_tempo_t> &tempo)
+{
+    uint64_t tick = 0;
+    uint8_t running_status = 0;
+    while (p < end)
+    {
+        uint32_t delta;
+        if (!MIDIFILE_ReadVLQ(p, end, &delta) || p >= end)
+            return false;
+        tick += delta;
+
+        midi_file_event_t event;
+        event.tick = tick;
+        event.offset = (uint32_t)midi_file_data.size();
+
+        uint8_t status = *p;
+        if (status == 0xff)
+        {
+            // meta event, only tempo matters
+            if (end - p < 2)
+                return false;
+            uint8_t type = p[1];
+            p += 2;
+            uint32_t len;
+            if (!MIDIFILE_ReadVLQ(p, end, &len) || (uint32_t)(end - p) < len)
+                return false;
+            if (type == 0x51 && len == 3)
+            {
+                midi_file_tempo_t t;
+                t.tick = tick;
+                t.usec = (p[0] << 16) | (p[1] << 8) | p[2];
+                tempo.push_back(t);
+            }
+            p += len;
+            running_status = 0;
+            if (type == 0x2f)
+                break; // end of track
+            continue;
+        }
+        if (status == 0xf0 || status == 0xf7)
+        {
+            // F0 is sent with its data, F7 is an escape for raw bytes
+            p++;
+            uint32_t len;
+            if (!MIDIFILE_ReadVLQ(p, end, &len) || (uint32_t)(end - p) < len)
+                return false;
+            if (status == 0xf0)
+                midi_file_data.push_back(0xf0);
+            midi_file_data.insert(midi_file_data.end(), p, p + len);
+            p += len;
+            running_status = 0;
+        }
+        else if (status > 0xf0)
+        {
+            // system common and realtime don't belong in a MIDI file, but
+            // pass them on with their own length. They don't take over
+            // running status.
+            p++;
+            int len = MIDITX_MessageLength(status) - 1;
+            if (end - p < len)
+                return false;
+            midi_file_data.push_back(status);
+            midi_file_data.insert(midi_file_data.end(), p, p + len);
+            p += len;
+        }
+        else
+        {
+            if (status & 0x80)
+            {
+                running_status = status;
+                p++;
+            }
+            else if (!running_status)
+                return false;
+            int len = MIDITX_MessageLength(running_status) - 1;
+            if (end - p < len)
+                return false;
+            midi_file_data.push_back(running_status);
+            midi_file_data.insert(midi_file_data.end(), p, p + len);
+            p += len;
+        }
+
+        event.length = (uint32_t)midi_file_data.size() - event.offset;
+        if (event.length)
+            events.push_back(event);
+    }
+    return true;
+}
+
+int MIDIFILE_Load(const char *path, std::vector<midi_file_byte_t> &bytes)
+{
+    std::string file;
+    if (!Files::dumpFile(path, file))
+    {
+        fprintf(stderr, "ERROR: Failed to read the MIDI file %s.\n", path);
+        return 0;
+    }
+    const uint8_t *p = (const uint8_t *)file.data();
+    const uint8_t *end = p + file.size();
+
+    if (file.size() < 14 || memcmp(p, "MThd", 4) || MIDIFILE_Read32(p + 4) < 6)
+    {
+        fprintf(stderr, "ERROR: %s is not a standard MIDI file.\n", path);
+        return 0;
+    }
+    uint32_t header_len = MIDIFILE_Read32(p + 4);
+    uint16_t format = (p[8] << 8) | p[9];
+    uint16_t division = (p[12] << 8) | p[13];
+    if (format > 1)
+    {
+        fprintf(stderr, "ERROR: %s: MIDI file format %d is not supported.\n", path, format);
+        return 0;
+    }
+    if (division == 0 || (uint64_t)(end - p) < 8ull + header_len)
+    {
+        fprintf(stderr, "ERROR: %s: broken MIDI file header.\n", path);
+        return 0;
+    }
+    p += 8 + header_len;
+
+    std::vector<midi_file_event_t> events;
+    std::vector<midi_file_tempo_t> tempo;
+    midi_file_data.clear();
+
+    while (end - p >= 8)
+    {
+        uint32_t len = MIDIFILE_Read32(p + 4);
+        bool track = !memcmp(p, "MTrk", 4);
+        p += 8;
+        if ((uint32_t)(end - p) < len)
+        {
+            // truncated files are common, take what is there
+            fprintf(stderr, "WARNING: %s: truncated track.\n", path);
+            len = (uint32_t)(end - p);
+        }
+        if (track)
+        {
+            // tracks are merged by time, earlier tracks first on ties
+            std::vector<midi_file_event_t> track_events;
+            if (!MIDIFILE_ParseTrack(p, p + len, track_events, tempo))
+                fprintf(stderr, "WARNING: %s: broken track, using the events up to the error.\n", path);
+            events.insert(events.end(), track_events.begin(), track_events.end());
+        }
+        p += len;
+    }
+    std::stable_sort(events.begin(), events.end(), MIDIFILE_EventBefore);
+    std::stable_sort(tempo.begin(), tempo.end(), MIDIFILE_TempoBefore);
+
+    // ticks to seconds, through the tempo map unless the division is SMPTE
+    double smpte_tick = 0.0;
+    if (division & 0x8000)
+    {
+        int fps = -(int8_t)(division >> 8);
+        int ticks_per_frame = division & 0xff;
+        if (fps <= 0 || ticks_per_frame == 0)
+        {
+            fprintf(stderr, "ERROR: %s: broken SMPTE division.\n", path);
+            return 0;
+        }
+        smpte_tick = 1.0 / (fps == 29 ? 29.97 : fps) / ticks_per_frame;
+    }
+
+    bytes.clear();
+    size_t t = 0;
+    uint64_t tempo_tick = 0;
+    double tempo_time = 0.0;
+    double tick_seconds = 0.5 / division; // 120 bpm until the first tempo event
+    for (size_t i = 0; i < events.size(); i++)
+    {
+        const midi_file_event_t &e = events[i];
+        double time;
+        if (division & 0x8000)
+            time = e.tick * smpte_tick;
+        else
+        {
+            for (; t < tempo.size() && tempo[t].tick <= e.tick; t++)
+            {
+                tempo_time += (tempo[t].tick - tempo_tick) * tick_seconds;
+                tempo_tick = tempo[t].tick;
+                tick_seconds = tempo[t].usec / 1e6 / division;
+            }
+            time = tempo_time + (e.tick - tempo_tick) * tick_seconds;
+        }
+        for (uint32_t j = 0; j < e.length; j++)
+        {
+            midi_file_byte_t b;
+            b.time = time;
+            b.data = midi_file_data[e.offset + j];
+            bytes.push_back(b);
+        }
+    }
+    midi_file_data.clear();
+    return 1;
+}
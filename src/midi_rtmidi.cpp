@@ -1,4 +1,5 @@
 #include <stdio.h>
+#include "SDL.h"
 #include "mcu.h"
 #include "midi.h"
 #include <RtMidi.h>
@@ -6,13 +7,37 @@
 static RtMidiIn *s_midi_in = nullptr;
 
 
-static void MidiOnReceive(double, std::vector<uint8_t> *message, void *)
+static double s_midi_time;
+static uint64_t s_midi_base;
+
+// RtMidi only reports time since the previous message, map it onto the
+// performance counter and resync when the clocks disagree
+static uint64_t MidiTimestamp(double delta)
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+    uint64_t freq = SDL_GetPerformanceFrequency();
+
+    s_midi_time += delta;
+    uint64_t time = s_midi_base + (uint64_t)(s_midi_time * (double)freq);
+
+    if (!s_midi_base || time > now || now - time > freq / 100)
+    {
+        s_midi_base = now;
+        s_midi_time = 0.0;
+        time = now;
+    }
+
+    return time;
+}
+
+static void MidiOnReceive(double delta, std::vector<uint8_t> *message, void *)
 {
     uint8_t *beg = message->data();
     uint8_t *end = message->data() + message->size();
+    uint64_t time = MidiTimestamp(delta);
 
     while(beg < end)
-        MCU_PostUART(*beg++);
+        MCU_PostUARTTimed(*beg++, time);
 }
 
 static void MidiOnError(RtMidiError::Type, const std::string &errorText, void *)
@@ -64,3 +89,53 @@ void MIDI_Quit()
         s_midi_in = nullptr;
     }
 }
+
+static RtMidiOut *s_midi_out = nullptr;
+
+int MIDI_OutInit(int port)
+{
+    if (s_midi_out)
+    {
+        printf("MIDI output already running\n");
+        return 0;
+    }
+
+    s_midi_out = new RtMidiOut(RtMidi::UNSPECIFIED, "Nuked SC55");
+    s_midi_out->setErrorCallback(&MidiOnError, nullptr);
+
+    unsigned count = s_midi_out->getPortCount();
+
+    if (count == 0)
+    {
+        printf("No midi output\n");
+        delete s_midi_out;
+        s_midi_out = nullptr;
+        return 0;
+    }
+
+    if (port < 0 || (unsigned)port >= count)
+    {
+        printf("Out of range midi output port is requested. Defaulting to port 0\n");
+        port = 0;
+    }
+
+    s_midi_out->openPort(port, "Nuked SC55 Out");
+
+    return 1;
+}
+
+void MIDI_OutSend(const uint8_t *data, int len)
+{
+    if (s_midi_out)
+        s_midi_out->sendMessage(data, len);
+}
+
+void MIDI_OutQuit()
+{
+    if (s_midi_out)
+    {
+        s_midi_out->closePort();
+        delete s_midi_out;
+        s_midi_out = nullptr;
+    }
+}
@@ -0,0 +1,254 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include <string.h>
+#include "SDL.h"
+#include "mcu.h"
+#include "midi.h"
+#include "midi_tx.h"
+#include "utils/files.h"
+
+static SDL_Thread *miditx_thread;
+static SDL_atomic_t miditx_run;
+static bool miditx_port;
+static bool miditx_alsa;
+static FILE *miditx_file;
+
+// message assembler state
+static uint8_t miditx_msg[65536];
+static int miditx_len;
+static int miditx_expected;
+static uint8_t miditx_running_status;
+static bool miditx_sysex;
+static uint64_t miditx_bytes;
+static uint64_t miditx_messages;
+
+static void MIDITX_Send(const uint8_t *data, int len)
+{
+    miditx_messages++;
+    if (miditx_port)
+        MIDI_OutSend(data, len);
+#ifdef USE_ALSA_SEQ
+    if (miditx_alsa)
+        MIDI_ALSA_Send(data, len);
+#endif
+}
+
+int MIDITX_MessageLength(uint8_t status)
+{
+    switch (status & 0xf0)
+    {
+        case 0xc0:
+        case 0xd0:
+            return 2;
+        case 0xf0:
+            switch (status)
+            {
+                case 0xf1:
+                case 0xf3:
+                    return 2;
+                case 0xf2:
+                    return 3;
+                default:
+                    return 1;
+            }
+        default:
+            return 3;
+    }
+}
+
+static void MIDITX_Byte(uint8_t data)
+{
+    miditx_bytes++;
+
+    if (data >= 0xf8) // realtime, can appear anywhere
+    {
+        MIDITX_Send(&data, 1);
+        return;
+    }
+
+    if (miditx_sysex)
+    {
+        if (data < 0x80 || data == 0xf7)
+        {
+            miditx_msg[miditx_len++] = data;
+            if (data == 0xf7 || miditx_len == (int)sizeof(miditx_msg))
+            {
+                // oversized dumps are passed on in pieces
+                MIDITX_Send(miditx_msg, miditx_len);
+                miditx_len = 0;
+            }
+            if (data == 0xf7)
+                miditx_sysex = false;
+            return;
+        }
+        // unterminated sysex
+        if (miditx_len)
+            MIDITX_Send(miditx_msg, miditx_len);
+        miditx_sysex = false;
+        miditx_len = 0;
+    }
+
+    if (data == 0xf0)
+    {
+        miditx_sysex = true;
+        miditx_running_status = 0;
+        miditx_msg[0] = data;
+        miditx_len = 1;
+        return;
+    }
+
+    if (data & 0x80)
+    {
+        if (data < 0xf0)
+            miditx_running_status = data;
+        else
+            miditx_running_status = 0; // system common cancels running status
+        miditx_msg[0] = data;
+        miditx_len = 1;
+        miditx_expected = MIDITX_MessageLength(data);
+    }
+    else
+    {
+        if (miditx_len == 0)
+        {
+            if (!miditx_running_status)
+                return; // stray data byte
+            miditx_msg[0] = miditx_running_status;
+            miditx_len = 1;
+            miditx_expected = MIDITX_MessageLength(miditx_running_status);
+        }
+        miditx_msg[miditx_len++] = data;
+    }
+
+    if (miditx_len == miditx_expected)
+    {
+        MIDITX_Send(miditx_msg, miditx_len);
+        miditx_len = 0;
+    }
+}
+
+static void MIDITX_Drain(void)
+{
+    uint8_t buffer[1024];
+    int count;
+    while ((count = MCU_UART_TXRead(buffer, sizeof(buffer))) > 0)
+    {
+        if (miditx_file)
+            fwrite(buffer, 1, count, miditx_file);
+        for (int i = 0; i < count; i++)
+            MIDITX_Byte(buffer[i]);
+    }
+}
+
+static int SDLCALL MIDITX_Thread(void *)
+{
+    while (SDL_AtomicGet(&miditx_run))
+    {
+        MIDITX_Drain();
+        SDL_Delay(1);
+    }
+    MIDITX_Drain();
+    return 0;
+}
+
+int MIDITX_Init(int port, const char *path, bool alsa)
+{
+    miditx_len = 0;
+    miditx_running_status = 0;
+    miditx_sysex = false;
+    miditx_bytes = 0;
+    miditx_messages = 0;
+
+    if (port >= 0)
+    {
+        if (!MIDI_OutInit(port))
+            return 0;
+        miditx_port = true;
+    }
+
+#ifdef USE_ALSA_SEQ
+    miditx_alsa = alsa;
+#else
+    (void)alsa;
+#endif
+
+    if (path)
+    {
+        miditx_file = Files::utf8_fopen(path, "wb");
+        if (!miditx_file)
+        {
+            printf("Cannot open MIDI output file: %s\n", path);
+            MIDITX_Quit();
+            return 0;
+        }
+        printf("MIDI output file: %s\n", path);
+    }
+
+    if (!miditx_port && !miditx_alsa && !miditx_file)
+        return 1;
+
+    mcu_uart_tx_capture = 1;
+    SDL_AtomicSet(&miditx_run, 1);
+    miditx_thread = SDL_CreateThread(MIDITX_Thread, "midi tx thread", 0);
+
+    return 1;
+}
+
+void MIDITX_Quit(void)
+{
+    mcu_uart_tx_capture = 0;
+    if (miditx_thread)
+    {
+        SDL_AtomicSet(&miditx_run, 0);
+        SDL_WaitThread(miditx_thread, 0);
+        miditx_thread = NULL;
+        printf("MIDI output: %llu bytes, %llu messages\n",
+               (unsigned long long)miditx_bytes, (unsigned long long)miditx_messages);
+        uint32_t overflow = MCU_UART_TXGetOverflow();
+        if (overflow)
+            printf("WARNING: MIDI output buffer overflow, %u bytes dropped.\n", overflow);
+    }
+    if (miditx_file)
+    {
+        fclose(miditx_file);
+        miditx_file = NULL;
+    }
+    if (miditx_port)
+    {
+        MIDI_OutQuit();
+        miditx_port = false;
+    }
+    miditx_alsa = false;
+}
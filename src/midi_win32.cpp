@@ -35,6 +35,7 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <mmsystem.h>
+#include "SDL.h"
 #include "mcu.h"
 #include "midi.h"
 
@@ -43,6 +44,18 @@ static MIDIHDR midi_buffer;
 
 static char midi_in_buffer[1024];
 
+static uint64_t midi_start_time;
+
+// dwParam2 is milliseconds since midiInStart
+static uint64_t MIDI_Timestamp(DWORD_PTR ms)
+{
+    uint64_t now = SDL_GetPerformanceCounter();
+    uint64_t time = midi_start_time + (uint64_t)ms * SDL_GetPerformanceFrequency() / 1000;
+    if (time > now)
+        time = now;
+    return time;
+}
+
 void CALLBACK MIDI_Callback(
     HMIDIIN   hMidiIn,
     UINT      wMsg,
@@ -58,6 +71,7 @@ void CALLBACK MIDI_Callback(
         case MIM_DATA:
         {
             int b1 = dwParam1 & 0xff;
+            uint64_t time = MIDI_Timestamp(dwParam2);
             switch (b1 & 0xf0)
             {
                 case 0x80:
@@ -65,14 +79,14 @@ void CALLBACK MIDI_Callback(
                 case 0xa0:
                 case 0xb0:
                 case 0xe0:
-                    MCU_PostUART(b1);
-                    MCU_PostUART((dwParam1 >> 8) & 0xff);
-                    MCU_PostUART((dwParam1 >> 16) & 0xff);
+                    MCU_PostUARTTimed(b1, time);
+                    MCU_PostUARTTimed((dwParam1 >> 8) & 0xff, time);
+                    MCU_PostUARTTimed((dwParam1 >> 16) & 0xff, time);
                     break;
                 case 0xc0:
                 case 0xd0:
-                    MCU_PostUART(b1);
-                    MCU_PostUART((dwParam1 >> 8) & 0xff);
+                    MCU_PostUARTTimed(b1, time);
+                    MCU_PostUARTTimed((dwParam1 >> 8) & 0xff, time);
                     break;
             }
             break;
@@ -84,9 +98,10 @@ void CALLBACK MIDI_Callback(
 
             if (wMsg == MIM_LONGDATA)
             {
+                uint64_t time = MIDI_Timestamp(dwParam2);
                 for (int i = 0; i < midi_buffer.dwBytesRecorded; i++)
                 {
-                    MCU_PostUART(midi_in_buffer[i]);
+                    MCU_PostUARTTimed(midi_in_buffer[i], time);
                 }
             }
 
@@ -136,6 +151,7 @@ int MIDI_Init(int port)
 
     auto r1 = midiInPrepareHeader(midi_handle, &midi_buffer, sizeof(MIDIHDR));
     auto r2 = midiInAddBuffer(midi_handle, &midi_buffer, sizeof(MIDIHDR));
+    midi_start_time = SDL_GetPerformanceCounter();
     auto r3 = midiInStart(midi_handle);
 
     return 1;
@@ -150,3 +166,77 @@ void MIDI_Quit()
         midi_handle = 0;
     }
 }
+
+static HMIDIOUT midi_out_handle;
+
+int MIDI_OutInit(int port)
+{
+    int num = midiOutGetNumDevs();
+
+    if (num == 0)
+    {
+        printf("No midi output\n");
+        return 0;
+    }
+
+    if (port < 0 || port >= num)
+    {
+        printf("Out of range midi output port is requested. Defaulting to port 0\n");
+        port = 0;
+    }
+
+    MIDIOUTCAPSA caps;
+
+    midiOutGetDevCapsA(port, &caps, sizeof(MIDIOUTCAPSA));
+
+    auto res = midiOutOpen(&midi_out_handle, port, 0, 0, CALLBACK_NULL);
+
+    if (res != MMSYSERR_NOERROR)
+    {
+        printf("Can't open midi output\n");
+        return 0;
+    }
+
+    printf("Opened midi output port: %s\n", caps.szPname);
+
+    return 1;
+}
+
+void MIDI_OutSend(const uint8_t *data, int len)
+{
+    if (!midi_out_handle)
+        return;
+
+    if (data[0] != 0xf0 && len <= 3)
+    {
+        DWORD msg = 0;
+        for (int i = 0; i < len; i++)
+            msg |= (DWORD)data[i] << (i * 8);
+        midiOutShortMsg(midi_out_handle, msg);
+        return;
+    }
+
+    MIDIHDR hdr = {};
+    hdr.lpData = (LPSTR)data;
+    hdr.dwBufferLength = len;
+    hdr.dwBytesRecorded = len;
+
+    if (midiOutPrepareHeader(midi_out_handle, &hdr, sizeof(MIDIHDR)) != MMSYSERR_NOERROR)
+        return;
+    if (midiOutLongMsg(midi_out_handle, &hdr, sizeof(MIDIHDR)) == MMSYSERR_NOERROR)
+    {
+        while ((hdr.dwFlags & MHDR_DONE) == 0)
+            Sleep(1);
+    }
+    midiOutUnprepareHeader(midi_out_handle, &hdr, sizeof(MIDIHDR));
+}
+
+void MIDI_OutQuit()
+{
+    if (midi_out_handle)
+    {
+        midiOutReset(midi_out_handle);
+        midiOutClose(midi_out_handle);
+        midi_out_handle = 0;
+    }
+}
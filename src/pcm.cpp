@@ -45,7 +45,8 @@ uint8_t waverom3[0x100000];
 uint8_t waverom_card[0x200000];
 uint8_t waverom_exp[0x800000];
 
-uint8_t PCM_ReadROM(uint32_t address)
+template<class model>
+inline uint8_t PCM_ReadROM(uint32_t address)
 {
     int bank;
     if (pcm.config_reg_3d & 0x20)
@@ -55,17 +56,17 @@ uint8_t PCM_ReadROM(uint32_t address)
     switch (bank)
     {
         case 0:
-            if (mcu_mk1)
+            if (model::mk1())
                 return waverom1[address & 0xfffff];
             else
                 return waverom1[address & 0x1fffff];
         case 1:
-            if (!mcu_jv880)
+            if (!model::jv880())
                 return waverom2[address & 0xfffff];
             else
                 return waverom2[address & 0x1fffff];
         case 2:
-            if (mcu_jv880)
+            if (model::jv880())
                 return waverom_card[address & 0x1fffff];
             else
                 return waverom3[address & 0xfffff];
@@ -73,7 +74,7 @@ uint8_t PCM_ReadROM(uint32_t address)
         case 4:
         case 5:
         case 6:
-            if (mcu_jv880)
+            if (model::jv880())
                 return waverom_exp[(address & 0x1fffff) + (bank - 3) * 0x200000];
         default:
             break;
@@ -122,7 +123,7 @@ void PCM_Write(uint32_t address, uint8_t data)
             case 3:
                 pcm.wave_read_address &= ~0xff;
                 pcm.wave_read_address |= (data & 0xff) << 0;
-                pcm.wave_byte_latch = PCM_ReadROM(pcm.wave_read_address);
+                pcm.wave_byte_latch = PCM_ReadROM<mcu_model_any_t>(pcm.wave_read_address);
                 break;
         }
     }
@@ -525,6 +526,7 @@ inline void eram_pack(int addr, int val)
     pcm.eram[addr] = data;
 }
 
+template<class model>
 void PCM_Update(uint64_t cycles)
 {
     int reg_slots = (pcm.config_reg_3d & 31) + 1;
@@ -1150,7 +1152,7 @@ void PCM_Update(uint64_t cycles)
                 wave_address += nibble_add - nibble_subtract;
             wave_address &= 0xfffff;
 
-            int newnibble = PCM_ReadROM((hiaddr << 20) | wave_address);
+            int newnibble = PCM_ReadROM<model>((hiaddr << 20) | wave_address);
             int newnibble_sel = address_b4 ^ ((b6 || !nibble_cmp1) && okey);
             if (newnibble_sel)
                 newnibble = (newnibble >> 4) & 15;
@@ -1170,7 +1172,7 @@ void PCM_Update(uint64_t cycles)
 
             // address 0
             int address_cnt = address;
-            int samp0 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 18
+            int samp0 = (int8_t)PCM_ReadROM<model>((hiaddr << 20) | address_cnt); // 18
 
             cmp1 = address;
             cmp2 = address_cnt;
@@ -1196,7 +1198,7 @@ void PCM_Update(uint64_t cycles)
             address_cnt = address_cnt2 & 0xfffff; // 11
             b15 = b6 && (b15 ^ address_cmp); // 11
 
-            int samp1 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 20
+            int samp1 = (int8_t)PCM_ReadROM<model>((hiaddr << 20) | address_cnt); // 20
 
             cmp1 = address;
             cmp2 = address_cnt;
@@ -1225,7 +1227,7 @@ void PCM_Update(uint64_t cycles)
             address_cnt = address_cnt2 & 0xfffff; // 15
             b15 = b6 && (b15 ^ address_cmp); // 15
 
-            int samp2 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 1
+            int samp2 = (int8_t)PCM_ReadROM<model>((hiaddr << 20) | address_cnt); // 1
 
             cmp1 = address;
             cmp2 = address_cnt;
@@ -1254,7 +1256,7 @@ void PCM_Update(uint64_t cycles)
             address_cnt = address_cnt2 & 0xfffff; // 19
             b15 = b6 && (b15 ^ address_cmp); // 19
 
-            int samp3 = (int8_t)PCM_ReadROM((hiaddr << 20) | address_cnt); // 5
+            int samp3 = (int8_t)PCM_ReadROM<model>((hiaddr << 20) | address_cnt); // 5
 
             cmp1 = address;
             cmp2 = address_cnt;
@@ -1378,7 +1380,7 @@ void PCM_Update(uint64_t cycles)
             int filter = ram2[11];
             int v3;
 
-            if (mcu_mk1)
+            if (model::mk1())
             {
                 int mult1 = multi(reg1, filter >> 8); // 8
                 int mult2 = multi(reg1, (filter >> 1) & 127); // 9
@@ -1436,7 +1438,7 @@ void PCM_Update(uint64_t cycles)
                     ram2[8] |= 0x4000;
                 pcm.irq_assert = 1;
                 pcm.irq_channel = slot;
-                if (mcu_jv880)
+                if (model::jv880())
                     MCU_GA_SetGAInt(5, 1);
                 else
                     MCU_Interrupt_SetRequest(INTERRUPT_SOURCE_IRQ0, 1);
@@ -1572,6 +1574,10 @@ void PCM_Update(uint64_t cycles)
 
         int cycles = (reg_slots + 1) * 25;
 
-        pcm.cycles += mcu_jv880 ? (cycles * 25) / 29 : cycles;
+        pcm.cycles += model::jv880() ? (cycles * 25) / 29 : cycles;
     }
 }
+
+#define PCM_INSTANTIATE(model) template void PCM_Update<model>(uint64_t cycles);
+MCU_MODEL_INSTANTIATE(PCM_INSTANTIATE)
+#undef PCM_INSTANTIATE
@@ -73,4 +73,5 @@ extern uint8_t waverom_exp[];
 void PCM_Write(uint32_t address, uint8_t data);
 uint8_t PCM_Read(uint32_t address);
 void PCM_Reset(void);
-void PCM_Update(uint64_t cycles);
+template<class model>
+void PCM_Update(uint64_t cycles); // instantiated for MCU_MODEL_INSTANTIATE
@@ -0,0 +1,425 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "SDL.h"
+#include "resampler.h"
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define RESAMPLER_X86 1
+#include <immintrin.h>
+#if defined(__GNUC__) || defined(__clang__)
+#define RESAMPLER_AVX2_DISPATCH 1
+#endif
+// always there on x86-64, on i386 only when the build targets it
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define RESAMPLER_SSE 1
+#endif
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define RESAMPLER_NEON 1
+#include <arm_neon.h>
+#endif
+
+#ifndef M_PI
+#define M_PI 3.14159265358979323846
+#endif
+
+const char* resampler_quality_name[RESAMPLER_QUALITY_COUNT] = {
+    "low",
+    "medium",
+    "high"
+};
+
+static const struct {
+    int taps;
+    int phases;
+    double beta; // kaiser window
+    double rolloff;
+} resampler_presets[RESAMPLER_QUALITY_COUNT] = {
+    { 16, 64, 6.0, 0.85 },
+    { 32, 128, 8.0, 0.91 },
+    { 64, 256, 10.0, 0.95 },
+};
+
+static const int hist_size = 128 + resampler_block_max; // >= taps + block
+
+// y = sum((c0 + (c1 - c0) * t) * x), interpolating between two adjacent polyphase rows
+typedef void (*resampler_kernel_t)(const float *c0, const float *c1, float t,
+    const float *xl, const float *xr, int taps, float *yl, float *yr);
+
+static void RESAMPLER_Kernel_C(const float *c0, const float *c1, float t,
+    const float *xl, const float *xr, int taps, float *yl, float *yr)
+{
+    float suml = 0.f;
+    float sumr = 0.f;
+    for (int i = 0; i < taps; i++)
+    {
+        float c = c0[i] + (c1[i] - c0[i]) * t;
+        suml += c * xl[i];
+        sumr += c * xr[i];
+    }
+    *yl = suml;
+    *yr = sumr;
+}
+
+#if RESAMPLER_SSE
+static void RESAMPLER_Kernel_SSE(const float *c0, const float *c1, float t,
+    const float *xl, const float *xr, int taps, float *yl, float *yr)
+{
+    __m128 vt = _mm_set1_ps(t);
+    __m128 suml = _mm_setzero_ps();
+    __m128 sumr = _mm_setzero_ps();
+    for (int i = 0; i < taps; i += 4)
+    {
+        __m128 a = _mm_load_ps(c0 + i);
+        __m128 b = _mm_load_ps(c1 + i);
+        __m128 c = _mm_add_ps(a, _mm_mul_ps(_mm_sub_ps(b, a), vt));
+        suml = _mm_add_ps(suml, _mm_mul_ps(c, _mm_loadu_ps(xl + i)));
+        sumr = _mm_add_ps(sumr, _mm_mul_ps(c, _mm_loadu_ps(xr + i)));
+    }
+    // horizontal sums: (l0+l2, l1+l3, r0+r2, r1+r3)
+    __m128 lo = _mm_unpacklo_ps(suml, sumr); // l0 r0 l1 r1
+    __m128 hi = _mm_unpackhi_ps(suml, sumr); // l2 r2 l3 r3
+    __m128 s = _mm_add_ps(lo, hi); // l02 r02 l13 r13
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s)); // l r
+    *yl = _mm_cvtss_f32(s);
+    *yr = _mm_cvtss_f32(_mm_shuffle_ps(s, s, 1));
+}
+#endif
+
+#if RESAMPLER_X86
+#if RESAMPLER_AVX2_DISPATCH || defined(__AVX2__)
+#if RESAMPLER_AVX2_DISPATCH
+__attribute__((target("avx2,fma")))
+#endif
+static void RESAMPLER_Kernel_AVX2(const float *c0, const float *c1, float t,
+    const float *xl, const float *xr, int taps, float *yl, float *yr)
+{
+    __m256 vt = _mm256_set1_ps(t);
+    __m256 suml = _mm256_setzero_ps();
+    __m256 sumr = _mm256_setzero_ps();
+    for (int i = 0; i < taps; i += 8)
+    {
+        __m256 a = _mm256_load_ps(c0 + i);
+        __m256 b = _mm256_load_ps(c1 + i);
+        __m256 c = _mm256_fmadd_ps(_mm256_sub_ps(b, a), vt, a);
+        suml = _mm256_fmadd_ps(c, _mm256_loadu_ps(xl + i), suml);
+        sumr = _mm256_fmadd_ps(c, _mm256_loadu_ps(xr + i), sumr);
+    }
+    __m128 l = _mm_add_ps(_mm256_castps256_ps128(suml), _mm256_extractf128_ps(suml, 1));
+    __m128 r = _mm_add_ps(_mm256_castps256_ps128(sumr), _mm256_extractf128_ps(sumr, 1));
+    __m128 lo = _mm_unpacklo_ps(l, r);
+    __m128 hi = _mm_unpackhi_ps(l, r);
+    __m128 s = _mm_add_ps(lo, hi);
+    s = _mm_add_ps(s, _mm_movehl_ps(s, s));
+    *yl = _mm_cvtss_f32(s);
+    *yr = _mm_cvtss_f32(_mm_shuffle_ps(s, s, 1));
+}
+#define RESAMPLER_HAS_AVX2 1
+#endif
+#endif
+
+#if RESAMPLER_NEON
+static void RESAMPLER_Kernel_NEON(const float *c0, const float *c1, float t,
+    const float *xl, const float *xr, int taps, float *yl, float *yr)
+{
+    float32x4_t vt = vdupq_n_f32(t);
+    float32x4_t suml = vdupq_n_f32(0.f);
+    float32x4_t sumr = vdupq_n_f32(0.f);
+    for (int i = 0; i < taps; i += 4)
+    {
+        float32x4_t a = vld1q_f32(c0 + i);
+        float32x4_t b = vld1q_f32(c1 + i);
+        float32x4_t c = vmlaq_f32(a, vsubq_f32(b, a), vt);
+        suml = vmlaq_f32(suml, c, vld1q_f32(xl + i));
+        sumr = vmlaq_f32(sumr, c, vld1q_f32(xr + i));
+    }
+    float32x2_t l = vadd_f32(vget_low_f32(suml), vget_high_f32(suml));
+    float32x2_t r = vadd_f32(vget_low_f32(sumr), vget_high_f32(sumr));
+    float32x2_t s = vpadd_f32(l, r);
+    *yl = vget_lane_f32(s, 0);
+    *yr = vget_lane_f32(s, 1);
+}
+#endif
+
+static resampler_kernel_t resampler_kernel;
+static const char *resampler_kernel_name;
+
+static void RESAMPLER_SelectKernel(void)
+{
+    if (resampler_kernel)
+        return;
+    resampler_kernel = RESAMPLER_Kernel_C;
+    resampler_kernel_name = "C";
+#if RESAMPLER_SSE
+    resampler_kernel = RESAMPLER_Kernel_SSE;
+    resampler_kernel_name = "SSE";
+#endif
+#if RESAMPLER_HAS_AVX2
+#if RESAMPLER_AVX2_DISPATCH
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+#endif
+    {
+        resampler_kernel = RESAMPLER_Kernel_AVX2;
+        resampler_kernel_name = "AVX2";
+    }
+#endif
+#if RESAMPLER_NEON
+    resampler_kernel = RESAMPLER_Kernel_NEON;
+    resampler_kernel_name = "NEON";
+#endif
+}
+
+const char *RESAMPLER_GetKernelName(void)
+{
+    RESAMPLER_SelectKernel();
+    return resampler_kernel_name;
+}
+
+static double RESAMPLER_BesselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 64; k++)
+    {
+        double t = x / (2.0 * k);
+        term *= t * t;
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+    return sum;
+}
+
+static float *RESAMPLER_AllocAligned(int count)
+{
+    // 32-byte alignment for the AVX2 loads
+    void *mem = malloc(count * sizeof(float) + 32 + sizeof(void*));
+    if (!mem)
+        return NULL;
+    uintptr_t p = ((uintptr_t)mem + sizeof(void*) + 31) & ~(uintptr_t)31;
+    ((void**)p)[-1] = mem;
+    memset((void*)p, 0, count * sizeof(float));
+    return (float*)p;
+}
+
+static void RESAMPLER_FreeAligned(float *p)
+{
+    if (p)
+        free(((void**)p)[-1]);
+}
+
+int RESAMPLER_Init(resampler_t *rs, int in_rate, int out_rate, int quality)
+{
+    memset(rs, 0, sizeof(resampler_t));
+
+    if (in_rate <= 0 || out_rate <= 0)
+        return 0;
+    if (quality < 0 || quality >= RESAMPLER_QUALITY_COUNT)
+        quality = RESAMPLER_QUALITY_HIGH;
+
+    RESAMPLER_SelectKernel();
+
+    rs->in_rate = in_rate;
+    rs->out_rate = out_rate;
+    rs->quality = quality;
+    rs->taps = resampler_presets[quality].taps;
+    rs->phases = resampler_presets[quality].phases;
+    rs->step_base = (double)in_rate / (double)out_rate;
+    rs->step = rs->step_base;
+
+    rs->coefs = RESAMPLER_AllocAligned((rs->phases + 1) * rs->taps);
+    rs->hist_l = RESAMPLER_AllocAligned(hist_size);
+    rs->hist_r = RESAMPLER_AllocAligned(hist_size);
+    if (!rs->coefs || !rs->hist_l || !rs->hist_r)
+    {
+        RESAMPLER_Free(rs);
+        return 0;
+    }
+
+    // windowed sinc, cutoff below the lower of the two nyquist frequencies
+    double fc = 0.5 * resampler_presets[quality].rolloff;
+    if (out_rate < in_rate)
+        fc *= (double)out_rate / (double)in_rate;
+    double beta = resampler_presets[quality].beta;
+    double i0beta = RESAMPLER_BesselI0(beta);
+    int half = rs->taps / 2;
+
+    for (int p = 0; p <= rs->phases; p++)
+    {
+        float *row = &rs->coefs[p * rs->taps];
+        double frac = (double)p / (double)rs->phases;
+        double sum = 0.0;
+        for (int k = 0; k < rs->taps; k++)
+        {
+            double tau = frac + (half - 1) - k;
+            double x = tau / half;
+            double w = 0.0;
+            if (x > -1.0 && x < 1.0)
+                w = RESAMPLER_BesselI0(beta * sqrt(1.0 - x * x)) / i0beta;
+            double s = 2.0 * fc;
+            if (tau != 0.0)
+                s = sin(2.0 * M_PI * fc * tau) / (M_PI * tau);
+            row[k] = (float)(s * w);
+            sum += s * w;
+        }
+        // unity gain at DC for every phase
+        for (int k = 0; k < rs->taps; k++)
+            row[k] = (float)(row[k] / sum);
+    }
+
+    RESAMPLER_Reset(rs);
+
+    return 1;
+}
+
+void RESAMPLER_Free(resampler_t *rs)
+{
+    RESAMPLER_FreeAligned(rs->coefs);
+    RESAMPLER_FreeAligned(rs->hist_l);
+    RESAMPLER_FreeAligned(rs->hist_r);
+    rs->coefs = NULL;
+    rs->hist_l = NULL;
+    rs->hist_r = NULL;
+}
+
+void RESAMPLER_Reset(resampler_t *rs)
+{
+    if (!rs->hist_l)
+        return;
+    memset(rs->hist_l, 0, hist_size * sizeof(float));
+    memset(rs->hist_r, 0, hist_size * sizeof(float));
+    rs->hist_len = rs->taps; // zero history, output starts immediately
+    rs->pos = 0.0;
+}
+
+void RESAMPLER_SetRatioAdjust(resampler_t *rs, double adjust)
+{
+    rs->step = rs->step_base * adjust;
+}
+
+int RESAMPLER_MaxOutput(resampler_t *rs, int in_frames)
+{
+    return (int)(in_frames / rs->step) + 2;
+}
+
+int RESAMPLER_Process(resampler_t *rs, const short *in, int *in_used, short *out, int out_max)
+{
+    int in_frames = *in_used;
+    if (in_frames > resampler_block_max)
+        in_frames = resampler_block_max;
+    if (rs->hist_len + in_frames > hist_size)
+        in_frames = hist_size - rs->hist_len;
+    *in_used = in_frames;
+
+    uint64_t t0 = SDL_GetPerformanceCounter();
+
+    float *hl = rs->hist_l;
+    float *hr = rs->hist_r;
+    for (int i = 0; i < in_frames; i++)
+    {
+        hl[rs->hist_len + i] = in[i * 2 + 0] * (1.f / 32768.f);
+        hr[rs->hist_len + i] = in[i * 2 + 1] * (1.f / 32768.f);
+    }
+    rs->hist_len += in_frames;
+
+    const int taps = rs->taps;
+    const int phases = rs->phases;
+    const float *coefs = rs->coefs;
+    double pos = rs->pos;
+    int out_frames = 0;
+
+    while (out_frames < out_max)
+    {
+        int ipos = (int)pos;
+        if (ipos + taps > rs->hist_len)
+            break;
+        double fphase = (pos - ipos) * phases;
+        int phase = (int)fphase;
+        float t = (float)(fphase - phase);
+        float yl, yr;
+        resampler_kernel(&coefs[phase * taps], &coefs[(phase + 1) * taps], t,
+            &hl[ipos], &hr[ipos], taps, &yl, &yr);
+
+        int sl = (int)lrintf(yl * 32768.f);
+        int sr = (int)lrintf(yr * 32768.f);
+        if (sl > INT16_MAX)
+            sl = INT16_MAX;
+        else if (sl < INT16_MIN)
+            sl = INT16_MIN;
+        if (sr > INT16_MAX)
+            sr = INT16_MAX;
+        else if (sr < INT16_MIN)
+            sr = INT16_MIN;
+        out[out_frames * 2 + 0] = sl;
+        out[out_frames * 2 + 1] = sr;
+        out_frames++;
+
+        pos += rs->step;
+    }
+
+    // drop consumed history
+    int consumed = (int)pos;
+    if (consumed > rs->hist_len)
+        consumed = rs->hist_len;
+    rs->hist_len -= consumed;
+    memmove(hl, hl + consumed, rs->hist_len * sizeof(float));
+    memmove(hr, hr + consumed, rs->hist_len * sizeof(float));
+    rs->pos = pos - consumed;
+
+    rs->perf_ticks += SDL_GetPerformanceCounter() - t0;
+    rs->frames_out += out_frames;
+
+    return out_frames;
+}
+
+double RESAMPLER_GetLatency(resampler_t *rs)
+{
+    // group delay of the linear phase filter
+    return (double)(rs->taps / 2) / (double)rs->in_rate;
+}
+
+double RESAMPLER_GetCPULoad(resampler_t *rs)
+{
+    if (!rs->frames_out)
+        return 0.0;
+    double spent = (double)rs->perf_ticks / (double)SDL_GetPerformanceFrequency();
+    double audio = (double)rs->frames_out / (double)rs->out_rate;
+    return spent / audio;
+}
@@ -0,0 +1,77 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#pragma once
+#include <stdint.h>
+
+enum {
+    RESAMPLER_QUALITY_LOW = 0,
+    RESAMPLER_QUALITY_MEDIUM,
+    RESAMPLER_QUALITY_HIGH,
+    RESAMPLER_QUALITY_COUNT
+};
+
+// max input frames per RESAMPLER_Process call
+static const int resampler_block_max = 256;
+
+struct resampler_t {
+    int in_rate;
+    int out_rate;
+    int quality;
+    int taps;
+    int phases;
+    float *coefs; // (phases + 1) rows of taps
+    float *hist_l;
+    float *hist_r;
+    int hist_len;
+    double pos;
+    double step;
+    double step_base;
+
+    uint64_t perf_ticks;
+    uint64_t frames_out;
+};
+
+extern const char* resampler_quality_name[RESAMPLER_QUALITY_COUNT];
+
+int RESAMPLER_Init(resampler_t *rs, int in_rate, int out_rate, int quality);
+void RESAMPLER_Free(resampler_t *rs);
+void RESAMPLER_Reset(resampler_t *rs);
+void RESAMPLER_SetRatioAdjust(resampler_t *rs, double adjust);
+int RESAMPLER_MaxOutput(resampler_t *rs, int in_frames);
+// in_used: frames offered, set to the frames taken, which is fewer when the
+// history is full; pass the rest in the next call
+int RESAMPLER_Process(resampler_t *rs, const short *in, int *in_used, short *out, int out_max);
+double RESAMPLER_GetLatency(resampler_t *rs);
+double RESAMPLER_GetCPULoad(resampler_t *rs);
+const char *RESAMPLER_GetKernelName(void);
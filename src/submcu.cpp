@@ -1404,8 +1404,6 @@ void SM_UpdateUART(void)
 {
     if ((sm_device_mode[SM_DEV_UART1_CTRL] & 4) == 0) // RX disabled
         return;
-    if (uart_write_ptr == uart_read_ptr) // no byte
-        return;
 
     if (uart_rx_gotbyte)
         return;
@@ -1413,12 +1411,18 @@ void SM_UpdateUART(void)
     if (sm.cycles < uart_rx_delay)
         return;
 
-    uart_rx_byte = uart_buffer[uart_read_ptr];
-    uart_read_ptr = (uart_read_ptr + 1) % uart_buffer_size;
+    uint64_t ticks;
+    if (!MCU_UART_Peek(&ticks)) // no byte
+        return;
+
+    if (sm.cycles < ticks)
+        return;
+
+    uart_rx_byte = MCU_UART_Pop(sm.cycles);
     uart_rx_gotbyte = 1;
     sm_device_mode[SM_DEV_INT_REQUEST] |= 0x40;
 
-    uart_rx_delay = sm.cycles + 3000 * 4;
+    uart_rx_delay = sm.cycles + MCU_UART_RXGap() * 4;
 }
 
 void SM_Update(uint64_t cycles)
@@ -1432,6 +1436,7 @@ void SM_Update(uint64_t cycles)
             uint8_t opcode = SM_ReadAdvance();
 
             SM_Opcode_Table[opcode](opcode);
+            sm.instructions++;
         }
 
         sm.cycles += 12 * 4; // FIXME
@@ -54,6 +54,7 @@ struct submcu_t {
     uint8_t sr;
     uint64_t cycles;
     uint8_t sleep;
+    uint64_t instructions;
 };
 
 extern submcu_t sm;
@@ -0,0 +1,628 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+
+// Golden-output regression test (nuked-sc55-golden target).
+//
+// Boots one romset headless, feeds a fixed MIDI script through the UART at
+// fixed mcu cycle stamps, renders a few seconds of audio into a hash and
+// compares it, together with hashes of the final mcu and pcm state, to the
+// values recorded in the golden file. Any change to emulation output, however
+// small, shows up as a mismatch.
+//
+// usage: nuked-sc55-golden [-u] [-j] [-s] <golden file> <rom directory> <romset>
+//   -u  record the current values instead of comparing
+//   -j  run the firmware through the translator (-jit), must match as well
+//   -s  write synthetic ROMs (fixed pseudo-random contents) into the rom
+//       directory first and use those, recorded as "synth-<romset>"
+//
+// The synthetic ROMs are no real firmware, but a small program drives the
+// decoder, timers, interrupts and PCM chip the same way on every run, so they
+// catch emulation changes without needing the real ROMs.
+//
+// Exits with golden_skip when the romset's ROMs are not available or, for
+// real ROMs, when no value is recorded for them, so ctest reports the test as
+// skipped. A missing synthetic value is a failure.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <algorithm>
+#include <initializer_list>
+#include <string>
+#include <vector>
+#include "SDL.h"
+#include "../audio.h"
+#include "../lcd.h"
+#include "../mcu.h"
+#include "../mcu_jit.h"
+#include "../pcm.h"
+#include "../submcu.h"
+
+void MCU_Init(void);
+void MCU_Reset(void);
+void MCU_PatchROM(void);
+int MCU_OpenAudio(int deviceIndex, int pageSize, int pageNum, int rate, int quality, int latency, bool pull);
+void MCU_CloseAudio(void);
+
+extern const char* roms[ROM_SET_COUNT][6];
+extern uint8_t dev_register[0x80];
+extern uint8_t ram[];
+extern uint8_t sram[];
+
+static const int golden_skip = 77;
+
+static const double golden_boot = 1.0; // seconds before the script starts
+static const double golden_length = 4.0; // seconds rendered in total
+
+static const struct {
+    const char *name;
+    int romset;
+} golden_romsets[] = {
+    { "mk2", ROM_SET_MK2 },
+    { "st", ROM_SET_ST },
+    { "mk1", ROM_SET_MK1 },
+    { "cm300", ROM_SET_CM300 },
+    { "jv880", ROM_SET_JV880 },
+    { "scb55", ROM_SET_SCB55 },
+    { "rlp3237", ROM_SET_RLP3237 },
+    { "sc155", ROM_SET_SC155 },
+    { "sc155mk2", ROM_SET_SC155MK2 },
+};
+
+// time is in ms after golden_boot
+static const struct {
+    int time;
+    int len;
+    uint8_t data[11];
+} golden_script[] = {
+    { 0, 11, { 0xf0, 0x41, 0x10, 0x42, 0x12, 0x40, 0x00, 0x7f, 0x00, 0x41, 0xf7 } }, // GS reset
+    { 200, 2, { 0xc0, 0 } },
+    { 200, 2, { 0xc1, 48 } },
+    { 200, 2, { 0xc9, 0 } },
+    { 200, 3, { 0xb0, 7, 100 } },
+    { 200, 3, { 0xb0, 91, 80 } },
+    { 200, 3, { 0xb1, 10, 32 } },
+    { 300, 3, { 0x90, 60, 100 } },
+    { 300, 3, { 0x90, 64, 100 } },
+    { 300, 3, { 0x90, 67, 100 } },
+    { 300, 3, { 0x91, 48, 90 } },
+    { 300, 3, { 0x99, 36, 110 } },
+    { 300, 3, { 0x99, 42, 110 } },
+    { 800, 3, { 0xe0, 0x00, 0x50 } },
+    { 800, 3, { 0xb1, 1, 64 } },
+    { 1300, 3, { 0x80, 60, 0 } },
+    { 1300, 3, { 0x80, 64, 0 } },
+    { 1300, 3, { 0x80, 67, 0 } },
+    { 1300, 3, { 0x99, 38, 120 } },
+    { 1800, 3, { 0x81, 48, 0 } },
+    { 1800, 3, { 0xe0, 0x00, 0x40 } },
+    { 1800, 2, { 0xc0, 16 } },
+    { 1800, 3, { 0x90, 72, 110 } },
+    { 2300, 3, { 0xb0, 123, 0 } },
+    { 2300, 3, { 0xb1, 123, 0 } },
+};
+
+//
+// FNV-1a
+//
+
+static uint64_t GOLDEN_Hash(uint64_t hash, const void *data, size_t len)
+{
+    const uint8_t *p = (const uint8_t *)data;
+    for (size_t i = 0; i < len; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
+
+static const uint64_t golden_hash_init = 0xcbf29ce484222325ull;
+
+//
+// audio sink hashing everything it is given
+//
+
+static uint64_t golden_audio_hash = golden_hash_init;
+static uint64_t golden_frames;
+static int golden_rate;
+
+static int GOLDEN_Open(audio_config_t *config)
+{
+    golden_rate = config->rate;
+    return 1;
+}
+
+static void GOLDEN_Write(const short *samples, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        // little endian regardless of the host
+        uint8_t b[2] = { (uint8_t)samples[i], (uint8_t)((uint16_t)samples[i] >> 8) };
+        golden_audio_hash = GOLDEN_Hash(golden_audio_hash, b, 2);
+    }
+    golden_frames += count / 2;
+}
+
+static int GOLDEN_GetFill(void)
+{
+    return 0;
+}
+
+static int GOLDEN_GetFree(void)
+{
+    return INT_MAX;
+}
+
+static void GOLDEN_Close(void)
+{
+}
+
+static const audio_sink_t golden_sink = {
+    "golden",
+    false,
+    false,
+    GOLDEN_Open,
+    GOLDEN_Write,
+    GOLDEN_GetFill,
+    GOLDEN_GetFree,
+    GOLDEN_Close,
+};
+
+//
+// state hashes, field by field so struct padding doesn't matter
+//
+
+#define GOLDEN_FIELD(h, v) h = GOLDEN_Hash(h, &(v), sizeof(v))
+
+static uint64_t GOLDEN_HashMCU(void)
+{
+    uint64_t h = golden_hash_init;
+    GOLDEN_FIELD(h, mcu.r);
+    GOLDEN_FIELD(h, mcu.pc);
+    GOLDEN_FIELD(h, mcu.sr);
+    GOLDEN_FIELD(h, mcu.cp);
+    GOLDEN_FIELD(h, mcu.dp);
+    GOLDEN_FIELD(h, mcu.ep);
+    GOLDEN_FIELD(h, mcu.tp);
+    GOLDEN_FIELD(h, mcu.br);
+    GOLDEN_FIELD(h, mcu.sleep);
+    GOLDEN_FIELD(h, mcu.ex_ignore);
+    GOLDEN_FIELD(h, mcu.exception_pending);
+    GOLDEN_FIELD(h, mcu.interrupt_pending);
+    GOLDEN_FIELD(h, mcu.trapa_pending);
+    GOLDEN_FIELD(h, mcu.cycles);
+    GOLDEN_FIELD(h, dev_register);
+    h = GOLDEN_Hash(h, ram, 0x400);
+    h = GOLDEN_Hash(h, sram, 0x8000);
+    GOLDEN_FIELD(h, sm.pc);
+    GOLDEN_FIELD(h, sm.a);
+    GOLDEN_FIELD(h, sm.x);
+    GOLDEN_FIELD(h, sm.y);
+    GOLDEN_FIELD(h, sm.s);
+    GOLDEN_FIELD(h, sm.sr);
+    GOLDEN_FIELD(h, sm.cycles);
+    GOLDEN_FIELD(h, sm.sleep);
+    return h;
+}
+
+static uint64_t GOLDEN_HashPCM(void)
+{
+    uint64_t h = golden_hash_init;
+    GOLDEN_FIELD(h, pcm.ram1);
+    GOLDEN_FIELD(h, pcm.ram2);
+    GOLDEN_FIELD(h, pcm.select_channel);
+    GOLDEN_FIELD(h, pcm.voice_mask);
+    GOLDEN_FIELD(h, pcm.voice_mask_pending);
+    GOLDEN_FIELD(h, pcm.voice_mask_updating);
+    GOLDEN_FIELD(h, pcm.write_latch);
+    GOLDEN_FIELD(h, pcm.wave_read_address);
+    GOLDEN_FIELD(h, pcm.wave_byte_latch);
+    GOLDEN_FIELD(h, pcm.read_latch);
+    GOLDEN_FIELD(h, pcm.config_reg_3c);
+    GOLDEN_FIELD(h, pcm.config_reg_3d);
+    GOLDEN_FIELD(h, pcm.irq_channel);
+    GOLDEN_FIELD(h, pcm.irq_assert);
+    GOLDEN_FIELD(h, pcm.nfs);
+    GOLDEN_FIELD(h, pcm.tv_counter);
+    GOLDEN_FIELD(h, pcm.cycles);
+    GOLDEN_FIELD(h, pcm.eram);
+    GOLDEN_FIELD(h, pcm.accum_l);
+    GOLDEN_FIELD(h, pcm.accum_r);
+    GOLDEN_FIELD(h, pcm.rcsum);
+    return h;
+}
+
+//
+// synthetic ROMs
+//
+// rom1 is a small hand-assembled program, so boot runs valid code. It keys on
+// every voice by streaming a table of PCM register writes, then sleeps and
+// copies one rom2 byte into sram on each FRT1 compare match interrupt while
+// the 8-bit timer counts alongside, and starts over every 64 interrupts. The
+// sub mcu ROM starts with a counting loop. The write table and everything
+// else are xorshift64* output seeded from the romset and file name.
+//
+
+static uint32_t GOLDEN_Random(uint64_t *x)
+{
+    *x ^= *x >> 12;
+    *x ^= *x << 25;
+    *x ^= *x >> 27;
+    return (uint32_t)((*x * 0x2545f4914f6cdd1dull) >> 32);
+}
+
+static void GOLDEN_Emit(std::vector<uint8_t> &data, size_t address, std::initializer_list<uint8_t> code)
+{
+    std::copy(code.begin(), code.end(), data.begin() + address);
+}
+
+// table entry: address word, value word (low byte is written)
+static void GOLDEN_PCMWrite(std::vector<uint8_t> &table, uint16_t address, uint8_t value)
+{
+    uint8_t entry[4] = { (uint8_t)(address >> 8), (uint8_t)address, 0, value };
+    table.insert(table.end(), entry, entry + 4);
+}
+
+static void GOLDEN_SyntheticTable(std::vector<uint8_t> &table, uint16_t pcm, uint64_t *x)
+{
+    static const uint8_t ram1_reg[6] = { 0x0c, 0x2c, 0x08, 0x28, 0x04, 0x24 };
+    for (int slot = 0; slot < 32; slot++)
+    {
+        GOLDEN_PCMWrite(table, pcm + 0x3e, slot);
+        for (int i = 0; i < 6; i++)
+        {
+            uint32_t v = GOLDEN_Random(x) & 0xfffff;
+            if (i == 0)
+                v = 0x80000 + slot * 0x1000; // end
+            else if (i == 2 || i == 4)
+                v = 0x1000 + slot * 0x1000; // loop, address
+            GOLDEN_PCMWrite(table, pcm + ram1_reg[i] + 1, v >> 16);
+            GOLDEN_PCMWrite(table, pcm + ram1_reg[i] + 2, v >> 8);
+            GOLDEN_PCMWrite(table, pcm + ram1_reg[i] + 3, v);
+        }
+        for (int i = 0; i < 12; i++)
+        {
+            uint16_t v = GOLDEN_Random(x) >> 16;
+            if (i == 7)
+                v = 0x20; // keyed on
+            uint16_t reg = i < 8 ? 0x10 + i * 2 : 0x30 + (i - 8) * 2;
+            GOLDEN_PCMWrite(table, pcm + reg, v >> 8);
+            GOLDEN_PCMWrite(table, pcm + reg + 1, v);
+        }
+    }
+    GOLDEN_PCMWrite(table, pcm + 0x3c, 0x30);
+    GOLDEN_PCMWrite(table, pcm + 0x3d, 31);
+    GOLDEN_PCMWrite(table, pcm + 0x00, 0x0f); // voice enable
+    GOLDEN_PCMWrite(table, pcm + 0x01, 0xff);
+    GOLDEN_PCMWrite(table, pcm + 0x02, 0xff);
+    GOLDEN_PCMWrite(table, pcm + 0x03, 0xff);
+}
+
+static void GOLDEN_SyntheticProgram(std::vector<uint8_t> &rom, int rs, uint64_t *x)
+{
+    uint8_t pcm = rs == ROM_SET_JV880 ? 0xf0 : 0xe0;
+
+    std::vector<uint8_t> table;
+    GOLDEN_SyntheticTable(table, pcm << 8, x);
+    std::copy(table.begin(), table.end(), rom.begin() + 0x1000);
+    uint16_t count = (uint16_t)(table.size() / 4 - 1);
+
+    // vectors: reset to main, FRT1 OCIA to the handler, the rest spin
+    for (int i = 0; i < 0x100; i += 4)
+        GOLDEN_Emit(rom, i, { 0x00, 0x00, 0x03, 0x00 });
+    GOLDEN_Emit(rom, 0x00, { 0x00, 0x00, 0x01, 0x00 });
+    GOLDEN_Emit(rom, VECTOR_INTERNAL_INTERRUPT_94 * 4, { 0x00, 0x00, 0x02, 0x00 });
+
+    // main
+    GOLDEN_Emit(rom, 0x0100, {
+        0x5f, 0xd0, 0x00,                   // MOV:I.W #H'D000, R7
+        0x04, 0x01, 0x8c,                   // LDC.B #1, EP
+        0x5c, 0x00, 0x00,                   // MOV:I.W #0, R4
+        0x5e, 0x00, 0x00,                   // MOV:I.W #0, R6
+        0x15, 0xff, 0x94, 0x06, 0x04,       // MOV:G.B #H'04, @FRT1_OCRAH
+        0x15, 0xff, 0x95, 0x06, 0x00,       // MOV:G.B #H'00, @FRT1_OCRAL
+        0x15, 0xff, 0x91, 0x06, 0x01,       // MOV:G.B #H'01, @FRT1_TCSR    clear on match A
+        0x15, 0xff, 0x90, 0x06, 0x20,       // MOV:G.B #H'20, @FRT1_TCR     OCIEA, clock/4
+        0x15, 0xff, 0xf1, 0x06, 0x10,       // MOV:G.B #H'10, @IPRB         FRT1 level 1
+        0x15, 0xff, 0xd2, 0x06, 0x80,       // MOV:G.B #H'80, @TMR_TCORA
+        0x15, 0xff, 0xd0, 0x06, 0x09,       // MOV:G.B #H'09, @TMR_TCR      clear on match A, clock/8
+        0x58, 0x10, 0x00,                   // 012f: MOV:I.W #H'1000, R0
+        0x5a, (uint8_t)(count >> 8), (uint8_t)count, // MOV:I.W #count-1, R2
+        0xc8, 0x81,                         // 0135: MOV.W @R0+, R1
+        0xc8, 0x83,                         // MOV.W @R0+, R3
+        0xd1, 0x93,                         // MOV.B R3, @R1
+        0x01, 0xba, 0xf7,                   // SCB/F R2, 0135
+        0x15, pcm, 0x00, 0x85,              // MOV.B @PCM_VOICE, R5        latch the voice mask
+        0x0c, 0x00, 0x00, 0x88,             // LDC.W #0, SR
+        0x1a,                               // 0146: SLEEP
+        0x4e, 0x00, 0x40,                   // CMP:I.W #64, R6
+        0x25, 0xfa,                         // BCS 0146
+        0x5e, 0x00, 0x00,                   // MOV:I.W #0, R6
+        0x20, 0xde,                         // BRA 012f
+    });
+
+    // FRT1 OCIA
+    GOLDEN_Emit(rom, 0x0200, {
+        0x15, 0xff, 0x91, 0x85,             // MOV.B @FRT1_TCSR, R5
+        0x15, 0xff, 0x91, 0x06, 0x01,       // MOV:G.B #H'01, @FRT1_TCSR    clear OCFA
+        0xae, 0x08,                         // ADDQ.W #1, R6
+        0xc4, 0x85,                         // MOV.B @R4+, R5              rom2 (EP = 1)
+        0xf6, 0x80, 0x00, 0x95,             // MOV.B R5, @(H'8000, R6)
+        0x0a,                               // RTE
+    });
+
+    GOLDEN_Emit(rom, 0x0300, {
+        0x20, 0xfe,                         // BRA 0300
+    });
+}
+
+static size_t GOLDEN_SyntheticSize(int rs, int index)
+{
+    static const size_t sizes[6] = { 0x8000, 0x80000, 0x200000, 0x200000, 0x1000, 0x200000 };
+    if (index == 4)
+    {
+        if (rs == ROM_SET_MK1 || rs == ROM_SET_CM300 || rs == ROM_SET_SC155)
+            return 0x100000; // waverom3
+        if (rs == ROM_SET_JV880)
+            return 0x800000; // expansion
+    }
+    return sizes[index];
+}
+
+static bool GOLDEN_WriteSynthetic(int rs, const std::string &key, const std::string &romPath)
+{
+    std::vector<uint8_t> data;
+    for (int i = 0; i < 6; i++)
+    {
+        if (roms[rs][i][0] == '\0')
+            continue;
+        std::string file = key + "/" + roms[rs][i];
+        uint64_t x = GOLDEN_Hash(golden_hash_init, file.c_str(), file.size());
+        data.resize(GOLDEN_SyntheticSize(rs, i));
+        for (size_t j = 0; j < data.size(); j++)
+            data[j] = (uint8_t)(GOLDEN_Random(&x) >> 24);
+        if (i == 0)
+            GOLDEN_SyntheticProgram(data, rs, &x);
+        else if (!strcmp(roms[rs][i], "rom_sm.bin"))
+        {
+            // 1000: SEI; 1001: INC $00; JMP $1001
+            GOLDEN_Emit(data, 0x000, { 0x78, 0xe6, 0x00, 0x4c, 0x01, 0x10 });
+            for (int j = 0xff0; j < 0x1000; j += 2)
+                GOLDEN_Emit(data, j, { 0x00, 0x10 });
+        }
+        std::string path = romPath + "/" + roms[rs][i];
+        FILE *f = fopen(path.c_str(), "wb");
+        if (!f)
+        {
+            fprintf(stderr, "Failed to create %s\n", path.c_str());
+            return false;
+        }
+        bool ok = fwrite(data.data(), 1, data.size(), f) == data.size();
+        if (fclose(f) != 0 || !ok)
+        {
+            fprintf(stderr, "Failed to write %s\n", path.c_str());
+            return false;
+        }
+    }
+    return true;
+}
+
+//
+// golden file: one "<romset> <audio> <mcu> <pcm>" line per romset, # comments
+//
+
+static bool GOLDEN_Find(const std::vector<std::string> &lines, const char *name, size_t *index)
+{
+    size_t len = strlen(name);
+    for (size_t i = 0; i < lines.size(); i++)
+    {
+        if (lines[i].compare(0, len, name) == 0 && lines[i].size() > len && lines[i][len] == ' ')
+        {
+            *index = i;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void GOLDEN_ReadFile(const char *path, std::vector<std::string> &lines)
+{
+    FILE *f = fopen(path, "r");
+    if (!f)
+        return;
+    char buf[256];
+    while (fgets(buf, sizeof(buf), f))
+    {
+        size_t len = strlen(buf);
+        while (len && (buf[len - 1] == '\n' || buf[len - 1] == '\r'))
+            buf[--len] = '\0';
+        lines.push_back(buf);
+    }
+    fclose(f);
+}
+
+static bool GOLDEN_WriteFile(const char *path, const std::vector<std::string> &lines)
+{
+    FILE *f = fopen(path, "w");
+    if (!f)
+        return false;
+    for (size_t i = 0; i < lines.size(); i++)
+        fprintf(f, "%s\n", lines[i].c_str());
+    return fclose(f) == 0;
+}
+
+int main(int argc, char *argv[])
+{
+    bool update = false;
+    bool synthetic = false;
+    int arg = 1;
+    for (; arg < argc && argv[arg][0] == '-'; arg++)
+    {
+        if (!strcmp(argv[arg], "-u"))
+            update = true;
+        else if (!strcmp(argv[arg], "-j"))
+            mcu_jit = 1;
+        else if (!strcmp(argv[arg], "-s"))
+            synthetic = true;
+        else
+            break;
+    }
+    if (argc - arg != 3)
+    {
+        fprintf(stderr, "usage: %s [-u] [-j] [-s] <golden file> <rom directory> <romset>\n", argv[0]);
+        return 1;
+    }
+    const char *goldenPath = argv[arg];
+    std::string romPath = argv[arg + 1];
+    const char *name = argv[arg + 2];
+
+    int rs = -1;
+    for (size_t i = 0; i < sizeof(golden_romsets) / sizeof(golden_romsets[0]); i++)
+    {
+        if (!strcmp(golden_romsets[i].name, name))
+            rs = golden_romsets[i].romset;
+    }
+    if (rs < 0)
+    {
+        fprintf(stderr, "Unknown romset: %s\n", name);
+        return 1;
+    }
+
+    std::string key = synthetic ? std::string("synth-") + name : std::string(name);
+
+    if (synthetic && !GOLDEN_WriteSynthetic(rs, key, romPath))
+        return 1;
+
+    if (!MCU_RomsPresent(rs, romPath))
+    {
+        printf("%s: ROMs not found in %s, skipping.\n", rs_name[rs], romPath.c_str());
+        return golden_skip;
+    }
+
+    MCU_SetRomset(rs);
+    if (!MCU_LoadRoms(romPath))
+        return 1;
+
+    lcd_nogui = 1;
+    audio_sink = &golden_sink;
+
+    SDL_Init(SDL_INIT_TIMER);
+
+    if (!MCU_OpenAudio(-1, 512, 32, 0, 0, 0, false))
+    {
+        fprintf(stderr, "Failed to open the audio stream.\n");
+        return 1;
+    }
+
+    LCD_Init();
+    MCU_Init();
+    MCU_PatchROM();
+    MCU_Reset();
+    SM_Reset();
+    PCM_Reset();
+    if (mcu_jit && !MCU_JIT_Init())
+        return 1;
+
+    uint64_t boot_frames = (uint64_t)(golden_boot * golden_rate);
+    uint64_t total_frames = (uint64_t)(golden_length * golden_rate);
+
+    while (golden_frames < boot_frames)
+        MCU_Step();
+
+    // the mcu clock per audio frame is fixed for a romset, so stamps derived
+    // from it land on the same cycles every run
+    uint64_t base = mcu.cycles;
+    for (size_t i = 0; i < sizeof(golden_script) / sizeof(golden_script[0]); i++)
+    {
+        uint64_t frames = (uint64_t)golden_script[i].time * golden_rate / 1000;
+        uint64_t stamp = base + frames * base / golden_frames;
+        for (int j = 0; j < golden_script[i].len; j++)
+            MCU_PostUARTCycles(golden_script[i].data[j], stamp);
+    }
+
+    while (golden_frames < total_frames)
+        MCU_Step();
+
+    uint64_t mcu_hash = GOLDEN_HashMCU();
+    uint64_t pcm_hash = GOLDEN_HashPCM();
+
+    MCU_CloseAudio();
+    LCD_UnInit();
+    SDL_Quit();
+
+    char result[256];
+    snprintf(result, sizeof(result), "%s %016llx %016llx %016llx", key.c_str(),
+             (unsigned long long)golden_audio_hash, (unsigned long long)mcu_hash, (unsigned long long)pcm_hash);
+
+    std::vector<std::string> lines;
+    GOLDEN_ReadFile(goldenPath, lines);
+
+    size_t index;
+    bool found = GOLDEN_Find(lines, key.c_str(), &index);
+
+    if (update)
+    {
+        if (found)
+            lines[index] = result;
+        else
+            lines.push_back(result);
+        if (!GOLDEN_WriteFile(goldenPath, lines))
+        {
+            fprintf(stderr, "Failed to write %s\n", goldenPath);
+            return 1;
+        }
+        printf("recorded: %s\n", result);
+        return 0;
+    }
+
+    if (!found)
+    {
+        printf("%s: no golden value recorded, rerun with -u to record\n  got: %s\n", key.c_str(), result);
+        // real ROMs differ between dumps and nobody can record them all,
+        // the synthetic values are always checked in
+        return synthetic ? 1 : golden_skip;
+    }
+
+    if (lines[index] != result)
+    {
+        printf("%s: output differs from the golden value\n  expected: %s\n  got:      %s\n",
+               key.c_str(), lines[index].c_str(), result);
+        return 1;
+    }
+
+    printf("%s: ok (%llu frames)\n", key.c_str(), (unsigned long long)golden_frames);
+    return 0;
+}
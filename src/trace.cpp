@@ -0,0 +1,203 @@
+/*
+ * Copyright (C) 2021, 2024 nukeykt
+ *
+ *  Redistribution and use of this code or any derivative works are permitted
+ *  provided that the following conditions are met:
+ *
+ *   - Redistributions may not be sold, nor may they be used in a commercial
+ *     product or activity.
+ *
+ *   - Redistributions that are modified from the original source must include the
+ *     complete source code, including the source code for all components used by a
+ *     binary built from the modified sources. However, as a special exception, the
+ *     source code distributed need not include anything that is normally distributed
+ *     (in either source or binary form) with the major components (compiler, kernel,
+ *     and so on) of the operating system on which the executable runs, unless that
+ *     component itself accompanies the executable.
+ *
+ *   - Redistributions must reproduce the above copyright notice, this list of
+ *     conditions and the following disclaimer in the documentation and/or other
+ *     materials provided with the distribution.
+ *
+ *  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *  IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+ *  LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ *  POSSIBILITY OF SUCH DAMAGE.
+ */
+#include <stdio.h>
+#include "SDL.h"
+#include "trace.h"
+#include "utils/files.h"
+
+int trace_enabled;
+
+enum {
+    TRACE_SPAN,
+    TRACE_INSTANT,
+    TRACE_COUNTER,
+    TRACE_THREAD_NAME,
+};
+
+struct trace_event_t {
+    uint64_t ts;
+    uint64_t dur;
+    uint64_t tid;
+    const char *name;
+    const char *arg;
+    int64_t value;
+    int type;
+};
+
+static const int trace_buffer_size = 65536;
+
+// producers fill one buffer while the other one is written out
+static trace_event_t trace_events[2][trace_buffer_size];
+static int trace_count[2];
+static int trace_current;
+static SDL_SpinLock trace_lock;
+static uint32_t trace_dropped;
+
+static FILE *trace_file;
+static uint64_t trace_t0;
+static double trace_us; // microseconds per performance counter tick
+static bool trace_first;
+
+static void TRACE_Push(int type, const char *name, uint64_t ts, uint64_t dur, const char *arg, int64_t value)
+{
+    uint64_t tid = (uint64_t)SDL_ThreadID();
+
+    SDL_AtomicLock(&trace_lock);
+    int count = trace_count[trace_current];
+    if (count < trace_buffer_size)
+    {
+        trace_event_t *ev = &trace_events[trace_current][count];
+        ev->ts = ts;
+        ev->dur = dur;
+        ev->tid = tid;
+        ev->name = name;
+        ev->arg = arg;
+        ev->value = value;
+        ev->type = type;
+        trace_count[trace_current] = count + 1;
+    }
+    else
+        trace_dropped++;
+    SDL_AtomicUnlock(&trace_lock);
+}
+
+void TRACE_ThreadName(const char *name)
+{
+    if (!trace_enabled)
+        return;
+    TRACE_Push(TRACE_THREAD_NAME, name, 0, 0, NULL, 0);
+}
+
+void TRACE_Span(const char *name, uint64_t t0, uint64_t t1)
+{
+    TRACE_Push(TRACE_SPAN, name, t0, t1 - t0, NULL, 0);
+}
+
+void TRACE_Instant(const char *name, const char *arg, int64_t value)
+{
+    TRACE_Push(TRACE_INSTANT, name, SDL_GetPerformanceCounter(), 0, arg, value);
+}
+
+void TRACE_Counter(const char *name, int64_t value)
+{
+    TRACE_Push(TRACE_COUNTER, name, SDL_GetPerformanceCounter(), 0, NULL, value);
+}
+
+static void TRACE_Write(const trace_event_t *ev)
+{
+    double ts = ev->ts > trace_t0 ? (double)(ev->ts - trace_t0) * trace_us : 0.0;
+
+    fprintf(trace_file, "%s\n", trace_first ? "" : ",");
+    trace_first = false;
+
+    switch (ev->type)
+    {
+        case TRACE_SPAN:
+            fprintf(trace_file, "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"dur\":%.3f}",
+                    ev->name, (unsigned long long)ev->tid, ts, (double)ev->dur * trace_us);
+            break;
+        case TRACE_INSTANT:
+            fprintf(trace_file, "{\"name\":\"%s\",\"ph\":\"i\",\"s\":\"t\",\"pid\":1,\"tid\":%llu,\"ts\":%.3f,\"args\":{\"%s\":%lld}}",
+                    ev->name, (unsigned long long)ev->tid, ts, ev->arg, (long long)ev->value);
+            break;
+        case TRACE_COUNTER:
+            fprintf(trace_file, "{\"name\":\"%s\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,\"args\":{\"value\":%lld}}",
+                    ev->name, ts, (long long)ev->value);
+            break;
+        case TRACE_THREAD_NAME:
+            fprintf(trace_file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%llu,\"args\":{\"name\":\"%s\"}}",
+                    (unsigned long long)ev->tid, ev->name);
+            break;
+    }
+}
+
+static void TRACE_WriteBuffer(void)
+{
+    SDL_AtomicLock(&trace_lock);
+    int buffer = trace_current;
+    trace_current ^= 1;
+    trace_count[trace_current] = 0;
+    SDL_AtomicUnlock(&trace_lock);
+
+    for (int i = 0; i < trace_count[buffer]; i++)
+        TRACE_Write(&trace_events[buffer][i]);
+    fflush(trace_file);
+}
+
+void TRACE_Flush(void)
+{
+    if (!trace_enabled)
+        return;
+    TRACE_WriteBuffer();
+}
+
+int TRACE_Open(const char *path)
+{
+    trace_file = Files::utf8_fopen(path, "w");
+    if (!trace_file)
+    {
+        fprintf(stderr, "Failed to open the trace file %s\n", path);
+        return 0;
+    }
+
+    trace_t0 = SDL_GetPerformanceCounter();
+    trace_us = 1e6 / (double)SDL_GetPerformanceFrequency();
+    trace_first = true;
+    trace_count[0] = 0;
+    trace_count[1] = 0;
+    trace_current = 0;
+    trace_dropped = 0;
+
+    fprintf(trace_file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+
+    trace_enabled = 1;
+    return 1;
+}
+
+void TRACE_Close(void)
+{
+    if (!trace_enabled)
+        return;
+
+    trace_enabled = 0;
+    TRACE_WriteBuffer();
+    TRACE_WriteBuffer(); // anything that raced with the first one
+
+    fprintf(trace_file, "\n]}\n");
+    fclose(trace_file);
+    trace_file = NULL;
+
+    if (trace_dropped)
+        fprintf(stderr, "WARNING: %u trace events dropped, buffer full.\n", trace_dropped);
+}
@@ -447,3 +447,30 @@ bool Files::dumpFile(const std::string& inPath, std::string& outData)
 
     return ret;
 }
+
+bool Files::writeFileAtomic(const std::string &path, const std::string &data)
+{
+    std::string tmp = path + ".tmp";
+    FILE *out = Files::utf8_fopen(tmp.c_str(), "wb");
+    if(!out)
+        return false;
+
+    bool ret = std::fwrite(data.data(), 1, data.size(), out) == data.size();
+    if(std::fclose(out) != 0)
+        ret = false;
+
+    if(!ret)
+    {
+        deleteFile(tmp);
+        return false;
+    }
+
+#ifdef _WIN32
+    // rename doesn't replace an existing file on Windows
+    std::wstring wpath = Str2WStr(path);
+    ::_wremove(wpath.c_str());
+    return ::_wrename(Str2WStr(tmp).c_str(), wpath.c_str()) == 0;
+#else
+    return ::rename(tmp.c_str(), path.c_str()) == 0;
+#endif
+}
@@ -55,6 +55,8 @@ namespace Files
     //Appends "m" into basename of the file name before last dot
     void getGifMask(std::string &mask, const std::string &front);
     bool dumpFile(const std::string &inPath, std::string &outData);
+    //Writes into "<path>.tmp" and renames it over path, so readers never see a partial file
+    bool writeFileAtomic(const std::string &path, const std::string &data);
 }
 
 #endif // FILES_H